@@ -0,0 +1,511 @@
+/*
+ * \file Abc.cpp
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+#include <algorithm>  // for sort, upper_bound
+#include <numeric>  // for partial_sum
+#include <utility>  // for pair
+#include <pthread.h>
+#include "gsl/gsl_randist.h"
+using namespace std;
+
+#include "Abc.h"
+#include "Population.h"
+
+// simulations of a batch, taken in turn by the threads
+struct AbcBatch
+{
+  Abc * abc;
+  vector<AbcDraw> * pDraws;
+  size_t next;
+};
+
+static void * runWorker( void * arg )
+{
+  AbcBatch * batch = (AbcBatch *) arg;
+  size_t nbDraws = batch->pDraws->size();
+  while( true ){
+    size_t i = __atomic_fetch_add( &batch->next, 1, __ATOMIC_RELAXED );
+    if( i >= nbDraws )
+      break;
+    batch->abc->simulate( (*batch->pDraws)[i] );
+  }
+  return( NULL );
+}
+
+static double getWallTime( void )
+{
+  struct timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  return( now.tv_sec + 1e-9 * now.tv_nsec );
+}
+
+Abc::Abc( void )
+{
+  setNbDiploids( 10 );
+  setNbSitesPerChromosome( 31 );
+  setExpNbTEsPerIndividual( 10 );
+  setTotalMapDist( 90 );
+  setZygoteSelection( false );
+  setNbGenerations( 10 );
+  double vDefaults[ NB_ABC_PARAMS ] = { 0.01, 0.05, 0.005, 0.001, 1.5 };
+  for( int p=0; p<NB_ABC_PARAMS; ++p ){
+    Prior prior = { PRIOR_FIXED, vDefaults[p], vDefaults[p] };
+    setPrior( p, prior );
+  }
+  setNbParticles( 1000 );
+  setNbPriorDraws( 10000 );
+  setNbRounds( 1 );
+  setQuantile( 0.5 );
+  setNbThreads( 1 );
+  setMaxCopies( 0 );
+  setVerbose( 0 );
+  tolerance = 0;
+  nbSimulations = 0;
+  elapsedTime = 0;
+}
+
+string Abc::getParamName( int param )
+{
+  switch( param ){
+  case ABC_PROB_TRANSP0: return( "probTransp0" );
+  case ABC_K: return( "k" );
+  case ABC_PROB_LOSS: return( "probLoss" );
+  case ABC_SEL_MULT: return( "selMult" );
+  case ABC_SEL_EXP: return( "selExp" );
+  }
+  return( "" );
+}
+
+// e.g. "k=uniform:0:0.1", "probLoss=loguniform:1e-4:1e-2" or "selExp=2"
+bool Abc::parsePrior( string arg, int & param, Prior & prior )
+{
+  size_t pos = arg.find( '=' );
+  if( pos == string::npos )
+    return( false );
+  string name = arg.substr( 0, pos );
+  for( param=0; param<NB_ABC_PARAMS && getParamName( param ) != name; ++param );
+  if( param == NB_ABC_PARAMS )
+    return( false );
+  vector<string> vFields;
+  stringstream ss( arg.substr( pos + 1 ) );
+  string field;
+  while( getline( ss, field, ':' ) )
+    vFields.push_back( field );
+  if( vFields.size() == 1 ){
+    prior.type = PRIOR_FIXED;
+    prior.min = prior.max = atof( vFields[0].c_str() );
+    return( true );
+  }
+  if( vFields.size() != 3 )
+    return( false );
+  if( vFields[0] == "uniform" )
+    prior.type = PRIOR_UNIFORM;
+  else if( vFields[0] == "loguniform" )
+    prior.type = PRIOR_LOGUNIFORM;
+  else
+    return( false );
+  prior.min = atof( vFields[1].c_str() );
+  prior.max = atof( vFields[2].c_str() );
+  return( prior.min < prior.max
+          && ( prior.type != PRIOR_LOGUNIFORM || prior.min > 0 ) );
+}
+
+void Abc::setNbDiploids( int nd )
+{
+  nbDiploids = nd;
+}
+
+void Abc::setNbSitesPerChromosome( int spc )
+{
+  nbSitesPerChr = spc;
+}
+
+void Abc::setExpNbTEsPerIndividual( int nti )
+{
+  expNbTEsPerInd = nti;
+}
+
+void Abc::setTotalMapDist( int tmd )
+{
+  totalMapDist = tmd;
+}
+
+void Abc::setZygoteSelection( bool zs )
+{
+  zygoteSelection = zs;
+}
+
+void Abc::setNbGenerations( int ng )
+{
+  nbGen = ng;
+}
+
+void Abc::setPrior( int param, Prior prior )
+{
+  vPriors[ param ] = prior;
+}
+
+// statistics of the observed data, among Population::getAvailableStats()
+void Abc::setObserved( vector<string> vs, vector<double> vo )
+{
+  vStats = vs;
+  vObserved = vo;
+}
+
+void Abc::setNbParticles( int np )
+{
+  nbParticles = np;
+}
+
+// nb of simulations of the rejection round
+void Abc::setNbPriorDraws( int npd )
+{
+  nbPriorDraws = npd;
+}
+
+void Abc::setNbRounds( int nr )
+{
+  nbRounds = nr;
+}
+
+// quantile of the distances of the particles giving the next tolerance
+void Abc::setQuantile( double q )
+{
+  quantile = q;
+}
+
+void Abc::setNbThreads( int nt )
+{
+  nbThreads = nt;
+}
+
+// bound on the mean nb of TEs per individual (0 for none)
+void Abc::setMaxCopies( double mc )
+{
+  maxCopies = mc;
+}
+
+void Abc::setVerbose( int v )
+{
+  verbose = v;
+}
+
+void Abc::setRng( gsl_rng * rng )
+{
+  r = rng;
+}
+
+const vector<AbcDraw> & Abc::getParticles( void )
+{
+  return( vParticles );
+}
+
+const vector<double> & Abc::getWeights( void )
+{
+  return( vWeights );
+}
+
+double Abc::getTolerance( void )
+{
+  return( tolerance );
+}
+
+long Abc::getNbSimulations( void )
+{
+  return( nbSimulations );
+}
+
+AbcDraw Abc::drawFromPrior( void )
+{
+  AbcDraw draw;
+  for( int p=0; p<NB_ABC_PARAMS; ++p ){
+    const Prior & prior = vPriors[p];
+    if( prior.type == PRIOR_UNIFORM )
+      draw.vParams[p] = prior.min + ( prior.max - prior.min ) * gsl_rng_uniform( r );
+    else if( prior.type == PRIOR_LOGUNIFORM )
+      draw.vParams[p] = prior.min * exp( log( prior.max / prior.min )
+                                         * gsl_rng_uniform( r ) );
+    else
+      draw.vParams[p] = prior.min;
+  }
+  draw.seed = gsl_rng_get( r );
+  return( draw );
+}
+
+// a particle drawn on its weight, perturbed until within the priors
+AbcDraw Abc::drawFromParticles( const vector<double> & vSds )
+{
+  vector<double> vCumWeights( vWeights.size() );
+  partial_sum( vWeights.begin(), vWeights.end(), vCumWeights.begin() );
+  AbcDraw draw;
+  do{
+    double u = vCumWeights.back() * gsl_rng_uniform( r );
+    size_t j = upper_bound( vCumWeights.begin(), vCumWeights.end(), u )
+      - vCumWeights.begin();
+    if( j == vParticles.size() )
+      j = vParticles.size() - 1;
+    for( int p=0; p<NB_ABC_PARAMS; ++p ){
+      draw.vParams[p] = vParticles[j].vParams[p];
+      if( vPriors[p].type != PRIOR_FIXED )
+        draw.vParams[p] += gsl_ran_gaussian( r, vSds[p] );
+    }
+  } while( getPriorDensity( draw ) == 0 );
+  draw.seed = gsl_rng_get( r );
+  return( draw );
+}
+
+double Abc::getPriorDensity( const AbcDraw & draw )
+{
+  double density = 1;
+  for( int p=0; p<NB_ABC_PARAMS; ++p ){
+    const Prior & prior = vPriors[p];
+    double x = draw.vParams[p];
+    if( prior.type == PRIOR_FIXED )
+      continue;
+    if( x < prior.min || x > prior.max )
+      return( 0 );
+    if( prior.type == PRIOR_UNIFORM )
+      density /= prior.max - prior.min;
+    else
+      density /= x * log( prior.max / prior.min );
+  }
+  return( density );
+}
+
+// Euclidean distance to the observed statistics, each one scaled by its
+// standard deviation over the simulations of the rejection round
+double Abc::getDistance( const vector<double> & vValues )
+{
+  double sum = 0;
+  for( size_t i=0; i<vStats.size(); ++i ){
+    double diff = ( vValues[i] - vObserved[i] ) / vScales[i];
+    sum += diff * diff;
+  }
+  return( sqrt( sum ) );
+}
+
+void Abc::simulate( AbcDraw & draw )
+{
+  gsl_rng * rDraw = gsl_rng_alloc( r->type );
+  gsl_rng_set( rDraw, draw.seed );
+  float probTransp0 = draw.vParams[ ABC_PROB_TRANSP0 ];
+  float k = draw.vParams[ ABC_K ];
+  float probLoss = draw.vParams[ ABC_PROB_LOSS ];
+  Population pop;
+  pop.setNbDiploids( nbDiploids );
+  pop.setNbChrPerIndividual( 4 );
+  pop.setNbSitesPerChromosome( nbSitesPerChr );
+  pop.setExpNbTEsPerIndividual( expNbTEsPerInd );
+  pop.setTotalMapDist( totalMapDist );
+  pop.setZygoteSelection( zygoteSelection );
+  pop.setSelMultiplicator( draw.vParams[ ABC_SEL_MULT ] );
+  pop.setSelExponent( draw.vParams[ ABC_SEL_EXP ] );
+  pop.setVerbose( -1 );
+  pop.setRng( rDraw );
+  pop.setStats( vStats );
+  pop.setExitOnSaturation( false );
+  pop.initialize();
+  Population::GenerationKernel kernel = pop.getGenerationKernel( k );
+  draw.isStopped = false;
+  // without TEs the population doesn't change anymore
+  for( int g=1; g<=nbGen && pop.getSumNbTEs() > 0; ++g ){
+    if( maxCopies > 0 && pop.getSumNbTEs() > maxCopies * nbDiploids ){
+      draw.isStopped = true;
+      break;
+    }
+    (pop.*kernel)( probLoss, probTransp0, k );
+    if( pop.isSaturated() ){
+      draw.isStopped = true;
+      break;
+    }
+  }
+  pop.getStatsValues( draw.vStats );
+  gsl_rng_free( rDraw );
+}
+
+void Abc::runBatch( vector<AbcDraw> & vDraws )
+{
+  double start = getWallTime();
+  AbcBatch batch = { this, &vDraws, 0 };
+  vector<pthread_t> vThreads( nbThreads - 1 );
+  for( size_t t=0; t<vThreads.size(); ++t )
+    if( pthread_create( &vThreads[t], NULL, runWorker, &batch ) != 0 ){
+      cerr << "ERROR: can't start the simulation threads" << endl;
+      exit( EXIT_FAILURE );
+    }
+  runWorker( &batch );
+  for( size_t t=0; t<vThreads.size(); ++t )
+    pthread_join( vThreads[t], NULL );
+  nbSimulations += vDraws.size();
+  elapsedTime += getWallTime() - start;
+}
+
+void Abc::rejectionRound( void )
+{
+  vector<AbcDraw> vDraws;
+  for( int i=0; i<nbPriorDraws; ++i )
+    vDraws.push_back( drawFromPrior() );
+  runBatch( vDraws );
+
+  vScales.assign( vStats.size(), 1 );
+  for( size_t s=0; s<vStats.size(); ++s ){
+    double n = 0, mean = 0, m2 = 0;
+    for( size_t i=0; i<vDraws.size(); ++i )
+      if( ! vDraws[i].isStopped ){
+        n += 1;
+        double delta = vDraws[i].vStats[s] - mean;
+        mean += delta / n;
+        m2 += delta * ( vDraws[i].vStats[s] - mean );
+      }
+    if( n > 1 && m2 > 0 )
+      vScales[s] = sqrt( m2 / ( n - 1 ) );
+  }
+
+  vector< pair<double,int> > vSorted;
+  for( size_t i=0; i<vDraws.size(); ++i )
+    if( ! vDraws[i].isStopped ){
+      vDraws[i].distance = getDistance( vDraws[i].vStats );
+      vSorted.push_back( make_pair( vDraws[i].distance, (int) i ) );
+    }
+  sort( vSorted.begin(), vSorted.end() );
+  vParticles.clear();
+  for( size_t i=0; i<vSorted.size() && (int) i<nbParticles; ++i )
+    vParticles.push_back( vDraws[ vSorted[i].second ] );
+  if( vParticles.empty() ){
+    cerr << "ERROR: all the simulations exceeded the copy-number bound" << endl;
+    exit( EXIT_FAILURE );
+  }
+  tolerance = vParticles.back().distance;
+  vWeights.assign( vParticles.size(), 1.0 / vParticles.size() );
+}
+
+void Abc::smcRound( void )
+{
+  vector<double> vDistances;
+  for( size_t j=0; j<vParticles.size(); ++j )
+    vDistances.push_back( vParticles[j].distance );
+  sort( vDistances.begin(), vDistances.end() );
+  tolerance = vDistances[ (size_t) ( quantile * ( vDistances.size() - 1 ) ) ];
+
+  // Gaussian kernel of twice the weighted variance of the particles
+  vector<double> vSds( NB_ABC_PARAMS, 0 );
+  for( int p=0; p<NB_ABC_PARAMS; ++p ){
+    if( vPriors[p].type == PRIOR_FIXED )
+      continue;
+    double mean = 0, var = 0;
+    for( size_t j=0; j<vParticles.size(); ++j )
+      mean += vWeights[j] * vParticles[j].vParams[p];
+    for( size_t j=0; j<vParticles.size(); ++j )
+      var += vWeights[j] * pow( vParticles[j].vParams[p] - mean, 2 );
+    vSds[p] = sqrt( 2 * var );
+    if( vSds[p] == 0 )
+      vSds[p] = 1e-3 * ( vPriors[p].max - vPriors[p].min );
+  }
+
+  // batches of proposals, accepted in their order until enough particles
+  vector<AbcDraw> vAccepted;
+  long nbProposals = 0, maxProposals = 1000L * nbParticles;
+  while( (int) vAccepted.size() < nbParticles && nbProposals < maxProposals ){
+    vector<AbcDraw> vDraws;
+    for( int i=0; i<nbParticles; ++i )
+      vDraws.push_back( drawFromParticles( vSds ) );
+    runBatch( vDraws );
+    nbProposals += vDraws.size();
+    for( size_t i=0; i<vDraws.size() && (int) vAccepted.size()<nbParticles; ++i )
+      if( ! vDraws[i].isStopped ){
+        vDraws[i].distance = getDistance( vDraws[i].vStats );
+        if( vDraws[i].distance <= tolerance )
+          vAccepted.push_back( vDraws[i] );
+      }
+  }
+  if( vAccepted.empty() ){
+    cerr << "ERROR: no simulation within tolerance " << tolerance << endl;
+    exit( EXIT_FAILURE );
+  }
+
+  vector<double> vNewWeights( vAccepted.size() );
+  double sumWeights = 0;
+  for( size_t i=0; i<vAccepted.size(); ++i ){
+    double proposal = 0;
+    for( size_t j=0; j<vParticles.size(); ++j ){
+      double kernel = vWeights[j];
+      for( int p=0; p<NB_ABC_PARAMS; ++p )
+        if( vPriors[p].type != PRIOR_FIXED )
+          kernel *= gsl_ran_gaussian_pdf( vAccepted[i].vParams[p]
+                                          - vParticles[j].vParams[p], vSds[p] );
+      proposal += kernel;
+    }
+    vNewWeights[i] = getPriorDensity( vAccepted[i] ) / proposal;
+    sumWeights += vNewWeights[i];
+  }
+  for( size_t i=0; i<vNewWeights.size(); ++i )
+    vNewWeights[i] /= sumWeights;
+  vParticles.swap( vAccepted );
+  vWeights.swap( vNewWeights );
+}
+
+void Abc::writeParticles( ostream & out, int round )
+{
+  string sep = "\t";
+  for( size_t j=0; j<vParticles.size(); ++j ){
+    out << round << sep << j+1 << sep << vWeights[j] << sep
+        << vParticles[j].distance;
+    for( int p=0; p<NB_ABC_PARAMS; ++p )
+      out << sep << vParticles[j].vParams[p];
+    for( size_t s=0; s<vStats.size(); ++s )
+      out << sep << vParticles[j].vStats[s];
+    out << endl;
+  }
+}
+
+// writes the particles of each round, with their weight and distance
+void Abc::run( ostream & out )
+{
+  string sep = "\t";
+  out << "round" << sep << "particle" << sep << "weight" << sep << "distance";
+  for( int p=0; p<NB_ABC_PARAMS; ++p )
+    out << sep << getParamName( p );
+  for( size_t s=0; s<vStats.size(); ++s )
+    out << sep << vStats[s];
+  out << endl;
+
+  nbSimulations = 0;
+  for( int round=1; round<=nbRounds; ++round ){
+    long nbSimusBefore = nbSimulations;
+    elapsedTime = 0;
+    if( round == 1 )
+      rejectionRound();
+    else
+      smcRound();
+    writeParticles( out, round );
+    long nbSimus = nbSimulations - nbSimusBefore;
+    if( verbose > 0 )
+      cout << "round " << round << ": tolerance=" << tolerance
+           << " simulations=" << nbSimus
+           << " acceptance=" << setprecision(3)
+           << vParticles.size() / (double) nbSimus
+           << " simulations/s=" << nbSimus / elapsedTime
+           << setprecision(6) << endl;
+  }
+}
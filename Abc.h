@@ -0,0 +1,133 @@
+/*
+ * \file Abc.h
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ABC_H
+#define ABC_H
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include "gsl/gsl_rng.h"
+using namespace std;
+
+// parameters which can be fitted, in the order of the particles
+enum { ABC_PROB_TRANSP0, ABC_K, ABC_PROB_LOSS, ABC_SEL_MULT, ABC_SEL_EXP,
+       NB_ABC_PARAMS };
+
+enum { PRIOR_FIXED, PRIOR_UNIFORM, PRIOR_LOGUNIFORM };
+
+struct Prior
+{
+  int type;
+  double min;
+  double max;  // same as min if fixed
+};
+
+// one simulation of the model with drawn parameters
+struct AbcDraw
+{
+  double vParams[ NB_ABC_PARAMS ];
+  unsigned long seed;
+  vector<double> vStats;  // at the last generation
+  bool isStopped;  // stopped as out of the copy-number bound or saturated
+  double distance;
+};
+
+// Approximate Bayesian Computation of the transposition, regulation, loss
+// and selection parameters from observed statistics (columns of the output
+// of modelCC83 at the last generation). The first round is a rejection
+// step: simulations with parameters drawn from the priors, of which the
+// particles are the closest ones. Each following round is a step of
+// SMC-ABC (Beaumont et al, 2009, Biometrika): the tolerance is a quantile
+// of the distances of the previous particles, and the new particles are
+// perturbed previous ones, weighted by their prior over their proposal.
+// The simulations of a round run on several threads; their parameters and
+// seeds are drawn beforehand, so that the results don't depend on the nb
+// of threads. A simulation stops as soon as its TEs are lost, its
+// statistics being then final, or once the mean copy number exceeds a
+// bound or an individual has no more empty sites; such a simulation is
+// rejected.
+class Abc
+{
+  int nbDiploids;
+  int nbSitesPerChr;
+  int expNbTEsPerInd;
+  int totalMapDist;
+  bool zygoteSelection;
+  int nbGen;
+  Prior vPriors[ NB_ABC_PARAMS ];
+  vector<string> vStats;
+  vector<double> vObserved;
+  vector<double> vScales;
+  int nbParticles;
+  int nbPriorDraws;
+  int nbRounds;
+  double quantile;
+  int nbThreads;
+  double maxCopies;
+  int verbose;
+  gsl_rng * r;
+
+  vector<AbcDraw> vParticles;
+  vector<double> vWeights;
+  double tolerance;
+  long nbSimulations;
+  double elapsedTime;
+
+  AbcDraw drawFromPrior( void );
+  AbcDraw drawFromParticles( const vector<double> & );
+  double getPriorDensity( const AbcDraw & );
+  double getDistance( const vector<double> & );
+  void runBatch( vector<AbcDraw> & );
+  void rejectionRound( void );
+  void smcRound( void );
+  void writeParticles( ostream &, int );
+
+ public:
+  Abc( void );
+
+  static string getParamName( int );
+  static bool parsePrior( string, int &, Prior & );
+
+  void setNbDiploids( int );
+  void setNbSitesPerChromosome( int );
+  void setExpNbTEsPerIndividual( int );
+  void setTotalMapDist( int );
+  void setZygoteSelection( bool );
+  void setNbGenerations( int );
+  void setPrior( int, Prior );
+  void setObserved( vector<string>, vector<double> );
+  void setNbParticles( int );
+  void setNbPriorDraws( int );
+  void setNbRounds( int );
+  void setQuantile( double );
+  void setNbThreads( int );
+  void setMaxCopies( double );
+  void setVerbose( int );
+  void setRng( gsl_rng * );
+
+  const vector<AbcDraw> & getParticles( void );
+  const vector<double> & getWeights( void );
+  double getTolerance( void );
+  long getNbSimulations( void );
+
+  void simulate( AbcDraw & );
+  void run( ostream & );
+};
+
+#endif
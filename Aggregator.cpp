@@ -0,0 +1,382 @@
+/*
+ * \file Aggregator.cpp
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>  // for sort
+#include <utility>  // for pair
+using namespace std;
+
+#include "Aggregator.h"
+
+RunningStats::RunningStats( void )
+{
+  n = 0;
+  mean = 0;
+  m2 = 0;
+  nbCompactions = 0;
+}
+
+double RunningStats::getMean( void ) const
+{
+  return( n > 0 ? mean : 0 );
+}
+
+// with n-1 in the denominator, as for the columns of the replicates
+double RunningStats::getVariance( void ) const
+{
+  return( n > 1 ? m2 / ( n - 1 ) : 0 );
+}
+
+// smallest value whose cumulative weight reaches the given fraction
+double RunningStats::getQuantile( double prob ) const
+{
+  vector< pair<double,double> > vWeighted;
+  double weight = 1, sumWeights = 0;
+  for( size_t h=0; h<vLevels.size(); ++h, weight*=2 )
+    for( size_t i=0; i<vLevels[h].size(); ++i ){
+      vWeighted.push_back( make_pair( vLevels[h][i], weight ) );
+      sumWeights += weight;
+    }
+  if( vWeighted.empty() )
+    return( 0 );
+  sort( vWeighted.begin(), vWeighted.end() );
+  double cumWeight = 0;
+  for( size_t i=0; i<vWeighted.size(); ++i ){
+    cumWeight += vWeighted[i].second;
+    if( cumWeight >= prob * sumWeights )
+      return( vWeighted[i].first );
+  }
+  return( vWeighted.back().first );
+}
+
+void RunningStats::compact( size_t h )
+{
+  if( h + 1 == vLevels.size() )
+    vLevels.push_back( vector<double>() );
+  vector<double> & vLevel = vLevels[h];
+  sort( vLevel.begin(), vLevel.end() );
+  size_t offset = nbCompactions++ & 1;
+  size_t nbPairs = vLevel.size() / 2;
+  for( size_t i=0; i<nbPairs; ++i )
+    vLevels[h+1].push_back( vLevel[ 2*i + offset ] );
+  // an odd value out stays at its level
+  vLevel.erase( vLevel.begin(), vLevel.begin() + 2 * nbPairs );
+  if( vLevels[h+1].size() >= SKETCH_SIZE )
+    compact( h + 1 );
+}
+
+void RunningStats::add( double x )
+{
+  n += 1;
+  double delta = x - mean;
+  mean += delta / n;
+  m2 += delta * ( x - mean );
+  if( vLevels.empty() )
+    vLevels.push_back( vector<double>() );
+  vLevels[0].push_back( x );
+  if( vLevels[0].size() >= SKETCH_SIZE )
+    compact( 0 );
+}
+
+void RunningStats::merge( const RunningStats & other )
+{
+  if( other.n == 0 )
+    return;
+  double nbTot = n + other.n;
+  double delta = other.mean - mean;
+  mean += delta * other.n / nbTot;
+  m2 += other.m2 + delta * delta * n * other.n / nbTot;
+  n = nbTot;
+  if( vLevels.size() < other.vLevels.size() )
+    vLevels.resize( other.vLevels.size() );
+  for( size_t h=0; h<other.vLevels.size(); ++h )
+    vLevels[h].insert( vLevels[h].end(), other.vLevels[h].begin(),
+                       other.vLevels[h].end() );
+  for( size_t h=0; h<vLevels.size(); ++h )
+    if( vLevels[h].size() >= SKETCH_SIZE )
+      compact( h );
+}
+
+void RunningStats::write( FILE * fp ) const
+{
+  double moments[3] = { n, mean, m2 };
+  uint32_t header[2] = { nbCompactions, (uint32_t) vLevels.size() };
+  fwrite( moments, sizeof(double), 3, fp );
+  fwrite( header, sizeof(uint32_t), 2, fp );
+  for( size_t h=0; h<vLevels.size(); ++h ){
+    uint32_t size = vLevels[h].size();
+    fwrite( &size, sizeof(uint32_t), 1, fp );
+    if( size > 0 )
+      fwrite( &vLevels[h][0], sizeof(double), size, fp );
+  }
+}
+
+bool RunningStats::read( FILE * fp )
+{
+  double moments[3];
+  uint32_t header[2];
+  if( fread( moments, sizeof(double), 3, fp ) != 3
+      || fread( header, sizeof(uint32_t), 2, fp ) != 2 )
+    return( false );
+  n = moments[0];
+  mean = moments[1];
+  m2 = moments[2];
+  nbCompactions = header[0];
+  vLevels.assign( header[1], vector<double>() );
+  for( size_t h=0; h<vLevels.size(); ++h ){
+    uint32_t size;
+    if( fread( &size, sizeof(uint32_t), 1, fp ) != 1 )
+      return( false );
+    vLevels[h].resize( size );
+    if( size > 0 && fread( &vLevels[h][0], sizeof(double), size, fp ) != size )
+      return( false );
+  }
+  return( true );
+}
+
+Aggregator::Aggregator( void )
+{
+  headerText = "";
+  vQuantiles.push_back( 0.05 );
+  vQuantiles.push_back( 0.5 );
+  vQuantiles.push_back( 0.95 );
+  nbReplicates = 0;
+}
+
+void Aggregator::setHeaderText( string ht )
+{
+  headerText = ht;
+}
+
+void Aggregator::setStats( vector<string> vs )
+{
+  vStats = vs;
+  vNbExtinctions.clear();
+  vGenStats.clear();
+}
+
+void Aggregator::setQuantiles( vector<double> vq )
+{
+  vQuantiles = vq;
+}
+
+string Aggregator::getHeaderText( void ) const
+{
+  return( headerText );
+}
+
+vector<string> Aggregator::getStats( void ) const
+{
+  return( vStats );
+}
+
+vector<double> Aggregator::getQuantiles( void ) const
+{
+  return( vQuantiles );
+}
+
+int64_t Aggregator::getNbReplicates( void ) const
+{
+  return( nbReplicates );
+}
+
+int Aggregator::getNbGenerations( void ) const
+{
+  return( vGenStats.size() );
+}
+
+const RunningStats & Aggregator::getRunningStats( int gen, int stat ) const
+{
+  return( vGenStats[gen][stat] );
+}
+
+// fraction of the replicates which lost their TEs at this generation or
+// before
+double Aggregator::getExtinctFraction( int gen ) const
+{
+  int64_t nbExtinct = 0;
+  for( int g=0; g<=gen && g<(int)vNbExtinctions.size(); ++g )
+    nbExtinct += vNbExtinctions[g];
+  return( nbReplicates > 0 ? (double) nbExtinct / nbReplicates : 0 );
+}
+
+void Aggregator::resizeGenerations( size_t nbGens )
+{
+  if( vGenStats.size() >= nbGens )
+    return;
+  vNbExtinctions.resize( nbGens, 0 );
+  vGenStats.resize( nbGens, vector<RunningStats>( vStats.size() ) );
+}
+
+void Aggregator::addReplicate( void )
+{
+  ++ nbReplicates;
+}
+
+// values of the statistics of one replicate at the given generation
+void Aggregator::add( int gen, const vector<double> & vValues )
+{
+  resizeGenerations( gen + 1 );
+  for( size_t i=0; i<vStats.size(); ++i )
+    vGenStats[gen][i].add( vValues[i] );
+}
+
+void Aggregator::addExtinction( int gen )
+{
+  resizeGenerations( gen + 1 );
+  ++ vNbExtinctions[gen];
+}
+
+// returns false if the other aggregate has different columns
+bool Aggregator::merge( const Aggregator & other )
+{
+  if( other.vStats != vStats || other.vQuantiles != vQuantiles )
+    return( false );
+  nbReplicates += other.nbReplicates;
+  resizeGenerations( other.vGenStats.size() );
+  for( size_t g=0; g<other.vGenStats.size(); ++g ){
+    vNbExtinctions[g] += other.vNbExtinctions[g];
+    for( size_t i=0; i<vStats.size(); ++i )
+      vGenStats[g][i].merge( other.vGenStats[g][i] );
+  }
+  return( true );
+}
+
+void Aggregator::save( string stateFile ) const
+{
+  FILE * fp = fopen( stateFile.c_str(), "wb" );
+  if( fp == NULL ){
+    cerr << "ERROR: can't open file " << stateFile << endl;
+    exit( EXIT_FAILURE );
+  }
+  uint32_t header[2] = { AGGREGATE_VERSION, (uint32_t) headerText.size() };
+  fwrite( AGGREGATE_MAGIC, 1, 8, fp );
+  fwrite( header, sizeof(uint32_t), 2, fp );
+  fwrite( headerText.c_str(), 1, headerText.size(), fp );
+  uint32_t nbStats = vStats.size();
+  fwrite( &nbStats, sizeof(uint32_t), 1, fp );
+  for( size_t i=0; i<vStats.size(); ++i ){
+    uint32_t length = vStats[i].size();
+    fwrite( &length, sizeof(uint32_t), 1, fp );
+    fwrite( vStats[i].c_str(), 1, length, fp );
+  }
+  uint32_t nbQuantiles = vQuantiles.size();
+  fwrite( &nbQuantiles, sizeof(uint32_t), 1, fp );
+  if( nbQuantiles > 0 )
+    fwrite( &vQuantiles[0], sizeof(double), nbQuantiles, fp );
+  uint32_t nbGens = vGenStats.size();
+  fwrite( &nbReplicates, sizeof(int64_t), 1, fp );
+  fwrite( &nbGens, sizeof(uint32_t), 1, fp );
+  for( size_t g=0; g<vGenStats.size(); ++g ){
+    fwrite( &vNbExtinctions[g], sizeof(int64_t), 1, fp );
+    for( size_t i=0; i<vStats.size(); ++i )
+      vGenStats[g][i].write( fp );
+  }
+  if( ferror( fp ) || fclose( fp ) != 0 ){
+    cerr << "ERROR: can't write file " << stateFile << endl;
+    exit( EXIT_FAILURE );
+  }
+}
+
+void Aggregator::load( string stateFile )
+{
+  FILE * fp = fopen( stateFile.c_str(), "rb" );
+  if( fp == NULL ){
+    cerr << "ERROR: can't open file " << stateFile << endl;
+    exit( EXIT_FAILURE );
+  }
+  char magic[8];
+  uint32_t header[2];
+  if( fread( magic, 1, 8, fp ) != 8 || memcmp( magic, AGGREGATE_MAGIC, 8 ) != 0
+      || fread( header, sizeof(uint32_t), 2, fp ) != 2
+      || header[0] != AGGREGATE_VERSION ){
+    cerr << "ERROR: " << stateFile << " is not an aggregate of this version"
+         << endl;
+    exit( EXIT_FAILURE );
+  }
+  bool isOk = true;
+  headerText.assign( header[1], ' ' );
+  if( header[1] > 0 )
+    isOk = fread( &headerText[0], 1, header[1], fp ) == header[1];
+  uint32_t nbStats = 0, nbQuantiles = 0, nbGens = 0;
+  isOk = isOk && fread( &nbStats, sizeof(uint32_t), 1, fp ) == 1;
+  vector<string> vNames;
+  for( uint32_t i=0; isOk && i<nbStats; ++i ){
+    uint32_t length = 0;
+    isOk = fread( &length, sizeof(uint32_t), 1, fp ) == 1;
+    string name( length, ' ' );
+    if( isOk && length > 0 )
+      isOk = fread( &name[0], 1, length, fp ) == length;
+    vNames.push_back( name );
+  }
+  setStats( vNames );
+  isOk = isOk && fread( &nbQuantiles, sizeof(uint32_t), 1, fp ) == 1;
+  vQuantiles.assign( isOk ? nbQuantiles : 0, 0 );
+  if( isOk && nbQuantiles > 0 )
+    isOk = fread( &vQuantiles[0], sizeof(double), nbQuantiles, fp )
+      == nbQuantiles;
+  isOk = isOk && fread( &nbReplicates, sizeof(int64_t), 1, fp ) == 1
+    && fread( &nbGens, sizeof(uint32_t), 1, fp ) == 1;
+  if( isOk )
+    resizeGenerations( nbGens );
+  for( uint32_t g=0; isOk && g<nbGens; ++g ){
+    isOk = fread( &vNbExtinctions[g], sizeof(int64_t), 1, fp ) == 1;
+    for( size_t i=0; isOk && i<vStats.size(); ++i )
+      isOk = vGenStats[g][i].read( fp );
+  }
+  fclose( fp );
+  if( ! isOk ){
+    cerr << "ERROR: can't read the aggregate " << stateFile << endl;
+    exit( EXIT_FAILURE );
+  }
+}
+
+// one row per generation: nb of replicates with a row, fraction of extinct
+// replicates, then for each statistic its mean, variance and quantiles
+// over the replicates ("NA" if none)
+void Aggregator::writeTable( ostream & out ) const
+{
+  string sep = "\t";
+  out << headerText;
+  out << "#nbReplicates=" << nbReplicates << endl;
+  out << "gen" << sep << "nbSimu" << sep << "extinct";
+  for( size_t i=0; i<vStats.size(); ++i ){
+    out << sep << vStats[i] << "_mean" << sep << vStats[i] << "_var";
+    for( size_t q=0; q<vQuantiles.size(); ++q )
+      out << sep << vStats[i] << "_q" << 100 * vQuantiles[q];
+  }
+  out << endl;
+  for( size_t g=0; g<vGenStats.size(); ++g ){
+    double nbRows = vStats.empty() ? 0 : vGenStats[g][0].getNb();
+    out << g << sep << nbRows << sep << getExtinctFraction( g );
+    for( size_t i=0; i<vStats.size(); ++i ){
+      const RunningStats & stats = vGenStats[g][i];
+      if( nbRows == 0 ){
+        for( size_t j=0; j<2+vQuantiles.size(); ++j )
+          out << sep << "NA";
+        continue;
+      }
+      out << sep << stats.getMean() << sep << stats.getVariance();
+      for( size_t q=0; q<vQuantiles.size(); ++q )
+        out << sep << stats.getQuantile( vQuantiles[q] );
+    }
+    out << endl;
+  }
+}
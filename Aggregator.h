@@ -0,0 +1,114 @@
+/*
+ * \file Aggregator.h
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef AGGREGATOR_H
+#define AGGREGATOR_H
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdio>
+#include <stdint.h>
+using namespace std;
+
+// Layout of a state file (native little-endian):
+//  - "CC83AGG1", uint32 version, uint32 length of the header text
+//  - header text: the "#key=value" parameters of the run
+//  - uint32 nb of statistics, then for each one its length and its name
+//  - uint32 nb of quantiles, their probabilities as doubles
+//  - int64 nb of replicates, uint32 nb of generations
+//  - for each generation: int64 nb of extinctions, then for each statistic
+//    see RunningStats::write()
+#define AGGREGATE_MAGIC "CC83AGG1"
+#define AGGREGATE_VERSION 1
+#define SKETCH_SIZE 128
+
+// Summary of a stream of values which can be merged with the summary of
+// another stream: count, mean and variance (Welford, with the pairwise
+// update of Chan et al. to merge), and approximate quantiles from a
+// compactor sketch (Karnin, Lang & Liberty, 2016). A level holds at most
+// SKETCH_SIZE values of weight 2^level; when full, it is sorted and every
+// other value goes up one level. The quantiles are exact as long as fewer
+// than SKETCH_SIZE values were added.
+class RunningStats
+{
+  double n;
+  double mean;
+  double m2;
+  vector< vector<double> > vLevels;
+  uint32_t nbCompactions;  // alternates the values kept by a compaction
+
+  void compact( size_t );
+
+ public:
+  RunningStats( void );
+
+  double getNb( void ) const { return( n ); }
+  double getMean( void ) const;
+  double getVariance( void ) const;
+  double getQuantile( double ) const;
+
+  void add( double );
+  void merge( const RunningStats & );
+  void write( FILE * ) const;
+  bool read( FILE * );
+};
+
+// Statistics of all the replicates at each generation, gathered as the
+// simulations go so that the rows of each replicate needn't be kept. The
+// aggregate of a generation is what grouping by generation the rows of all
+// the replicates would give; a replicate which lost its TEs has no row
+// afterwards, but counts as extinct. Aggregates of separate threads or runs
+// with the same statistics can be merged.
+class Aggregator
+{
+  string headerText;
+  vector<string> vStats;
+  vector<double> vQuantiles;
+  int64_t nbReplicates;
+  vector<int64_t> vNbExtinctions;  // replicates losing their TEs at each gen
+  vector< vector<RunningStats> > vGenStats;
+
+  void resizeGenerations( size_t );
+
+ public:
+  Aggregator( void );
+
+  void setHeaderText( string );
+  void setStats( vector<string> );
+  void setQuantiles( vector<double> );
+
+  string getHeaderText( void ) const;
+  vector<string> getStats( void ) const;
+  vector<double> getQuantiles( void ) const;
+  int64_t getNbReplicates( void ) const;
+  int getNbGenerations( void ) const;
+  const RunningStats & getRunningStats( int, int ) const;
+  double getExtinctFraction( int ) const;
+
+  void addReplicate( void );
+  void add( int, const vector<double> & );
+  void addExtinction( int );
+  bool merge( const Aggregator & );
+
+  void save( string ) const;
+  void load( string );
+  void writeTable( ostream & ) const;
+};
+
+#endif
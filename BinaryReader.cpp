@@ -0,0 +1,244 @@
+/*
+ * \file BinaryReader.cpp
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+using namespace std;
+
+#include "BinaryReader.h"
+#include "BinaryWriter.h"
+
+static size_t padTo8( size_t size )
+{
+  return( ( size + 7 ) & ~( (size_t) 7 ) );
+}
+
+BinaryReader::BinaryReader( void )
+{
+  fd = -1;
+  fileSize = 0;
+  data = NULL;
+  nbRows = 0;
+}
+
+BinaryReader::~BinaryReader( void )
+{
+  close();
+}
+
+bool BinaryReader::open( string inFile )
+{
+  close();
+  fd = ::open( inFile.c_str(), O_RDONLY );
+  if( fd < 0 ){
+    cerr << "ERROR: can't open file " << inFile << endl;
+    return( false );
+  }
+  struct stat stFileInfo;
+  fstat( fd, &stFileInfo );
+  fileSize = stFileInfo.st_size;
+  if( fileSize < 16 ){
+    cerr << "ERROR: file " << inFile << " is too small" << endl;
+    close();
+    return( false );
+  }
+  void * addr = mmap( NULL, fileSize, PROT_READ, MAP_SHARED, fd, 0 );
+  if( addr == MAP_FAILED ){
+    cerr << "ERROR: can't memory-map file " << inFile << endl;
+    close();
+    return( false );
+  }
+  data = (const char *) addr;
+  if( memcmp( data, BINARY_MAGIC, 8 ) != 0
+      || *( (const uint32_t *)( data + 8 ) ) != BINARY_VERSION ){
+    cerr << "ERROR: file " << inFile << " is not a binary output" << endl;
+    close();
+    return( false );
+  }
+  uint32_t length = *( (const uint32_t *)( data + 12 ) );
+  parseHeader( string( data + 16, length ) );
+
+  // index the blocks
+  size_t offset = 16 + padTo8( length );
+  while( offset + 8 <= fileSize ){
+    const uint32_t * blockHeader = (const uint32_t *)( data + offset );
+    if( blockHeader[1] == BINARY_BLOCK_TRAILER ){
+      trailerText = string( data + offset + 8, blockHeader[0] );
+      break;
+    }
+    vBlockOffsets.push_back( offset + 8 );
+    vBlockNbRows.push_back( blockHeader[0] );
+    nbRows += blockHeader[0];
+    offset += 8;
+    for( size_t c=0; c<vColNames.size(); ++c )
+      offset += padTo8( blockHeader[0] * ( vColIsInt[c] ? 4 : 8 ) );
+  }
+  if( offset > fileSize ){
+    cerr << "WARNING: file " << inFile << " is truncated" << endl;
+    vBlockOffsets.pop_back();
+    nbRows -= vBlockNbRows.back();
+    vBlockNbRows.pop_back();
+  }
+  return( true );
+}
+
+void BinaryReader::close( void )
+{
+  if( data != NULL )
+    munmap( (void *) data, fileSize );
+  if( fd >= 0 )
+    ::close( fd );
+  fd = -1;
+  data = NULL;
+  fileSize = 0;
+  nbRows = 0;
+  vParamKeys.clear();
+  vParamValues.clear();
+  vColNames.clear();
+  vColIsInt.clear();
+  vColIsDelta.clear();
+  vBlockOffsets.clear();
+  vBlockNbRows.clear();
+  trailerText.clear();
+}
+
+void BinaryReader::parseHeader( string text )
+{
+  stringstream ss( text );
+  string line;
+  while( getline( ss, line ) ){
+    size_t pos = line.find( '=' );
+    if( pos == string::npos )
+      continue;
+    string key = line.substr( 0, pos ), value = line.substr( pos+1 );
+    if( key == "column" ){
+      stringstream ssCol( value );
+      string name, type, encoding;
+      ssCol >> name >> type >> encoding;
+      vColNames.push_back( name );
+      vColIsInt.push_back( type == "i32" );
+      vColIsDelta.push_back( encoding == "delta" );
+    }
+    else{
+      vParamKeys.push_back( key );
+      vParamValues.push_back( value );
+    }
+  }
+}
+
+vector<string> BinaryReader::getParameterKeys( void )
+{
+  return( vParamKeys );
+}
+
+string BinaryReader::getParameter( string key )
+{
+  for( size_t i=0; i<vParamKeys.size(); ++i )
+    if( vParamKeys[i] == key )
+      return( vParamValues[i] );
+  return( "" );
+}
+
+string BinaryReader::getTrailer( void )
+{
+  return( trailerText );
+}
+
+int BinaryReader::getNbColumns( void )
+{
+  return( vColNames.size() );
+}
+
+string BinaryReader::getColumnName( int col )
+{
+  return( vColNames[col] );
+}
+
+int BinaryReader::getColumnIndex( string name )
+{
+  for( size_t c=0; c<vColNames.size(); ++c )
+    if( vColNames[c] == name )
+      return( c );
+  return( -1 );
+}
+
+bool BinaryReader::isIntegerColumn( int col )
+{
+  return( vColIsInt[col] );
+}
+
+bool BinaryReader::isDeltaColumn( int col )
+{
+  return( vColIsDelta[col] );
+}
+
+int BinaryReader::getNbBlocks( void )
+{
+  return( vBlockOffsets.size() );
+}
+
+int BinaryReader::getNbRowsInBlock( int block )
+{
+  return( vBlockNbRows[block] );
+}
+
+size_t BinaryReader::getNbRows( void )
+{
+  return( nbRows );
+}
+
+// pointer into the mapped file: for a delta column, values are the
+// differences with the previous row of the block
+const int32_t * BinaryReader::getBlockColumnInt( int block, int col )
+{
+  size_t offset = vBlockOffsets[block];
+  for( int c=0; c<col; ++c )
+    offset += padTo8( vBlockNbRows[block] * ( vColIsInt[c] ? 4 : 8 ) );
+  return( (const int32_t *)( data + offset ) );
+}
+
+const double * BinaryReader::getBlockColumnDouble( int block, int col )
+{
+  return( (const double *) getBlockColumnInt( block, col ) );
+}
+
+void BinaryReader::getColumn( int col, vector<double> & vValues )
+{
+  vValues.clear();
+  vValues.reserve( nbRows );
+  for( int b=0; b<getNbBlocks(); ++b ){
+    int n = vBlockNbRows[b];
+    if( vColIsInt[col] ){
+      const int32_t * p = getBlockColumnInt( b, col );
+      int32_t value = 0;
+      for( int i=0; i<n; ++i ){
+        value = ( vColIsDelta[col] && i > 0 ) ? value + p[i] : p[i];
+        vValues.push_back( value );
+      }
+    }
+    else{
+      const double * p = getBlockColumnDouble( b, col );
+      vValues.insert( vValues.end(), p, p + n );
+    }
+  }
+}
@@ -0,0 +1,73 @@
+/*
+ * \file BinaryReader.h
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BINARYREADER_H
+#define BINARYREADER_H
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+using namespace std;
+
+// Memory-maps a file written by BinaryWriter. Plain columns are accessed
+// block by block without any copy; delta-encoded columns are decoded on
+// request by getColumn().
+class BinaryReader
+{
+  int fd;
+  size_t fileSize;
+  const char * data;
+
+  vector<string> vParamKeys;
+  vector<string> vParamValues;
+  vector<string> vColNames;
+  vector<bool> vColIsInt;
+  vector<bool> vColIsDelta;
+  vector<size_t> vBlockOffsets;
+  vector<int> vBlockNbRows;
+  size_t nbRows;
+  string trailerText;
+
+  void parseHeader( string );
+
+ public:
+  BinaryReader( void );
+  ~BinaryReader( void );
+
+  bool open( string );
+  void close( void );
+
+  vector<string> getParameterKeys( void );
+  string getParameter( string );
+  string getTrailer( void );
+
+  int getNbColumns( void );
+  string getColumnName( int );
+  int getColumnIndex( string );
+  bool isIntegerColumn( int );
+  bool isDeltaColumn( int );
+
+  int getNbBlocks( void );
+  int getNbRowsInBlock( int );
+  size_t getNbRows( void );
+  const int32_t * getBlockColumnInt( int, int );
+  const double * getBlockColumnDouble( int, int );
+  void getColumn( int, vector<double> & );
+};
+
+#endif
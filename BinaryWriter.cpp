@@ -0,0 +1,197 @@
+/*
+ * \file BinaryWriter.cpp
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>  // for ftruncate
+using namespace std;
+
+#include "BinaryWriter.h"
+
+BinaryWriter::BinaryWriter( void )
+{
+  fp = NULL;
+  nbRows = 0;
+  setNbRowsPerBlock( 4096 );
+  setDeltaEncoding( false );
+}
+
+BinaryWriter::~BinaryWriter( void )
+{
+  if( fp != NULL )
+    close( "" );
+}
+
+void BinaryWriter::setNbRowsPerBlock( int nrb )
+{
+  nbRowsPerBlock = nrb;
+}
+
+void BinaryWriter::setDeltaEncoding( bool de )
+{
+  deltaEncoding = de;
+}
+
+void BinaryWriter::setHeaderText( string ht )
+{
+  headerText = ht;
+}
+
+// the "simu" and "gen" columns are always written first
+void BinaryWriter::setColumns( vector<string> vNames, vector<bool> vIsInt )
+{
+  vColNames.clear();
+  vColIsInt.clear();
+  vColNames.push_back( "simu" );
+  vColIsInt.push_back( true );
+  vColNames.push_back( "gen" );
+  vColIsInt.push_back( true );
+  vColNames.insert( vColNames.end(), vNames.begin(), vNames.end() );
+  vColIsInt.insert( vColIsInt.end(), vIsInt.begin(), vIsInt.end() );
+  vIntBuffers.assign( vColNames.size(), vector<int32_t>() );
+  vDoubleBuffers.assign( vColNames.size(), vector<double>() );
+}
+
+int BinaryWriter::getNbRowsPerBlock( void )
+{
+  return( nbRowsPerBlock );
+}
+
+bool BinaryWriter::getDeltaEncoding( void )
+{
+  return( deltaEncoding );
+}
+
+void BinaryWriter::writePadded( const void * buf, size_t size )
+{
+  static const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+  if( size > 0 && fwrite( buf, 1, size, fp ) != size ){
+    cerr << "ERROR: can't write binary output" << endl;
+    exit( EXIT_FAILURE );
+  }
+  if( size % 8 != 0 )
+    fwrite( zeros, 1, 8 - size % 8, fp );
+}
+
+void BinaryWriter::open( string outFile )
+{
+  fp = fopen( outFile.c_str(), "wb" );
+  if( fp == NULL ){
+    cerr << "ERROR: can't open file " << outFile << endl;
+    exit( EXIT_FAILURE );
+  }
+  string text = headerText;
+  for( size_t c=0; c<vColNames.size(); ++c ){
+    text += "column=" + vColNames[c];
+    text += vColIsInt[c] ? " i32" : " f64";
+    text += ( deltaEncoding && c < 2 ) ? " delta\n" : " plain\n";
+  }
+  uint32_t version = BINARY_VERSION;
+  uint32_t length = text.size();
+  fwrite( BINARY_MAGIC, 1, 8, fp );
+  fwrite( &version, sizeof(uint32_t), 1, fp );
+  fwrite( &length, sizeof(uint32_t), 1, fp );
+  writePadded( text.c_str(), text.size() );
+  for( size_t c=0; c<vColNames.size(); ++c ){
+    if( vColIsInt[c] )
+      vIntBuffers[c].reserve( nbRowsPerBlock );
+    else
+      vDoubleBuffers[c].reserve( nbRowsPerBlock );
+  }
+  nbRows = 0;
+}
+
+// continues a file written up to the given size, e.g. when resuming from a
+// checkpoint, dropping what was written afterwards
+void BinaryWriter::reopen( string outFile, long size )
+{
+  fp = fopen( outFile.c_str(), "r+b" );
+  if( fp == NULL || ftruncate( fileno( fp ), size ) != 0
+      || fseek( fp, size, SEEK_SET ) != 0 ){
+    cerr << "ERROR: can't reopen file " << outFile << endl;
+    exit( EXIT_FAILURE );
+  }
+  for( size_t c=0; c<vColNames.size(); ++c ){
+    if( vColIsInt[c] )
+      vIntBuffers[c].reserve( nbRowsPerBlock );
+    else
+      vDoubleBuffers[c].reserve( nbRowsPerBlock );
+  }
+  nbRows = 0;
+}
+
+// size of the file once the buffered rows are written
+long BinaryWriter::getFileSize( void )
+{
+  flush();
+  fflush( fp );
+  return( ftell( fp ) );
+}
+
+void BinaryWriter::writeRow( int simu, int gen, const vector<double> & vValues )
+{
+  vIntBuffers[0].push_back( simu );
+  vIntBuffers[1].push_back( gen );
+  for( size_t c=2; c<vColNames.size(); ++c ){
+    if( vColIsInt[c] )
+      vIntBuffers[c].push_back( (int32_t) vValues[c-2] );
+    else
+      vDoubleBuffers[c].push_back( vValues[c-2] );
+  }
+  ++ nbRows;
+  if( nbRows == nbRowsPerBlock )
+    flush();
+}
+
+void BinaryWriter::flush( void )
+{
+  if( fp == NULL || nbRows == 0 )
+    return;
+  uint32_t blockHeader[2] = { (uint32_t) nbRows, BINARY_BLOCK_DATA };
+  fwrite( blockHeader, sizeof(uint32_t), 2, fp );
+  for( size_t c=0; c<vColNames.size(); ++c ){
+    if( vColIsInt[c] ){
+      vector<int32_t> & v = vIntBuffers[c];
+      if( deltaEncoding && c < 2 )
+        for( int i=nbRows-1; i>0; --i )
+          v[i] -= v[i-1];
+      writePadded( &v[0], nbRows * sizeof(int32_t) );
+      v.clear();
+    }
+    else{
+      writePadded( &vDoubleBuffers[c][0], nbRows * sizeof(double) );
+      vDoubleBuffers[c].clear();
+    }
+  }
+  nbRows = 0;
+}
+
+void BinaryWriter::close( string trailerText )
+{
+  if( fp == NULL )
+    return;
+  flush();
+  if( trailerText != "" ){
+    uint32_t blockHeader[2] = { (uint32_t) trailerText.size(),
+                                BINARY_BLOCK_TRAILER };
+    fwrite( blockHeader, sizeof(uint32_t), 2, fp );
+    writePadded( trailerText.c_str(), trailerText.size() );
+  }
+  fclose( fp );
+  fp = NULL;
+}
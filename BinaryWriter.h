@@ -0,0 +1,77 @@
+/*
+ * \file BinaryWriter.h
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BINARYWRITER_H
+#define BINARYWRITER_H
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <stdint.h>
+using namespace std;
+
+// Layout of a binary output file (native little-endian, 8-byte aligned):
+//  - "CC83BIN1", uint32 version, uint32 length of the header text
+//  - header text: "key=value" lines (the "#key=value" lines of the TSV)
+//    followed by one "column=name type encoding" line per column,
+//    where type is i32 or f64 and encoding is plain or delta
+//  - blocks: uint32 nb of rows, uint32 kind (0=data), then each column
+//    stored contiguously (fixed width, padded to 8 bytes); in a delta
+//    column the first row is stored as is and the others as differences
+//  - an optional trailer: uint32 length, uint32 kind (1=trailer), text
+#define BINARY_MAGIC "CC83BIN1"
+#define BINARY_VERSION 1
+#define BINARY_BLOCK_DATA 0
+#define BINARY_BLOCK_TRAILER 1
+
+class BinaryWriter
+{
+  FILE * fp;
+  int nbRowsPerBlock;
+  bool deltaEncoding;
+  string headerText;
+  vector<string> vColNames;
+  vector<bool> vColIsInt;
+
+  int nbRows;
+  vector< vector<int32_t> > vIntBuffers;
+  vector< vector<double> > vDoubleBuffers;
+
+  void writePadded( const void *, size_t );
+
+ public:
+  BinaryWriter( void );
+  ~BinaryWriter( void );
+
+  void setNbRowsPerBlock( int );
+  void setDeltaEncoding( bool );
+  void setHeaderText( string );
+  void setColumns( vector<string>, vector<bool> );
+
+  int getNbRowsPerBlock( void );
+  bool getDeltaEncoding( void );
+
+  void open( string );
+  void reopen( string, long );
+  long getFileSize( void );
+  void writeRow( int, int, const vector<double> & );
+  void flush( void );
+  void close( string );
+};
+
+#endif
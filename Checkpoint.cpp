@@ -0,0 +1,198 @@
+/*
+ * \file Checkpoint.cpp
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+using namespace std;
+
+#include "Checkpoint.h"
+
+Checkpoint::Checkpoint( void )
+{
+  simuId = 0;
+  generation = 0;
+  outFileSize = 0;
+}
+
+void Checkpoint::setHeaderText( string ht )
+{
+  headerText = ht;
+  vParamKeys.clear();
+  vParamValues.clear();
+  stringstream ss( headerText );
+  string line;
+  while( getline( ss, line ) ){
+    size_t pos = line.find( '=' );
+    if( pos == string::npos )
+      continue;
+    vParamKeys.push_back( line.substr( 0, pos ) );
+    vParamValues.push_back( line.substr( pos + 1 ) );
+  }
+}
+
+void Checkpoint::setSimulationIdentifier( int si )
+{
+  simuId = si;
+}
+
+void Checkpoint::setGeneration( int g )
+{
+  generation = g;
+}
+
+void Checkpoint::setOutFileSize( long ofs )
+{
+  outFileSize = ofs;
+}
+
+string Checkpoint::getHeaderText( void )
+{
+  return( headerText );
+}
+
+string Checkpoint::getParameter( string key )
+{
+  for( size_t i=0; i<vParamKeys.size(); ++i )
+    if( vParamKeys[i] == key )
+      return( vParamValues[i] );
+  cerr << "ERROR: missing parameter '" << key << "' in the checkpoint" << endl;
+  exit( EXIT_FAILURE );
+}
+
+// the parameters added since the first checkpoints can be missing
+bool Checkpoint::hasParameter( string key )
+{
+  for( size_t i=0; i<vParamKeys.size(); ++i )
+    if( vParamKeys[i] == key )
+      return( true );
+  return( false );
+}
+
+int Checkpoint::getSimulationIdentifier( void )
+{
+  return( simuId );
+}
+
+int Checkpoint::getGeneration( void )
+{
+  return( generation );
+}
+
+long Checkpoint::getOutFileSize( void )
+{
+  return( outFileSize );
+}
+
+// The file is first written under a temporary name then renamed, so that
+// an interruption never leaves a partial checkpoint.
+void Checkpoint::save( string ckptFile, gsl_rng * r, Population & pop )
+{
+  string tmpFile = ckptFile + ".tmp";
+  FILE * fp = fopen( tmpFile.c_str(), "wb" );
+  if( fp == NULL ){
+    cerr << "ERROR: can't open file " << tmpFile << endl;
+    exit( EXIT_FAILURE );
+  }
+  uint32_t header[2] = { CHECKPOINT_VERSION, (uint32_t) headerText.size() };
+  int32_t position[2] = { simuId, generation };
+  int64_t size = outFileSize;
+  string rngName = gsl_rng_name( r );
+  uint32_t rngNameLength = rngName.size();
+  uint64_t rngSize = gsl_rng_size( r );
+  fwrite( CHECKPOINT_MAGIC, 1, 8, fp );
+  fwrite( header, sizeof(uint32_t), 2, fp );
+  fwrite( headerText.c_str(), 1, headerText.size(), fp );
+  fwrite( position, sizeof(int32_t), 2, fp );
+  fwrite( &size, sizeof(int64_t), 1, fp );
+  fwrite( &rngNameLength, sizeof(uint32_t), 1, fp );
+  fwrite( rngName.c_str(), 1, rngNameLength, fp );
+  fwrite( &rngSize, sizeof(uint64_t), 1, fp );
+  fwrite( gsl_rng_state( r ), 1, rngSize, fp );
+  pop.writeState( fp );
+  if( ferror( fp ) || fclose( fp ) != 0
+      || rename( tmpFile.c_str(), ckptFile.c_str() ) != 0 ){
+    cerr << "ERROR: can't write the checkpoint " << ckptFile << endl;
+    exit( EXIT_FAILURE );
+  }
+}
+
+// opens the file and reads everything before the state of the RNG
+FILE * Checkpoint::openFile( string ckptFile )
+{
+  FILE * fp = fopen( ckptFile.c_str(), "rb" );
+  if( fp == NULL ){
+    cerr << "ERROR: can't open file " << ckptFile << endl;
+    exit( EXIT_FAILURE );
+  }
+  char magic[8];
+  uint32_t header[2];
+  if( fread( magic, 1, 8, fp ) != 8 || memcmp( magic, CHECKPOINT_MAGIC, 8 ) != 0
+      || fread( header, sizeof(uint32_t), 2, fp ) != 2
+      || header[0] != CHECKPOINT_VERSION ){
+    cerr << "ERROR: " << ckptFile << " is not a checkpoint of this version" << endl;
+    exit( EXIT_FAILURE );
+  }
+  string text( header[1], ' ' );
+  int32_t position[2];
+  int64_t size;
+  if( ( header[1] > 0 && fread( &text[0], 1, header[1], fp ) != header[1] )
+      || fread( position, sizeof(int32_t), 2, fp ) != 2
+      || fread( &size, sizeof(int64_t), 1, fp ) != 1 ){
+    cerr << "ERROR: can't read the checkpoint " << ckptFile << endl;
+    exit( EXIT_FAILURE );
+  }
+  setHeaderText( text );
+  setSimulationIdentifier( position[0] );
+  setGeneration( position[1] );
+  setOutFileSize( size );
+  return( fp );
+}
+
+void Checkpoint::loadHeader( string ckptFile )
+{
+  fclose( openFile( ckptFile ) );
+}
+
+// restores the RNG, which must be of the same type, and the population,
+// which must have the same parameters
+void Checkpoint::load( string ckptFile, gsl_rng * r, Population & pop )
+{
+  FILE * fp = openFile( ckptFile );
+  uint32_t rngNameLength;
+  uint64_t rngSize;
+  string rngName;
+  if( fread( &rngNameLength, sizeof(uint32_t), 1, fp ) == 1 ){
+    rngName.assign( rngNameLength, ' ' );
+    if( rngNameLength > 0
+        && fread( &rngName[0], 1, rngNameLength, fp ) != rngNameLength )
+      rngName = "";
+  }
+  if( rngName != gsl_rng_name( r )
+      || fread( &rngSize, sizeof(uint64_t), 1, fp ) != 1
+      || rngSize != gsl_rng_size( r )
+      || fread( gsl_rng_state( r ), 1, rngSize, fp ) != rngSize ){
+    cerr << "ERROR: the checkpoint requires the RNG " << rngName << endl;
+    exit( EXIT_FAILURE );
+  }
+  pop.readState( fp );
+  fclose( fp );
+}
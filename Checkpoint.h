@@ -0,0 +1,71 @@
+/*
+ * \file Checkpoint.h
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <vector>
+#include <string>
+#include "gsl/gsl_rng.h"
+using namespace std;
+
+#include "Population.h"
+
+// Layout of a checkpoint file (native little-endian):
+//  - "CC83CKP1", uint32 version, uint32 length of the header text
+//  - header text: the "key=value" parameters of the run
+//  - int32 simulation, int32 last generation done, int64 size of the output
+//    file at that point
+//  - uint32 length of the name of the RNG, this name, uint64 size of the
+//    state of the RNG, this state
+//  - the population, see Population::writeState()
+#define CHECKPOINT_MAGIC "CC83CKP1"
+#define CHECKPOINT_VERSION 1
+
+class Checkpoint
+{
+  string headerText;
+  vector<string> vParamKeys;
+  vector<string> vParamValues;
+  int simuId;
+  int generation;
+  long outFileSize;
+
+  FILE * openFile( string );
+
+ public:
+  Checkpoint( void );
+
+  void setHeaderText( string );
+  void setSimulationIdentifier( int );
+  void setGeneration( int );
+  void setOutFileSize( long );
+
+  string getHeaderText( void );
+  string getParameter( string );
+  bool hasParameter( string );
+  int getSimulationIdentifier( void );
+  int getGeneration( void );
+  long getOutFileSize( void );
+
+  void save( string, gsl_rng *, Population & );
+  void loadHeader( string );
+  void load( string, gsl_rng *, Population & );
+};
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * \file ChromosomeStore.cpp
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>  // for sort
+#include <functional>  // for greater
+using namespace std;
+
+#include "ChromosomeStore.h"
+#include "MemoryStats.h"
+
+ChromosomeStore::ChromosomeStore( void )
+{
+  nbWordsPerBlock = 0;
+  chunkShift = 0;
+}
+
+ChromosomeStore::~ChromosomeStore( void )
+{
+  for( size_t i=0; i<vChunks.size(); ++i )
+    free( vChunks[i] );
+}
+
+// the block size can only change while no block is in use
+void ChromosomeStore::setNbWordsPerBlock( int nwpb )
+{
+  if( nwpb == nbWordsPerBlock )
+    return;
+  if( getNbBlocksInUse() > 0 ){
+    cerr << "ERROR: can't change the size of chromosome blocks in use" << endl;
+    exit( EXIT_FAILURE );
+  }
+  for( size_t i=0; i<vChunks.size(); ++i )
+    free( vChunks[i] );
+  vChunks.clear();
+  vRefCounts.clear();
+  vFreeIds.clear();
+  nbWordsPerBlock = nwpb;
+  // chunks of about 64 KiB
+  chunkShift = 0;
+  while( nbWordsPerBlock > 0
+         && ( (size_t) nbWordsPerBlock << ( chunkShift + 1 ) ) <= 8192 )
+    ++ chunkShift;
+}
+
+int ChromosomeStore::getNbBlocksInUse( void ) const
+{
+  return( vRefCounts.size() - vFreeIds.size() );
+}
+
+size_t ChromosomeStore::getNbBytes( void ) const
+{
+  return( vChunks.size() * ( (size_t) nbWordsPerBlock << chunkShift )
+          * sizeof(uint64_t) );
+}
+
+// returns a block referenced once, whose content is undefined
+int ChromosomeStore::newBlock( void )
+{
+  if( vFreeIds.empty() ){
+    uint64_t * chunk = NULL;
+    size_t size = ( (size_t) nbWordsPerBlock << chunkShift ) * sizeof(uint64_t);
+    if( posix_memalign( (void **) &chunk, 64, size > 0 ? size : 64 ) != 0 ){
+      cerr << "ERROR: can't allocate chromosome blocks" << endl;
+      exit( EXIT_FAILURE );
+    }
+    MemoryStats::recordAllocation( size );
+    vChunks.push_back( chunk );
+    int firstId = vRefCounts.size();
+    int nbNewIds = 1 << chunkShift;
+    vRefCounts.resize( firstId + nbNewIds, 0 );
+    for( int id=firstId+nbNewIds-1; id>=firstId; --id )
+      vFreeIds.push_back( id );
+  }
+  int id = vFreeIds.back();
+  vFreeIds.pop_back();
+  vRefCounts[id] = 1;
+  return( id );
+}
+
+// returns a private copy of the given block, referenced once
+int ChromosomeStore::copyBlock( int srcId )
+{
+  int id = newBlock();
+  memcpy( getBlock( id ), getBlock( srcId ),
+          (size_t) nbWordsPerBlock * sizeof(uint64_t) );
+  return( id );
+}
+
+// the next new blocks will be the free ones of lowest addresses, in
+// increasing order, so that chromosomes allocated in a row stay contiguous
+void ChromosomeStore::sortFreeBlocks( void )
+{
+  sort( vFreeIds.begin(), vFreeIds.end(), greater<int>() );
+}
@@ -0,0 +1,70 @@
+/*
+ * \file ChromosomeStore.h
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CHROMOSOMESTORE_H
+#define CHROMOSOMESTORE_H
+
+#include <vector>
+#include <stdint.h>
+using namespace std;
+
+// Pool of reference-counted chromosome blocks, i.e. the words of one
+// chromosome, so that identical chromosomes can be shared between
+// individuals and generations. Blocks are allocated by 64-byte aligned
+// chunks which never move, hence a block address stays valid as long as
+// the block is referenced; freed blocks are recycled.
+class ChromosomeStore
+{
+  int nbWordsPerBlock;
+  int chunkShift;  // a chunk holds 2^chunkShift blocks
+  vector<uint64_t *> vChunks;
+  vector<int> vRefCounts;
+  vector<int> vFreeIds;
+
+  ChromosomeStore( const ChromosomeStore & );
+  ChromosomeStore& operator=( const ChromosomeStore & );
+
+ public:
+  ChromosomeStore( void );
+  ~ChromosomeStore( void );
+
+  void setNbWordsPerBlock( int );
+  int getNbWordsPerBlock( void ) const { return( nbWordsPerBlock ); }
+  int getNbBlocks( void ) const { return( vRefCounts.size() ); }
+  int getNbBlocksInUse( void ) const;
+  size_t getNbBytes( void ) const;
+
+  uint64_t * getBlock( int id ) const
+  {
+    return( vChunks[ id >> chunkShift ]
+            + (size_t) ( id & ( ( 1 << chunkShift ) - 1 ) ) * nbWordsPerBlock );
+  }
+  int getRefCount( int id ) const { return( vRefCounts[id] ); }
+
+  int newBlock( void );
+  int copyBlock( int );
+  void sortFreeBlocks( void );
+  void retain( int id ) { ++ vRefCounts[id]; }
+  void release( int id )
+  {
+    if( -- vRefCounts[id] == 0 )
+      vFreeIds.push_back( id );
+  }
+};
+
+#endif
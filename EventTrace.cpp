@@ -0,0 +1,128 @@
+/*
+ * \file EventTrace.cpp
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <cstdlib>
+#include <ctime>
+#include <sched.h>
+using namespace std;
+
+#include "EventTrace.h"
+
+EventTrace::EventTrace( void )
+{
+  fp = NULL;
+  vRing = NULL;
+  ringMask = 0;
+  head = 0;
+  tail = 0;
+  stop = false;
+  nbEvents = 0;
+  nbStalls = 0;
+}
+
+EventTrace::~EventTrace( void )
+{
+  close();
+}
+
+// the ring holds 2^log2NbSlots events
+void EventTrace::open( string traceFile, int log2NbSlots )
+{
+  fp = fopen( traceFile.c_str(), "wb" );
+  if( fp == NULL ){
+    cerr << "ERROR: can't open file " << traceFile << endl;
+    exit( EXIT_FAILURE );
+  }
+  uint32_t version = TRACE_VERSION;
+  uint32_t recordSize = sizeof(TraceEvent);
+  fwrite( TRACE_MAGIC, 1, 8, fp );
+  fwrite( &version, sizeof(uint32_t), 1, fp );
+  fwrite( &recordSize, sizeof(uint32_t), 1, fp );
+  vRing = new TraceEvent[ (size_t) 1 << log2NbSlots ];
+  ringMask = ( (size_t) 1 << log2NbSlots ) - 1;
+  head = 0;
+  tail = 0;
+  stop = false;
+  nbEvents = 0;
+  nbStalls = 0;
+  if( pthread_create( &drainer, NULL, drainLoop, this ) != 0 ){
+    cerr << "ERROR: can't start the thread writing the trace" << endl;
+    exit( EXIT_FAILURE );
+  }
+}
+
+// waits for all the recorded events to be written
+void EventTrace::close( void )
+{
+  if( fp == NULL )
+    return;
+  __atomic_store_n( &stop, true, __ATOMIC_RELEASE );
+  pthread_join( drainer, NULL );
+  fclose( fp );
+  fp = NULL;
+  delete [] vRing;
+  vRing = NULL;
+}
+
+string EventTrace::getEventName( int type )
+{
+  static const char * names[NB_EVENTS] = { "generation", "crossover", "loss",
+                                           "insertion", "rejection" };
+  if( type < 0 || type >= NB_EVENTS )
+    return( "unknown" );
+  return( names[type] );
+}
+
+void EventTrace::waitForDrainer( void )
+{
+  ++ nbStalls;
+  sched_yield();
+}
+
+void * EventTrace::drainLoop( void * trace )
+{
+  ( (EventTrace *) trace )->drain();
+  return( NULL );
+}
+
+// writes the events by contiguous runs of the ring, sleeping while it is
+// empty, until close() is called and the ring is empty
+void EventTrace::drain( void )
+{
+  struct timespec pause = { 0, 200000 };
+  while( true ){
+    bool stopping = __atomic_load_n( &stop, __ATOMIC_ACQUIRE );
+    size_t h = __atomic_load_n( &head, __ATOMIC_ACQUIRE );
+    if( h == tail ){
+      if( stopping )
+        break;
+      nanosleep( &pause, NULL );
+      continue;
+    }
+    size_t first = tail & ringMask;
+    size_t nb = h - tail;
+    if( first + nb > ringMask + 1 )
+      nb = ringMask + 1 - first;
+    if( fwrite( &vRing[first], sizeof(TraceEvent), nb, fp ) != nb ){
+      cerr << "ERROR: can't write the trace" << endl;
+      exit( EXIT_FAILURE );
+    }
+    __atomic_store_n( &tail, tail + nb, __ATOMIC_RELEASE );
+  }
+}
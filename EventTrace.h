@@ -0,0 +1,106 @@
+/*
+ * \file EventTrace.h
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EVENTTRACE_H
+#define EVENTTRACE_H
+
+#include <string>
+#include <cstdio>
+#include <stdint.h>
+#include <pthread.h>
+using namespace std;
+
+// Layout of a trace file (native little-endian):
+//  - "CC83TRC1", uint32 version, uint32 size of a record
+//  - records of 16 bytes until the end of the file, i.e. TraceEvent
+// The records of a generation follow its EVENT_GENERATION record.
+#define TRACE_MAGIC "CC83TRC1"
+#define TRACE_VERSION 1
+
+enum {
+  EVENT_GENERATION,  // ind=simulation, pos=generation, value=nb of TEs
+                     // in the population before this generation
+  EVENT_CROSSOVER,  // ind=child, chr=its chromosome, pos=locus, value=parent
+  EVENT_LOSS,  // ind, chr, pos=site, value=nb of TEs of ind afterwards
+  EVENT_INSERTION,  // ind, chr, pos=site, value=nb of TEs of ind afterwards
+  EVENT_REJECTION,  // ind=child, value=its nb of TEs; the events of this
+                    // zygote since the previous one are void
+  NB_EVENTS
+};
+
+struct TraceEvent
+{
+  uint16_t type;
+  uint16_t chr;
+  int32_t ind;
+  int32_t pos;
+  int32_t value;
+};
+
+// Records typed events in a lock-free ring buffer, drained to a file by a
+// background thread, so that tracing costs a few stores per event to the
+// simulation. The ring has a single producer: use one trace per thread
+// running a simulation. The producer waits when the ring is full, hence no
+// event is ever lost.
+class EventTrace
+{
+  FILE * fp;
+  TraceEvent * vRing;
+  size_t ringMask;
+  size_t head;  // next slot to write, only modified by the producer
+  size_t tail;  // next slot to drain, only modified by the drainer
+  bool stop;
+  long nbEvents;
+  long nbStalls;
+  pthread_t drainer;
+
+  EventTrace( const EventTrace & );
+  EventTrace& operator=( const EventTrace & );
+
+  static void * drainLoop( void * );
+  void drain( void );
+  void waitForDrainer( void );
+
+ public:
+  EventTrace( void );
+  ~EventTrace( void );
+
+  void open( string, int );
+  void close( void );
+  bool isOpen( void ) const { return( fp != NULL ); }
+  long getNbEvents( void ) const { return( nbEvents ); }
+  long getNbStalls( void ) const { return( nbStalls ); }
+  static string getEventName( int );
+
+  void record( int type, int ind, int chr, int pos, int value )
+  {
+    size_t h = head;
+    while( h - __atomic_load_n( &tail, __ATOMIC_ACQUIRE ) > ringMask )
+      waitForDrainer();
+    TraceEvent & event = vRing[ h & ringMask ];
+    event.type = type;
+    event.chr = chr;
+    event.ind = ind;
+    event.pos = pos;
+    event.value = value;
+    __atomic_store_n( &head, h + 1, __ATOMIC_RELEASE );
+    ++ nbEvents;
+  }
+};
+
+#endif
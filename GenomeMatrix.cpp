@@ -0,0 +1,393 @@
+/*
+ * \file GenomeMatrix.cpp
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>  // for swap
+using namespace std;
+
+#include "GenomeMatrix.h"
+
+GenomeMatrix::GenomeMatrix( void )
+{
+  nbInd = 0;
+  nbChrPerInd = 0;
+  nbSitesPerChr = 0;
+  nbWordsPerChr = 0;
+  nbFamilies = 1;
+  lastWordMask = 0;
+  store = new ChromosomeStore;
+  ownStore = true;
+}
+
+GenomeMatrix::GenomeMatrix( const GenomeMatrix & gm )
+{
+  nbInd = 0;
+  nbChrPerInd = 0;
+  nbSitesPerChr = 0;
+  nbWordsPerChr = 0;
+  nbFamilies = 1;
+  lastWordMask = 0;
+  store = new ChromosomeStore;
+  ownStore = true;
+  *this = gm;
+}
+
+GenomeMatrix::~GenomeMatrix( void )
+{
+  releaseBlocks();
+  if( ownStore )
+    delete store;
+}
+
+// blocks are shared if both matrices use the same store, copied otherwise
+GenomeMatrix& GenomeMatrix::operator=( const GenomeMatrix & gm )
+{
+  if( this == &gm )
+    return( *this );
+  releaseBlocks();
+  nbInd = gm.nbInd;
+  nbChrPerInd = gm.nbChrPerInd;
+  nbSitesPerChr = gm.nbSitesPerChr;
+  nbWordsPerChr = gm.nbWordsPerChr;
+  nbFamilies = gm.nbFamilies;
+  lastWordMask = gm.lastWordMask;
+  if( ! gm.vBlockIds.empty() )
+    store->setNbWordsPerBlock( nbFamilies * nbWordsPerChr );
+  if( store == gm.store ){
+    vBlockIds = gm.vBlockIds;
+    for( size_t i=0; i<vBlockIds.size(); ++i )
+      store->retain( vBlockIds[i] );
+  }
+  else{
+    // copy of each block of "gm", indexed by its id
+    vector<int> vCopies( gm.store->getNbBlocks(), -1 );
+    vBlockIds.resize( gm.vBlockIds.size() );
+    for( size_t i=0; i<gm.vBlockIds.size(); ++i ){
+      int & id = vCopies[ gm.vBlockIds[i] ];
+      if( id != -1 )
+        store->retain( id );
+      else{
+        id = store->newBlock();
+        memcpy( store->getBlock( id ), gm.store->getBlock( gm.vBlockIds[i] ),
+                (size_t) nbFamilies * nbWordsPerChr * sizeof(uint64_t) );
+      }
+      vBlockIds[i] = id;
+    }
+  }
+  vNbTEsPerInd = gm.vNbTEsPerInd;
+  vNbTEsPerChr = gm.vNbTEsPerChr;
+  vNbFamTEsPerInd = gm.vNbFamTEsPerInd;
+  vNbFamTEsPerChr = gm.vNbFamTEsPerChr;
+  return( *this );
+}
+
+void GenomeMatrix::swap( GenomeMatrix & gm )
+{
+  std::swap( nbInd, gm.nbInd );
+  std::swap( nbChrPerInd, gm.nbChrPerInd );
+  std::swap( nbSitesPerChr, gm.nbSitesPerChr );
+  std::swap( nbWordsPerChr, gm.nbWordsPerChr );
+  std::swap( nbFamilies, gm.nbFamilies );
+  std::swap( lastWordMask, gm.lastWordMask );
+  std::swap( store, gm.store );
+  std::swap( ownStore, gm.ownStore );
+  vBlockIds.swap( gm.vBlockIds );
+  vNbTEsPerInd.swap( gm.vNbTEsPerInd );
+  vNbTEsPerChr.swap( gm.vNbTEsPerChr );
+  vNbFamTEsPerInd.swap( gm.vNbFamTEsPerInd );
+  vNbFamTEsPerChr.swap( gm.vNbFamTEsPerChr );
+}
+
+void GenomeMatrix::releaseBlocks( void )
+{
+  for( size_t i=0; i<vBlockIds.size(); ++i )
+    store->release( vBlockIds[i] );
+  vBlockIds.clear();
+}
+
+// the given store must outlive the matrix; all sites are set empty
+void GenomeMatrix::setStore( ChromosomeStore * cs )
+{
+  releaseBlocks();
+  if( ownStore )
+    delete store;
+  store = cs;
+  ownStore = false;
+  resize( nbInd, nbChrPerInd, nbSitesPerChr );
+}
+
+// all sites are set empty; resizing to 0 individuals releases all the
+// blocks of the matrix (the nb of TE families is kept)
+void GenomeMatrix::resize( int ni, int ncpi, int nspc )
+{
+  releaseBlocks();
+  nbInd = ni;
+  nbChrPerInd = ncpi;
+  nbSitesPerChr = nspc;
+  nbWordsPerChr = ( nspc + 63 ) / 64;
+  lastWordMask = ( nspc % 64 == 0 ) ? ~( (uint64_t) 0 )
+    : ( ( (uint64_t) 1 << ( nspc % 64 ) ) - 1 );
+  if( (size_t) nbInd * nbChrPerInd > 0 )
+    store->setNbWordsPerBlock( nbFamilies * nbWordsPerChr );
+  clear();
+}
+
+// all sites are set empty
+void GenomeMatrix::setNbFamilies( int nf )
+{
+  if( nf < 1 ){
+    cerr << "ERROR: requires at least 1 TE family" << endl;
+    exit( EXIT_FAILURE );
+  }
+  nbFamilies = nf;
+  resize( nbInd, nbChrPerInd, nbSitesPerChr );
+}
+
+// all the chromosomes share one empty block
+void GenomeMatrix::clear( void )
+{
+  releaseBlocks();
+  size_t nbChr = (size_t) nbInd * nbChrPerInd;
+  if( nbChr > 0 ){
+    int id = store->newBlock();
+    memset( store->getBlock( id ), 0,
+            (size_t) nbFamilies * nbWordsPerChr * sizeof(uint64_t) );
+    for( size_t i=1; i<nbChr; ++i )
+      store->retain( id );
+    vBlockIds.assign( nbChr, id );
+  }
+  vNbTEsPerInd.assign( nbInd, 0 );
+  vNbTEsPerChr.assign( nbChr, 0 );
+  if( nbFamilies > 1 ){
+    vNbFamTEsPerInd.assign( (size_t) nbInd * nbFamilies, 0 );
+    vNbFamTEsPerChr.assign( nbChr * nbFamilies, 0 );
+  }
+  else{
+    vNbFamTEsPerInd.clear();
+    vNbFamTEsPerChr.clear();
+  }
+}
+
+// without the chromosomes, which are in the store
+size_t GenomeMatrix::getNbBytes( void ) const
+{
+  return( vBlockIds.capacity() * sizeof(int)
+          + vNbTEsPerInd.capacity() * sizeof(int)
+          + vNbTEsPerChr.capacity() * sizeof(int)
+          + vNbFamTEsPerInd.capacity() * sizeof(int)
+          + vNbFamTEsPerChr.capacity() * sizeof(int) );
+}
+
+// copies the block of the chromosome first if it is shared
+uint64_t * GenomeMatrix::getMutableChromosome( int ind, int chr )
+{
+  int & id = vBlockIds[ (size_t) ind * nbChrPerInd + chr ];
+  if( store->getRefCount( id ) > 1 ){
+    int copyId = store->copyBlock( id );
+    store->release( id );
+    id = copyId;
+  }
+  return( store->getBlock( id ) );
+}
+
+// gives the chromosome a private block whose content is undefined, to be
+// entirely overwritten before calling updateNbTEs()
+uint64_t * GenomeMatrix::newChromosome( int ind, int chr )
+{
+  int & id = vBlockIds[ (size_t) ind * nbChrPerInd + chr ];
+  if( store->getRefCount( id ) > 1 ){
+    store->release( id );
+    id = store->newBlock();
+  }
+  return( store->getBlock( id ) );
+}
+
+// the chromosome becomes the given one of "src", without copy if both
+// matrices use the same store
+void GenomeMatrix::shareChromosome( int ind, int chr, const GenomeMatrix & src,
+                                    int srcInd, int srcChr )
+{
+  size_t i = (size_t) ind * nbChrPerInd + chr;
+  if( src.store != store )
+    memcpy( newChromosome( ind, chr ), src.getChromosome( srcInd, srcChr ),
+            (size_t) nbFamilies * nbWordsPerChr * sizeof(uint64_t) );
+  else{
+    int srcId = src.getChromosomeId( srcInd, srcChr );
+    store->retain( srcId );
+    store->release( vBlockIds[i] );
+    vBlockIds[i] = srcId;
+  }
+  int nbTEs = src.getNbTEs( srcInd, srcChr );
+  vNbTEsPerInd[ ind ] += nbTEs - vNbTEsPerChr[i];
+  vNbTEsPerChr[i] = nbTEs;
+  if( nbFamilies > 1 )
+    for( int fam=0; fam<nbFamilies; ++fam ){
+      int nbFamTEs = src.getNbFamilyTEs( srcInd, srcChr, fam );
+      vNbFamTEsPerInd[ (size_t) ind * nbFamilies + fam ]
+        += nbFamTEs - vNbFamTEsPerChr[ i * nbFamilies + fam ];
+      vNbFamTEsPerChr[ i * nbFamilies + fam ] = nbFamTEs;
+    }
+}
+
+void GenomeMatrix::insertTE( int ind, int chr, int site )
+{
+  insertTE( ind, chr, site, 0 );
+}
+
+// the site must be empty in all the families
+void GenomeMatrix::insertTE( int ind, int chr, int site, int fam )
+{
+  getMutableChromosome( ind, chr )[ fam * nbWordsPerChr + ( site >> 6 ) ]
+    |= (uint64_t) 1 << ( site & 63 );
+  size_t i = (size_t) ind * nbChrPerInd + chr;
+  ++ vNbTEsPerChr[i];
+  ++ vNbTEsPerInd[ ind ];
+  if( nbFamilies > 1 ){
+    ++ vNbFamTEsPerChr[ i * nbFamilies + fam ];
+    ++ vNbFamTEsPerInd[ (size_t) ind * nbFamilies + fam ];
+  }
+}
+
+void GenomeMatrix::removeTE( int ind, int chr, int site )
+{
+  removeTE( ind, chr, site, 0 );
+}
+
+void GenomeMatrix::removeTE( int ind, int chr, int site, int fam )
+{
+  getMutableChromosome( ind, chr )[ fam * nbWordsPerChr + ( site >> 6 ) ]
+    &= ~( (uint64_t) 1 << ( site & 63 ) );
+  size_t i = (size_t) ind * nbChrPerInd + chr;
+  -- vNbTEsPerChr[i];
+  -- vNbTEsPerInd[ ind ];
+  if( nbFamilies > 1 ){
+    -- vNbFamTEsPerChr[ i * nbFamilies + fam ];
+    -- vNbFamTEsPerInd[ (size_t) ind * nbFamilies + fam ];
+  }
+}
+
+// nb of TEs of a chromosome after it was written, with a single TE family
+// (see updateNbTEs otherwise)
+void GenomeMatrix::setNbTEs( int ind, int chr, int nbTEs )
+{
+  size_t i = (size_t) ind * nbChrPerInd + chr;
+  vNbTEsPerInd[ ind ] += nbTEs - vNbTEsPerChr[i];
+  vNbTEsPerChr[i] = nbTEs;
+}
+
+// recount the TEs of a chromosome after it was written
+void GenomeMatrix::updateNbTEs( int ind, int chr )
+{
+  const uint64_t * pChr = getChromosome( ind, chr );
+  setNbTEs( ind, chr, countTEs( pChr, nbFamilies * nbWordsPerChr ) );
+  size_t i = (size_t) ind * nbChrPerInd + chr;
+  if( nbFamilies > 1 )
+    for( int fam=0; fam<nbFamilies; ++fam ){
+      int n = countTEs( pChr + fam * nbWordsPerChr, nbWordsPerChr );
+      vNbFamTEsPerInd[ (size_t) ind * nbFamilies + fam ]
+        += n - vNbFamTEsPerChr[ i * nbFamilies + fam ];
+      vNbFamTEsPerChr[ i * nbFamilies + fam ] = n;
+    }
+}
+
+// recount the TEs of an individual after its chromosomes were written
+void GenomeMatrix::updateNbTEs( int ind )
+{
+  if( nbFamilies > 1 ){
+    for( int chr=0; chr<nbChrPerInd; ++chr )
+      updateNbTEs( ind, chr );
+    return;
+  }
+  int nbTEs = 0;
+  for( int chr=0; chr<nbChrPerInd; ++chr ){
+    int n = countTEs( getChromosome( ind, chr ), nbWordsPerChr );
+    vNbTEsPerChr[ (size_t) ind * nbChrPerInd + chr ] = n;
+    nbTEs += n;
+  }
+  vNbTEsPerInd[ ind ] = nbTEs;
+}
+
+void GenomeMatrix::updateNbTEs( void )
+{
+  for( int ind=0; ind<nbInd; ++ind )
+    updateNbTEs( ind );
+}
+
+int GenomeMatrix::countTEs( const uint64_t * chr, int nbWords )
+{
+  int nbTEs = 0;
+  for( int w=0; w<nbWords; ++w )
+    nbTEs += __builtin_popcountll( chr[w] );
+  return( nbTEs );
+}
+
+// site of the TE of given rank (starting at 0) on the chromosome
+int GenomeMatrix::selectTE( const uint64_t * chr, int nbWords, int rank )
+{
+  for( int w=0; w<nbWords; ++w ){
+    int n = __builtin_popcountll( chr[w] );
+    if( rank < n ){
+      uint64_t word = chr[w];
+      for( int i=0; i<rank; ++i )
+        word &= word - 1;  // clear the lowest TE
+      return( 64 * w + __builtin_ctzll( word ) );
+    }
+    rank -= n;
+  }
+  return( -1 );
+}
+
+// Writes into "dest" one of the two products of the crossing-overs between
+// "a" and "b" at the given loci ("dest" must not overlap "a" or "b"): each
+// crossing-over exchanges all the sites from its locus onwards, hence a site
+// comes from "b" (for the 1st product) iff an odd nb of crossing-overs
+// happened at or before it.
+void GenomeMatrix::recombine( uint64_t * dest, const uint64_t * a,
+                              const uint64_t * b, int nbWords,
+                              const vector<int> & vCoLoci, bool second )
+{
+  recombine( dest, a, b, nbWords, 1, vCoLoci, second );
+}
+
+// same for blocks of "nbPlanes" planes of "nbWords" words, in one pass: the
+// mask of each word is applied to all the planes
+void GenomeMatrix::recombine( uint64_t * dest, const uint64_t * a,
+                              const uint64_t * b, int nbWords, int nbPlanes,
+                              const vector<int> & vCoLoci, bool second )
+{
+  // the partial masks of the crossing-overs falling in each word; as such a
+  // mask always has its highest bit set, that bit also gives the parity of
+  // the crossing-overs in the word, which flips all the following words
+  for( int w=0; w<nbWords; ++w )
+    dest[w] = 0;
+  for( size_t i=0; i<vCoLoci.size(); ++i )
+    dest[ vCoLoci[i] >> 6 ] ^= ~( (uint64_t) 0 ) << ( vCoLoci[i] & 63 );
+  uint64_t carry = second ? ~( (uint64_t) 0 ) : 0;
+  for( int w=0; w<nbWords; ++w ){
+    uint64_t partial = dest[w];
+    uint64_t flip = partial ^ carry;
+    for( int p=1; p<nbPlanes; ++p ){
+      size_t i = (size_t) p * nbWords + w;
+      dest[i] = ( a[i] & ~flip ) | ( b[i] & flip );
+    }
+    dest[w] = ( a[w] & ~flip ) | ( b[w] & flip );
+    carry ^= (uint64_t) 0 - ( partial >> 63 );
+  }
+}
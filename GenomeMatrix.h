@@ -0,0 +1,233 @@
+/*
+ * \file GenomeMatrix.h
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GENOMEMATRIX_H
+#define GENOMEMATRIX_H
+
+#include <vector>
+#include <algorithm>  // for equal
+#include <stdint.h>
+#ifdef __BMI2__
+#include <immintrin.h>  // for _pdep_u64
+#endif
+using namespace std;
+
+#include "ChromosomeStore.h"
+
+// All the chromosomes of a population as a row-major matrix (individual x
+// chromosome) of handles on the blocks of a ChromosomeStore, site s of a
+// chromosome being bit s%64 of its word s/64. Identical chromosomes share
+// the same block, which is copied only when modified (copy-on-write); two
+// matrices using the same store can share blocks, e.g. a parent and its
+// offspring. The nb of TEs per individual and per chromosome are kept up to
+// date in parallel arrays.
+// With several TE families, the block of a chromosome holds one plane of
+// words per family, a site having a TE of at most one family; the nb of TEs
+// above are those of all families, and those of each family are kept in
+// other arrays.
+class GenomeMatrix
+{
+  int nbInd;
+  int nbChrPerInd;
+  int nbSitesPerChr;
+  int nbWordsPerChr;
+  int nbFamilies;
+  uint64_t lastWordMask;
+  ChromosomeStore * store;
+  bool ownStore;
+  vector<int> vBlockIds;
+
+  vector<int> vNbTEsPerInd;
+  vector<int> vNbTEsPerChr;
+  vector<int> vNbFamTEsPerInd;  // individual x family, if several families
+  vector<int> vNbFamTEsPerChr;  // chromosome x family, if several families
+
+  void releaseBlocks( void );
+
+ public:
+  GenomeMatrix( void );
+  GenomeMatrix( const GenomeMatrix & );
+  ~GenomeMatrix( void );
+  GenomeMatrix& operator=( const GenomeMatrix & );
+  void swap( GenomeMatrix & );
+
+  void setStore( ChromosomeStore * );
+  ChromosomeStore * getStore( void ) const { return( store ); }
+  void resize( int, int, int );
+  void setNbFamilies( int );
+  void clear( void );
+  size_t getNbBytes( void ) const;
+
+  int getNbIndividuals( void ) const { return( nbInd ); }
+  int getNbChrPerIndividual( void ) const { return( nbChrPerInd ); }
+  int getNbSitesPerChromosome( void ) const { return( nbSitesPerChr ); }
+  int getNbWordsPerChromosome( void ) const { return( nbWordsPerChr ); }
+  int getNbFamilies( void ) const { return( nbFamilies ); }
+  uint64_t getLastWordMask( void ) const { return( lastWordMask ); }
+
+  int getChromosomeId( int ind, int chr ) const
+  {
+    return( vBlockIds[ (size_t) ind * nbChrPerInd + chr ] );
+  }
+  const uint64_t * getChromosome( int ind, int chr ) const
+  {
+    return( store->getBlock( getChromosomeId( ind, chr ) ) );
+  }
+  uint64_t * getMutableChromosome( int, int );
+  uint64_t * newChromosome( int, int );
+  void shareChromosome( int, int, const GenomeMatrix &, int, int );
+  int getNbTEs( int ind ) const { return( vNbTEsPerInd[ind] ); }
+  int getNbTEs( int ind, int chr ) const
+  {
+    return( vNbTEsPerChr[ (size_t) ind * nbChrPerInd + chr ] );
+  }
+  int getNbFamilyTEs( int ind, int fam ) const
+  {
+    if( nbFamilies == 1 )
+      return( vNbTEsPerInd[ind] );
+    return( vNbFamTEsPerInd[ (size_t) ind * nbFamilies + fam ] );
+  }
+  int getNbFamilyTEs( int ind, int chr, int fam ) const
+  {
+    if( nbFamilies == 1 )
+      return( getNbTEs( ind, chr ) );
+    return( vNbFamTEsPerChr[ ( (size_t) ind * nbChrPerInd + chr ) * nbFamilies
+                             + fam ] );
+  }
+  // TE of any family
+  bool isTranspElemAtSite( int ind, int chr, int site ) const
+  {
+    const uint64_t * pWord = getChromosome( ind, chr ) + ( site >> 6 );
+    uint64_t word = pWord[0];
+    for( int fam=1; fam<nbFamilies; ++fam )
+      word |= pWord[ fam * nbWordsPerChr ];
+    return( ( word >> ( site & 63 ) ) & 1 );
+  }
+  bool isTranspElemAtSite( int ind, int chr, int site, int fam ) const
+  {
+    return( ( getChromosome( ind, chr )[ fam * nbWordsPerChr + ( site >> 6 ) ]
+              >> ( site & 63 ) ) & 1 );
+  }
+
+  void setNbTEs( int, int, int );
+  void insertTE( int, int, int );
+  void insertTE( int, int, int, int );
+  void removeTE( int, int, int );
+  void removeTE( int, int, int, int );
+  void updateNbTEs( int, int );
+  void updateNbTEs( int );
+  void updateNbTEs( void );
+
+  static int countTEs( const uint64_t *, int );
+  static int selectTE( const uint64_t *, int, int );
+  static void recombine( uint64_t *, const uint64_t *, const uint64_t *,
+                         int, const vector<int> &, bool );
+  static void recombine( uint64_t *, const uint64_t *, const uint64_t *,
+                         int, int, const vector<int> &, bool );
+};
+
+// Kernels on the words of one chromosome, whose nb is known at compile time
+// (NW > 0) or only at run time (NW = 0, "nbWords" being used). Chromosomes
+// of at most 64 sites (NW = 1) hold in a single word and are specialized.
+template<int NW>
+struct ChromosomeWords
+{
+  static int countTEs( const uint64_t * chr, int nbWords )
+  {
+    return( GenomeMatrix::countTEs( chr, NW > 0 ? NW : nbWords ) );
+  }
+  static int selectTE( const uint64_t * chr, int nbWords, int rank )
+  {
+    return( GenomeMatrix::selectTE( chr, NW > 0 ? NW : nbWords, rank ) );
+  }
+  static bool isEqual( const uint64_t * a, const uint64_t * b, int nbWords )
+  {
+    return( equal( a, a + ( NW > 0 ? NW : nbWords ), b ) );
+  }
+  static bool isEqual( const uint64_t * a, const uint64_t * b, int nbWords,
+                       int nbPlanes )
+  {
+    return( equal( a, a + ( NW > 0 ? NW : nbWords ) * nbPlanes, b ) );
+  }
+  static void recombine( uint64_t * dest, const uint64_t * a,
+                         const uint64_t * b, int nbWords,
+                         const vector<int> & vCoLoci, bool second )
+  {
+    GenomeMatrix::recombine( dest, a, b, NW > 0 ? NW : nbWords,
+                             vCoLoci, second );
+  }
+  // of all the planes of the blocks, with the same crossing-overs
+  static void recombine( uint64_t * dest, const uint64_t * a,
+                         const uint64_t * b, int nbWords, int nbPlanes,
+                         const vector<int> & vCoLoci, bool second )
+  {
+    GenomeMatrix::recombine( dest, a, b, NW > 0 ? NW : nbWords, nbPlanes,
+                             vCoLoci, second );
+  }
+};
+
+template<>
+struct ChromosomeWords<1>
+{
+  static int countTEs( const uint64_t * chr, int )
+  {
+    return( __builtin_popcountll( chr[0] ) );
+  }
+  static int selectTE( const uint64_t * chr, int, int rank )
+  {
+    if( rank >= __builtin_popcountll( chr[0] ) )
+      return( -1 );
+#ifdef __BMI2__
+    // deposit a single bit onto the TE of given rank
+    return( __builtin_ctzll( _pdep_u64( (uint64_t) 1 << rank, chr[0] ) ) );
+#else
+    uint64_t word = chr[0];
+    for( int i=0; i<rank; ++i )
+      word &= word - 1;
+    return( __builtin_ctzll( word ) );
+#endif
+  }
+  static bool isEqual( const uint64_t * a, const uint64_t * b, int )
+  {
+    return( a[0] == b[0] );
+  }
+  static bool isEqual( const uint64_t * a, const uint64_t * b, int,
+                       int nbPlanes )
+  {
+    return( equal( a, a + nbPlanes, b ) );
+  }
+  // the sites coming from "b" form a mask, hence a blend of "a" and "b"
+  static void recombine( uint64_t * dest, const uint64_t * a,
+                         const uint64_t * b, int,
+                         const vector<int> & vCoLoci, bool second )
+  {
+    recombine( dest, a, b, 1, 1, vCoLoci, second );
+  }
+  static void recombine( uint64_t * dest, const uint64_t * a,
+                         const uint64_t * b, int, int nbPlanes,
+                         const vector<int> & vCoLoci, bool second )
+  {
+    uint64_t mask = second ? ~( (uint64_t) 0 ) : 0;
+    for( size_t i=0; i<vCoLoci.size(); ++i )
+      mask ^= ~( (uint64_t) 0 ) << vCoLoci[i];
+    for( int p=0; p<nbPlanes; ++p )
+      dest[p] = ( a[p] & ~mask ) | ( b[p] & mask );
+  }
+};
+
+#endif
@@ -0,0 +1,270 @@
+/*
+ * \file LinkageDisequilibrium.cpp
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <cstdlib>
+#include <algorithm>  // for min, max
+#include <pthread.h>
+using namespace std;
+
+#include "LinkageDisequilibrium.h"
+
+// loci per tile: 2 tiles of bitsets of 2000 haplotypes fit in 32 KiB
+static const int TILE = 64;
+
+// rows of tiles, taken in turn by the threads
+struct LdBatch
+{
+  LinkageDisequilibrium * ld;
+  int nbRows;
+  int next;
+};
+
+static void * runLdWorker( void * arg )
+{
+  LdBatch * batch = (LdBatch *) arg;
+  while( true ){
+    int row = __atomic_fetch_add( &batch->next, 1, __ATOMIC_RELAXED );
+    if( row >= batch->nbRows )
+      break;
+    batch->ld->computeRow( row );
+  }
+  return( NULL );
+}
+
+LinkageDisequilibrium::LinkageDisequilibrium( void )
+{
+  setNbThreads( 1 );
+  setKeepPairs( false );
+  nbSitesPerChr = 0;
+  nbHaplotypes = 0;
+  nbWords = 0;
+  sums.sumD = 0;
+  sums.nbPairs = 0;
+}
+
+void LinkageDisequilibrium::setNbThreads( int nt )
+{
+  nbThreads = max( nt, 1 );
+}
+
+// keeps D and r2 of each pair for writePairs
+void LinkageDisequilibrium::setKeepPairs( bool kp )
+{
+  keepPairs = kp;
+}
+
+void LinkageDisequilibrium::resetSums( LdSums & s )
+{
+  s.sumD = 0;
+  s.nbPairs = 0;
+  s.vSumR2.assign( max( nbSitesPerChr, 1 ), 0 );
+  s.vNbPairs.assign( max( nbSitesPerChr, 1 ), 0 );
+}
+
+void LinkageDisequilibrium::addSums( LdSums & s, const LdSums & other )
+{
+  s.sumD += other.sumD;
+  s.nbPairs += other.nbPairs;
+  for( size_t d=0; d<s.vSumR2.size(); ++d ){
+    s.vSumR2[d] += other.vSumR2[d];
+    s.vNbPairs[d] += other.vNbPairs[d];
+  }
+}
+
+void LinkageDisequilibrium::compute( const GenomeMatrix & genomes )
+{
+  int nbInd = genomes.getNbIndividuals();
+  int nbChrPerInd = genomes.getNbChrPerIndividual();
+  int nbWordsPerChr = genomes.getNbWordsPerChromosome();
+  nbSitesPerChr = genomes.getNbSitesPerChromosome();
+  nbHaplotypes = 2 * nbInd;
+  nbWords = ( nbHaplotypes + 63 ) / 64;
+  int nbLoci = nbChrPerInd / 2 * nbSitesPerChr;
+
+  // transpose the haplotypes, visiting only the TEs
+  vBitsets.assign( (size_t) nbLoci * nbWords, 0 );
+  for( int ind=0; ind<nbInd; ++ind )
+    for( int chr=0; chr<nbChrPerInd; ++chr ){
+      int hap = 2 * ind + chr % 2;
+      uint64_t bit = (uint64_t) 1 << ( hap & 63 );
+      size_t offset = (size_t) ( chr / 2 ) * nbSitesPerChr * nbWords + ( hap >> 6 );
+      const uint64_t * pChr = genomes.getChromosome( ind, chr );
+      for( int w=0; w<nbWordsPerChr; ++w )
+        for( uint64_t word=pChr[w]; word!=0; word&=word-1 ){
+          int site = 64 * w + __builtin_ctzll( word );
+          vBitsets[ offset + (size_t) site * nbWords ] |= bit;
+        }
+    }
+
+  // keep the segregating loci
+  vLoci.clear();
+  vCounts.clear();
+  for( int locus=0; locus<nbLoci; ++locus ){
+    const uint64_t * pLocus = &vBitsets[ (size_t) locus * nbWords ];
+    int count = 0;
+    for( int w=0; w<nbWords; ++w )
+      count += __builtin_popcountll( pLocus[w] );
+    if( count == 0 || count == nbHaplotypes )
+      continue;
+    if( (int) vLoci.size() != locus )
+      copy( pLocus, pLocus + nbWords,
+            &vBitsets[ vLoci.size() * nbWords ] );
+    vLoci.push_back( locus );
+    vCounts.push_back( count );
+  }
+  vBitsets.resize( vLoci.size() * nbWords );
+
+  int nbSeg = vLoci.size();
+  if( keepPairs ){
+    vPairD.assign( (size_t) nbSeg * nbSeg, 0 );
+    vPairR2.assign( (size_t) nbSeg * nbSeg, 0 );
+  }
+  LdBatch batch;
+  batch.ld = this;
+  batch.nbRows = ( nbSeg + TILE - 1 ) / TILE;
+  batch.next = 0;
+  vRowSums.resize( batch.nbRows );
+  int nbWorkers = min( nbThreads, batch.nbRows );
+  vector<pthread_t> vThreads( max( nbWorkers - 1, 0 ) );
+  for( size_t t=0; t<vThreads.size(); ++t )
+    if( pthread_create( &vThreads[t], NULL, runLdWorker, &batch ) != 0 ){
+      cerr << "ERROR: can't start the linkage disequilibrium threads" << endl;
+      exit( EXIT_FAILURE );
+    }
+  runLdWorker( &batch );
+  for( size_t t=0; t<vThreads.size(); ++t )
+    pthread_join( vThreads[t], NULL );
+
+  resetSums( sums );
+  for( int row=0; row<batch.nbRows; ++row )
+    addSums( sums, vRowSums[ row ] );
+}
+
+// pairs of a row of tiles: those whose first locus is in the tile of the
+// row, and the second one in this tile or after
+void LinkageDisequilibrium::computeRow( int row )
+{
+  LdSums & s = vRowSums[ row ];
+  resetSums( s );
+  int nbSeg = vLoci.size();
+  double n = nbHaplotypes;
+  int aEnd = min( nbSeg, ( row + 1 ) * TILE );
+  for( int bStart=row*TILE; bStart<nbSeg; bStart+=TILE ){
+    int bEnd = min( nbSeg, bStart + TILE );
+    for( int a=row*TILE; a<aEnd; ++a ){
+      const uint64_t * pA = &vBitsets[ (size_t) a * nbWords ];
+      double pFreqA = vCounts[a] / n;
+      int chrA = vLoci[a] / nbSitesPerChr;
+      for( int b=max( a + 1, bStart ); b<bEnd; ++b ){
+        const uint64_t * pB = &vBitsets[ (size_t) b * nbWords ];
+        int nbAB = 0;
+        for( int w=0; w<nbWords; ++w )
+          nbAB += __builtin_popcountll( pA[w] & pB[w] );
+        double pFreqB = vCounts[b] / n;
+        double d = nbAB / n - pFreqA * pFreqB;
+        double r2 = d * d / ( pFreqA * ( 1 - pFreqA ) * pFreqB * ( 1 - pFreqB ) );
+        int dist = ( vLoci[b] / nbSitesPerChr == chrA ) ? vLoci[b] - vLoci[a] : 0;
+        s.sumD += d;
+        ++ s.nbPairs;
+        s.vSumR2[ dist ] += r2;
+        ++ s.vNbPairs[ dist ];
+        if( keepPairs ){
+          vPairD[ (size_t) a * nbSeg + b ] = d;
+          vPairR2[ (size_t) a * nbSeg + b ] = r2;
+        }
+      }
+    }
+  }
+}
+
+int LinkageDisequilibrium::getNbSegregatingLoci( void )
+{
+  return( vLoci.size() );
+}
+
+// the means are 0 without pairs
+double LinkageDisequilibrium::getMeanD( void )
+{
+  return( sums.nbPairs == 0 ? 0 : sums.sumD / sums.nbPairs );
+}
+
+// over the pairs on the same chromosome
+double LinkageDisequilibrium::getMeanR2Linked( void )
+{
+  double sumR2 = 0;
+  long nbPairs = 0;
+  for( size_t d=1; d<sums.vSumR2.size(); ++d ){
+    sumR2 += sums.vSumR2[d];
+    nbPairs += sums.vNbPairs[d];
+  }
+  return( nbPairs == 0 ? 0 : sumR2 / nbPairs );
+}
+
+double LinkageDisequilibrium::getMeanR2Unlinked( void )
+{
+  return( getMeanR2( 0 ) );
+}
+
+// over the pairs at this distance in sites, 0 for different chromosomes
+double LinkageDisequilibrium::getMeanR2( int dist )
+{
+  if( dist >= (int) sums.vNbPairs.size() || sums.vNbPairs[ dist ] == 0 )
+    return( 0 );
+  return( sums.vSumR2[ dist ] / sums.vNbPairs[ dist ] );
+}
+
+long LinkageDisequilibrium::getNbPairs( int dist )
+{
+  return( dist < (int) sums.vNbPairs.size() ? sums.vNbPairs[ dist ] : 0 );
+}
+
+// one row per pair of segregating loci (if kept), the distance of loci on
+// different chromosomes being infinite
+void LinkageDisequilibrium::writePairs( ostream & out, int simu, int gen )
+{
+  if( ! keepPairs )
+    return;
+  string sep = "\t";
+  int nbSeg = vLoci.size();
+  for( int a=0; a<nbSeg; ++a )
+    for( int b=a+1; b<nbSeg; ++b ){
+      out << simu << sep << gen << sep << vLoci[a] << sep << vLoci[b] << sep;
+      if( vLoci[a] / nbSitesPerChr == vLoci[b] / nbSitesPerChr )
+        out << vLoci[b] - vLoci[a];
+      else
+        out << "Inf";
+      out << sep << vPairD[ (size_t) a * nbSeg + b ]
+          << sep << vPairR2[ (size_t) a * nbSeg + b ] << endl;
+    }
+}
+
+// one row per distance: nb of pairs and mean r2
+void LinkageDisequilibrium::writeDecay( ostream & out, int simu, int gen )
+{
+  string sep = "\t";
+  for( int dist=1; dist<=nbSitesPerChr; ++dist ){
+    int d = dist % nbSitesPerChr;  // different chromosomes last
+    out << simu << sep << gen << sep;
+    if( d == 0 )
+      out << "Inf";
+    else
+      out << d;
+    out << sep << getNbPairs( d ) << sep << getMeanR2( d ) << endl;
+  }
+}
@@ -0,0 +1,84 @@
+/*
+ * \file LinkageDisequilibrium.h
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef LINKAGEDISEQUILIBRIUM_H
+#define LINKAGEDISEQUILIBRIUM_H
+
+#include <vector>
+#include <iostream>
+#include <stdint.h>
+using namespace std;
+
+#include "GenomeMatrix.h"
+
+// sums over locus pairs, by physical distance for the pairs on the same
+// chromosome (index 0 being for the pairs on different chromosomes)
+struct LdSums
+{
+  double sumD;
+  long nbPairs;
+  vector<double> vSumR2;
+  vector<long> vNbPairs;
+};
+
+// Linkage disequilibrium between the segregating loci, i.e. occupied by a
+// TE in some haplotypes but not all, a haplotype being the homologue 0 or
+// 1 of all the chromosome pairs of an individual (see TreeSequence). The
+// haplotypes are transposed into one bitset per locus, so that the nb of
+// haplotypes with TEs at both loci of a pair is the popcount of their AND.
+// The pairs are processed by tiles of loci whose bitsets stay in cache, the
+// rows of tiles being shared by the threads; the sums of each row are added
+// in order, so that the results don't depend on the nb of threads.
+class LinkageDisequilibrium
+{
+  int nbThreads;
+  bool keepPairs;
+  int nbSitesPerChr;
+  int nbHaplotypes;
+  int nbWords;  // per bitset
+  vector<uint64_t> vBitsets;
+  vector<int> vLoci;  // of the bitsets
+  vector<int> vCounts;  // nb of haplotypes with a TE
+  vector<LdSums> vRowSums;
+  LdSums sums;
+  vector<float> vPairD;  // square matrices, if kept
+  vector<float> vPairR2;
+
+  void resetSums( LdSums & );
+  void addSums( LdSums &, const LdSums & );
+
+ public:
+  LinkageDisequilibrium( void );
+
+  void setNbThreads( int );
+  void setKeepPairs( bool );
+
+  void compute( const GenomeMatrix & );
+  void computeRow( int );
+
+  int getNbSegregatingLoci( void );
+  double getMeanD( void );
+  double getMeanR2Linked( void );
+  double getMeanR2Unlinked( void );
+  double getMeanR2( int );
+  long getNbPairs( int );
+  void writePairs( ostream &, int, int );
+  void writeDecay( ostream &, int, int );
+};
+
+#endif
@@ -0,0 +1,588 @@
+/*
+ * \file LockstepPopulations.cpp
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>  // for min, fill
+#include <gsl/gsl_randist.h>
+#include <gsl/gsl_statistics.h>
+#include <gsl/gsl_sort.h>
+using namespace std;
+
+#include "LockstepPopulations.h"
+#include "Population.h"
+#include "Policies.h"
+
+LockstepPopulations::LockstepPopulations( void )
+{
+  nbReps = 0;
+  setNbDiploids( 0 );
+  setNbChrPerIndividual( 0 );
+  setNbSitesPerChromosome( 0 );
+  setExpNbTEsPerIndividual( 0 );
+  setTotalMapDist( 0 );
+  setZygoteSelection( false );
+  setSelMultiplicator( 0.0 );
+  setSelExponent( 0.0 );
+  setVerbose( 0 );
+  setStats( Population::getDefaultStats() );
+  nbWords = 0;
+}
+
+void LockstepPopulations::setNbDiploids( int nd )
+{
+  nbDiploids = nd;
+}
+
+void LockstepPopulations::setNbChrPerIndividual( int cpi )
+{
+  nbChrPerInd = cpi;
+}
+
+void LockstepPopulations::setNbSitesPerChromosome( int spc )
+{
+  nbSitesPerChr = spc;
+}
+
+void LockstepPopulations::setExpNbTEsPerIndividual( int nti )
+{
+  expNbTEsPerInd = nti;
+}
+
+void LockstepPopulations::setTotalMapDist( int tmd )
+{
+  totalMapDist = tmd;
+}
+
+void LockstepPopulations::setZygoteSelection( bool zs )
+{
+  zygoteSelection = zs;
+}
+
+void LockstepPopulations::setSelMultiplicator( float sm )
+{
+  selMult = sm;
+}
+
+void LockstepPopulations::setSelExponent( float se )
+{
+  selExp = se;
+}
+
+void LockstepPopulations::setVerbose( int v )
+{
+  verbose = v;
+}
+
+// one random stream per replicate, which sets their nb
+void LockstepPopulations::setRngs( vector<gsl_rng *> vr )
+{
+  vRngs = vr;
+  nbReps = vRngs.size();
+}
+
+void LockstepPopulations::setStats( vector<string> vs )
+{
+  vStats = vs;
+}
+
+int LockstepPopulations::getNbReplicates( void )
+{
+  return( nbReps );
+}
+
+// the statistics computed on the replicates, i.e. the default ones
+bool LockstepPopulations::isAvailableStat( string stat )
+{
+  vector<string> vDefault = Population::getDefaultStats();
+  return( find( vDefault.begin(), vDefault.end(), stat ) != vDefault.end() );
+}
+
+void LockstepPopulations::resize( void )
+{
+  nbWords = ( nbSitesPerChr + 63 ) / 64;
+  size_t nbChr = (size_t) nbDiploids * nbChrPerInd;
+  vWords.assign( nbChr * nbWords * nbReps, 0 );
+  vNewWords.assign( nbChr * nbWords * nbReps, 0 );
+  vNbTEsPerChr.assign( nbChr * nbReps, 0 );
+  vNewNbTEsPerChr.assign( nbChr * nbReps, 0 );
+  vNbTEsPerInd.assign( (size_t) nbDiploids * nbReps, 0 );
+  vNewNbTEsPerInd.assign( (size_t) nbDiploids * nbReps, 0 );
+  vIsRunning.assign( nbReps, 1 );
+  vNbGenDone.assign( nbReps, 0 );
+  vIsPending.assign( nbReps, 0 );
+  vParents.assign( 2 * nbReps, 0 );
+  vMasks.assign( (size_t) nbChrPerInd * nbWords * nbReps, 0 );
+  vChrWords.assign( nbWords, 0 );
+  vRowValues.assign( nbReps, vector<double>() );
+  vRowNbTEs.assign( nbReps, vector<int>() );
+}
+
+// same draws as Population::initialize(), from the stream of each replicate
+void LockstepPopulations::initialize( void )
+{
+  resize();
+  float probTEPerSite = expNbTEsPerInd / float( nbChrPerInd * nbSitesPerChr );
+  for( int rep=0; rep<nbReps; ++rep )
+    for( int i=0; i<nbDiploids; ++i ){
+      for( int chr=0; chr<nbChrPerInd; ++chr )
+        for( int site=0; site<nbSitesPerChr; ++site ){
+          float probTE = gsl_rng_uniform( vRngs[rep] );
+          if( probTE < probTEPerSite ){
+            vWords[ getWordIndex( i, chr, site >> 6 ) + rep ]
+              |= (uint64_t) 1 << ( site & 63 );
+            ++ vNbTEsPerChr[ getChrIndex( i, chr ) + rep ];
+            ++ vNbTEsPerInd[ (size_t) i * nbReps + rep ];
+          }
+        }
+    }
+}
+
+// all the replicates start from these genomes, e.g. after a burn-in
+void LockstepPopulations::setGenomes( const GenomeMatrix & gm )
+{
+  nbDiploids = gm.getNbIndividuals();
+  nbChrPerInd = gm.getNbChrPerIndividual();
+  nbSitesPerChr = gm.getNbSitesPerChromosome();
+  resize();
+  for( int i=0; i<nbDiploids; ++i )
+    for( int chr=0; chr<nbChrPerInd; ++chr ){
+      const uint64_t * pChr = gm.getChromosome( i, chr );
+      for( int w=0; w<nbWords; ++w )
+        for( int rep=0; rep<nbReps; ++rep )
+          vWords[ getWordIndex( i, chr, w ) + rep ] = pChr[w];
+      for( int rep=0; rep<nbReps; ++rep ){
+        vNbTEsPerChr[ getChrIndex( i, chr ) + rep ] = gm.getNbTEs( i, chr );
+        vNbTEsPerInd[ (size_t) i * nbReps + rep ] = gm.getNbTEs( i );
+      }
+    }
+}
+
+int LockstepPopulations::getNbTEs( int ind, int rep )
+{
+  return( vNbTEsPerInd[ (size_t) ind * nbReps + rep ] );
+}
+
+int LockstepPopulations::getSumNbTEs( int rep )
+{
+  int sum = 0;
+  for( int i=0; i<nbDiploids; ++i )
+    sum += vNbTEsPerInd[ (size_t) i * nbReps + rep ];
+  return( sum );
+}
+
+bool LockstepPopulations::isTranspElemAtSite( int ind, int chr, int site,
+                                              int rep )
+{
+  return( ( vWords[ getWordIndex( ind, chr, site >> 6 ) + rep ]
+            >> ( site & 63 ) ) & 1 );
+}
+
+int LockstepPopulations::getNbGenerationsDone( int rep )
+{
+  return( vNbGenDone[ rep ] );
+}
+
+// the words of a chromosome of a replicate, gathered contiguously
+const uint64_t * LockstepPopulations::getChromosome( int ind, int chr,
+                                                     int rep )
+{
+  size_t first = getWordIndex( ind, chr, 0 ) + rep;
+  for( int w=0; w<nbWords; ++w )
+    vChrWords[w] = vWords[ first + (size_t) w * nbReps ];
+  return( &vChrWords[0] );
+}
+
+// Draws the gamete of "idPar" for the given homologue of the offspring, as
+// Population::makeGamete(), and keeps for each pair of chromosomes the masks
+// of the sites coming from the second parental homologue (see
+// GenomeMatrix::recombine).
+void LockstepPopulations::makeGamete( int idPar, int homologue, int rep )
+{
+  gsl_rng * r = vRngs[ rep ];
+  int nbPairs = nbChrPerInd / 2;
+  vParents[ homologue * nbReps + rep ] = idPar;
+  for( int pair=0; pair<nbPairs; ++pair ){
+    int nbCrossOvers = gsl_ran_poisson( r, totalMapDist );
+    vCoLoci.clear();
+    for( int i=0; i<nbCrossOvers; ++i )
+      vCoLoci.push_back( gsl_rng_uniform_int( r, nbSitesPerChr ) );
+    int idChr = gsl_rng_uniform_int( r, 2 );
+    size_t first = ( (size_t) homologue * nbPairs + pair ) * nbWords * nbReps
+      + rep;
+    for( int w=0; w<nbWords; ++w )
+      vChrWords[w] = 0;
+    for( size_t i=0; i<vCoLoci.size(); ++i )
+      vChrWords[ vCoLoci[i] >> 6 ] ^= ~( (uint64_t) 0 ) << ( vCoLoci[i] & 63 );
+    uint64_t carry = idChr == 1 ? ~( (uint64_t) 0 ) : 0;
+    for( int w=0; w<nbWords; ++w ){
+      uint64_t partial = vChrWords[w];
+      vMasks[ first + (size_t) w * nbReps ] = partial ^ carry;
+      carry ^= (uint64_t) 0 - ( partial >> 63 );
+    }
+  }
+}
+
+// The offspring are made one at a time in all the replicates: each one
+// still making it draws its parents and gametes, then the offspring words
+// of all the replicates are blended from those of the parents in one pass,
+// and the viability of each one is drawn; the replicates whose offspring
+// isn't viable start over.
+template<class Selection>
+void LockstepPopulations::reproduce( void )
+{
+  int nbPairs = nbChrPerInd / 2;
+  for( int i=0; i<nbDiploids; ++i ){
+    fill( vIsPending.begin(), vIsPending.end(), 1 );
+    int nbPending = nbReps;
+    while( nbPending > 0 ){
+      for( int rep=0; rep<nbReps; ++rep ){
+        // the replicates without TEs blend their empty parental words
+        if( ! vIsPending[rep] || ! vIsRunning[rep] )
+          continue;
+        gsl_rng * r = vRngs[ rep ];
+        int idPar1 = gsl_rng_uniform_int( r, nbDiploids );
+        int idPar2 = gsl_rng_uniform_int( r, nbDiploids );
+        while( idPar2 == idPar1 )
+          idPar2 = gsl_rng_uniform_int( r, nbDiploids );
+        makeGamete( idPar1, 0, rep );
+        makeGamete( idPar2, 1, rep );
+      }
+
+      for( int hom=0; hom<2; ++hom )
+        for( int pair=0; pair<nbPairs; ++pair )
+          for( int w=0; w<nbWords; ++w ){
+            const int * pParents = &vParents[ hom * nbReps ];
+            const uint64_t * pMasks =
+              &vMasks[ ( ( (size_t) hom * nbPairs + pair ) * nbWords + w ) * nbReps ];
+            uint64_t * pChild = &vNewWords[ getWordIndex( i, 2*pair + hom, w ) ];
+            size_t offset = getWordIndex( 0, 2*pair, w );
+            size_t next = (size_t) nbWords * nbReps;  // other homologue
+            for( int rep=0; rep<nbReps; ++rep ){
+              size_t first = getWordIndex( pParents[rep], 0, 0 ) + offset + rep;
+              uint64_t word = ( vWords[ first ] & ~pMasks[rep] )
+                | ( vWords[ first + next ] & pMasks[rep] );
+              pChild[rep] = vIsPending[rep] ? word : pChild[rep];
+            }
+          }
+      int * pNbTEsPerInd = &vNewNbTEsPerInd[ (size_t) i * nbReps ];
+      fill( pNbTEsPerInd, pNbTEsPerInd + nbReps, 0 );
+      for( int chr=0; chr<nbChrPerInd; ++chr ){
+        int * pNbTEs = &vNewNbTEsPerChr[ getChrIndex( i, chr ) ];
+        for( int rep=0; rep<nbReps; ++rep )
+          pNbTEs[rep] = 0;
+        for( int w=0; w<nbWords; ++w ){
+          const uint64_t * pChild = &vNewWords[ getWordIndex( i, chr, w ) ];
+          for( int rep=0; rep<nbReps; ++rep )
+            pNbTEs[rep] += __builtin_popcountll( pChild[rep] );
+        }
+        for( int rep=0; rep<nbReps; ++rep )
+          pNbTEsPerInd[rep] += pNbTEs[rep];
+      }
+
+      for( int rep=0; rep<nbReps; ++rep ){
+        if( ! vIsPending[rep] )
+          continue;
+        bool isViable = true;
+        if( Selection::isOn && vIsRunning[rep] ){
+          float probSel = gsl_rng_uniform( vRngs[ rep ] );
+          float fitness = 1 - selMult * pow( pNbTEsPerInd[rep], selExp );
+          isViable = ( probSel <= fitness );
+        }
+        if( isViable ){
+          vIsPending[rep] = 0;
+          -- nbPending;
+        }
+      }
+    }
+  }
+  vWords.swap( vNewWords );
+  vNbTEsPerChr.swap( vNewNbTEsPerChr );
+  vNbTEsPerInd.swap( vNewNbTEsPerInd );
+}
+
+// same draws as Population::removeTEs()
+void LockstepPopulations::removeTEs( float probLoss )
+{
+  for( int i=0; i<nbDiploids; ++i )
+    for( int rep=0; rep<nbReps; ++rep ){
+      int & nbTEs = vNbTEsPerInd[ (size_t) i * nbReps + rep ];
+      if( ! vIsRunning[rep] || nbTEs == 0 )
+        continue;
+      gsl_rng * r = vRngs[ rep ];
+      float meanNbLoss = probLoss * nbTEs;
+      int nbLoss = min( (int) gsl_ran_poisson( r, meanNbLoss ), nbTEs );
+      for( int loss=0; loss<nbLoss; ++loss ){
+        int chr = gsl_rng_uniform_int( r, nbChrPerInd );
+        while( vNbTEsPerChr[ getChrIndex( i, chr ) + rep ] == 0 )
+          chr = gsl_rng_uniform_int( r, nbChrPerInd );
+        int & nbTEsChr = vNbTEsPerChr[ getChrIndex( i, chr ) + rep ];
+        int rankLostTE = gsl_rng_uniform_int( r, nbTEsChr );
+        int site = GenomeMatrix::selectTE( getChromosome( i, chr, rep ),
+                                           nbWords, rankLostTE );
+        vWords[ getWordIndex( i, chr, site >> 6 ) + rep ]
+          &= ~( (uint64_t) 1 << ( site & 63 ) );
+        -- nbTEsChr;
+        -- nbTEs;
+      }
+    }
+}
+
+// same draws as Population::insertTEs()
+template<class Regulation>
+void LockstepPopulations::insertTEs( float probTransp0, float k )
+{
+  for( int i=0; i<nbDiploids; ++i )
+    for( int rep=0; rep<nbReps; ++rep ){
+      int & nbTEs = vNbTEsPerInd[ (size_t) i * nbReps + rep ];
+      if( ! vIsRunning[rep] || nbTEs == 0 )
+        continue;
+      gsl_rng * r = vRngs[ rep ];
+      float probTransp = Regulation::getProbTransp( probTransp0, k, nbTEs );
+      float meanNbTransp = probTransp * nbTEs;
+      int nbTranspInd = gsl_ran_poisson( r, meanNbTransp );
+      if( nbTEs + nbTranspInd >= nbChrPerInd * nbSitesPerChr ){
+        cerr << "WARNING: too many TEs and no more empty sites" << endl;
+        exit( EXIT_FAILURE );
+      }
+      for( int transp=0; transp<nbTranspInd; ++transp ){
+        int chr = gsl_rng_uniform_int( r, nbChrPerInd );
+        while( vNbTEsPerChr[ getChrIndex( i, chr ) + rep ] == nbSitesPerChr )
+          chr = gsl_rng_uniform_int( r, nbChrPerInd );
+        int insSite = gsl_rng_uniform_int( r, nbSitesPerChr );
+        while( isTranspElemAtSite( i, chr, insSite, rep ) )
+          insSite = gsl_rng_uniform_int( r, nbSitesPerChr );
+        vWords[ getWordIndex( i, chr, insSite >> 6 ) + rep ]
+          |= (uint64_t) 1 << ( insSite & 63 );
+        ++ vNbTEsPerChr[ getChrIndex( i, chr ) + rep ];
+        ++ nbTEs;
+      }
+    }
+}
+
+template<class Regulation, class Selection>
+void LockstepPopulations::makeGeneration( float probLoss, float probTransp0,
+                                          float k )
+{
+  reproduce<Selection>();
+  removeTEs( probLoss );
+  insertTEs<Regulation>( probTransp0, k );
+}
+
+// one generation of all the replicates which still have TEs
+void LockstepPopulations::makeGeneration( float probLoss, float probTransp0,
+                                          float k )
+{
+  if( k == 0 && zygoteSelection )
+    makeGeneration<NoRegulation,ZygoteSelection>( probLoss, probTransp0, k );
+  else if( k == 0 )
+    makeGeneration<NoRegulation,NoSelection>( probLoss, probTransp0, k );
+  else if( zygoteSelection )
+    makeGeneration<CopyNbRegulation,ZygoteSelection>( probLoss, probTransp0, k );
+  else
+    makeGeneration<CopyNbRegulation,NoSelection>( probLoss, probTransp0, k );
+}
+
+// Adds the row of generation "g" of each running replicate. The nb of TEs
+// per individual, per locus and the occupied loci are counted for all the
+// replicates in one pass; each replicate then gets the same values as with
+// Population::getStatsValues(), through the strided gsl functions.
+void LockstepPopulations::computeStatsValues( int g )
+{
+  bool needPerInd = false, needPerLoc = false, needEmpty = false;
+  for( size_t i=0; i<vStats.size(); ++i ){
+    char last = vStats[i][ vStats[i].size()-1 ];
+    if( last == 'C' )
+      needPerInd = true;
+    else if( last == 'L' )
+      needPerLoc = true;
+    else if( vStats[i] == "empty" )
+      needEmpty = true;
+  }
+
+  int nbLociPerInd = ( nbChrPerInd / 2 ) * nbSitesPerChr;
+  if( needPerInd ){
+    vNbTEsPerIndStats.resize( vNbTEsPerInd.size() );
+    for( size_t i=0; i<vNbTEsPerInd.size(); ++i )
+      vNbTEsPerIndStats[i] = vNbTEsPerInd[i];
+  }
+  if( needPerLoc ){
+    vNbTEsPerLoc.assign( (size_t) nbLociPerInd * nbReps, 0 );
+    for( int ind=0; ind<nbDiploids; ++ind )
+      for( int chr=0; chr<nbChrPerInd; ++chr )
+        for( int w=0; w<nbWords; ++w ){
+          const uint64_t * pWords = &vWords[ getWordIndex( ind, chr, w ) ];
+          int nbBits = min( 64, nbSitesPerChr - 64 * w );
+          for( int bit=0; bit<nbBits; ++bit ){
+            int locus = ( chr / 2 ) * nbSitesPerChr + 64 * w + bit;
+            int * pNbTEs = &vNbTEsPerLoc[ (size_t) locus * nbReps ];
+            for( int rep=0; rep<nbReps; ++rep )
+              pNbTEs[rep] += ( pWords[rep] >> bit ) & 1;
+          }
+        }
+    vFreqTEsPerLoc.resize( vNbTEsPerLoc.size() );
+    for( size_t i=0; i<vNbTEsPerLoc.size(); ++i )
+      vFreqTEsPerLoc[i] = (float) vNbTEsPerLoc[i]
+        / ( (nbChrPerInd/2) * nbDiploids );
+  }
+  if( needEmpty ){
+    vNbOccLoci.assign( nbReps, 0 );
+    for( int ind=0; ind<nbDiploids; ++ind )
+      for( int chr=0; chr<nbChrPerInd; chr+=2 )
+        for( int w=0; w<nbWords; ++w ){
+          const uint64_t * pChr1 = &vWords[ getWordIndex( ind, chr, w ) ];
+          const uint64_t * pChr2 = &vWords[ getWordIndex( ind, chr+1, w ) ];
+          for( int rep=0; rep<nbReps; ++rep )
+            vNbOccLoci[rep] += __builtin_popcountll( pChr1[rep] | pChr2[rep] );
+        }
+  }
+
+  for( int rep=0; rep<nbReps; ++rep ){
+    if( ! vIsRunning[rep] )
+      continue;
+    double * pNbTEs = needPerInd ? &vNbTEsPerIndStats[rep] : NULL;
+    double * pFreqs = needPerLoc ? &vFreqTEsPerLoc[rep] : NULL;
+    vector<double> & vValues = vRowValues[rep];
+    for( size_t i=0; i<vStats.size(); ++i ){
+      const string & stat = vStats[i];
+      if( stat == "nC" )
+        vValues.push_back( getSumNbTEs( rep ) );
+      else if( stat == "meanC" )
+        vValues.push_back( (float) gsl_stats_mean( pNbTEs, nbReps, nbDiploids ) );
+      else if( stat == "varC" )
+        vValues.push_back( (float) gsl_stats_variance( pNbTEs, nbReps,
+                                                       nbDiploids ) );
+      else if( stat == "sdC" ){
+        if( (float) gsl_stats_mean( pNbTEs, nbReps, nbDiploids ) == 0 )
+          vValues.push_back( 0 );
+        else
+          vValues.push_back( (float) gsl_stats_sd( pNbTEs, nbReps,
+                                                   nbDiploids ) );
+      }
+      else if( stat == "minC" )
+        vValues.push_back( (int) gsl_stats_min( pNbTEs, nbReps, nbDiploids ) );
+      else if( stat == "q25C" || stat == "medC" || stat == "q75C" ){
+        double q = stat == "q25C" ? 0.25 : ( stat == "medC" ? 0.50 : 0.75 );
+        gsl_sort( pNbTEs, nbReps, nbDiploids );
+        vValues.push_back( (float) gsl_stats_quantile_from_sorted_data(
+                             pNbTEs, nbReps, nbDiploids, q ) );
+      }
+      else if( stat == "maxC" )
+        vValues.push_back( (int) gsl_stats_max( pNbTEs, nbReps, nbDiploids ) );
+      else if( stat == "empty" ){
+        int nbEmptyLoci = nbLociPerInd * nbDiploids - vNbOccLoci[rep];
+        vValues.push_back( (float) nbEmptyLoci / ( nbLociPerInd * nbDiploids ) );
+      }
+      else if( stat == "meanL" )
+        vValues.push_back( (float) gsl_stats_mean( pFreqs, nbReps,
+                                                   nbLociPerInd ) );
+      else if( stat == "varL" )
+        vValues.push_back( (float) gsl_stats_variance( pFreqs, nbReps,
+                                                       nbLociPerInd ) );
+      else if( stat == "sdL" )
+        vValues.push_back( (float) gsl_stats_sd( pFreqs, nbReps,
+                                                 nbLociPerInd ) );
+    }
+    vRowNbTEs[rep].push_back( getSumNbTEs( rep ) );
+  }
+}
+
+// As Simulation::run(), the replicates being initialized beforehand: a
+// replicate stops after the generation where it lost its TEs.
+void LockstepPopulations::run( int nbGen, float probLoss, float probTransp0,
+                               float k )
+{
+  computeStatsValues( 0 );
+  for( int g=1; g<=nbGen; ++g ){
+    int nbRunning = 0;
+    for( int rep=0; rep<nbReps; ++rep ){
+      if( vIsRunning[rep] && getSumNbTEs( rep ) == 0 )
+        vIsRunning[rep] = 0;
+      nbRunning += vIsRunning[rep];
+    }
+    if( nbRunning == 0 )
+      break;
+    if( verbose > 0 )
+      cout << "lockstep: generation " << g << "/" << nbGen << ", "
+           << nbRunning << " replicates" << endl;
+    makeGeneration( probLoss, probTransp0, k );
+    computeStatsValues( g );
+    for( int rep=0; rep<nbReps; ++rep )
+      if( vIsRunning[rep] )
+        vNbGenDone[rep] = g;
+  }
+}
+
+// the statistics of a replicate at generation "gen" (at most the nb of
+// generations done)
+const vector<double> & LockstepPopulations::getRowValues( int rep, int gen )
+{
+  vRowCopy.assign( vRowValues[rep].begin() + gen * vStats.size(),
+                   vRowValues[rep].begin() + ( gen + 1 ) * vStats.size() );
+  return( vRowCopy );
+}
+
+// Writes the rows of a replicate as simulation "simuId", and adds them to
+// the aggregate if any, as Simulation::saveData() does.
+void LockstepPopulations::writeRows( int rep, int simuId, string outFile,
+                                     BinaryWriter * binOut,
+                                     Aggregator * aggregator, bool rawOutput )
+{
+  ofstream outStream;
+  if( binOut == NULL && rawOutput )
+    outStream.open( outFile.c_str(),
+                    fstream::in | fstream::out | fstream::app );
+  if( aggregator != NULL )
+    aggregator->addReplicate();
+  for( int g=0; g<=vNbGenDone[rep]; ++g ){
+    const vector<double> & vValues = getRowValues( rep, g );
+    if( aggregator != NULL ){
+      aggregator->add( g, vValues );
+      if( vRowNbTEs[rep][g] == 0 )
+        aggregator->addExtinction( g );
+    }
+    if( ! rawOutput )
+      continue;
+    if( binOut != NULL )
+      binOut->writeRow( simuId, g, vValues );
+    else
+      Population::writeRow( outStream, vStats, simuId, g, vValues );
+  }
+  if( outStream.is_open() )
+    outStream.close();
+}
+
+// nb of bytes per replicate of the counts (MEM_GENOMES) and of the
+// chromosome words (MEM_CHROMOSOMES), see Population::getNbBytes
+size_t LockstepPopulations::getNbBytes( int part )
+{
+  if( nbReps == 0 )
+    return( 0 );
+  switch( part ){
+  case MEM_GENOMES:
+    return( ( vNbTEsPerChr.capacity() + vNewNbTEsPerChr.capacity()
+              + vNbTEsPerInd.capacity() + vNewNbTEsPerInd.capacity() )
+            * sizeof(int) / nbReps );
+  case MEM_CHROMOSOMES:
+    return( ( vWords.capacity() + vNewWords.capacity() + vMasks.capacity() )
+            * sizeof(uint64_t) / nbReps );
+  }
+  return( 0 );
+}
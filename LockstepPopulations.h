@@ -0,0 +1,129 @@
+/*
+ * \file LockstepPopulations.h
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef LOCKSTEPPOPULATIONS_H
+#define LOCKSTEPPOPULATIONS_H
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "gsl/gsl_rng.h"
+using namespace std;
+
+#include "GenomeMatrix.h"
+#include "BinaryWriter.h"
+#include "Aggregator.h"
+
+// Replicates of a population, with the same parameters, advanced generation
+// by generation together, as the lanes of one pass. Their chromosome words,
+// nb of TEs and statistics are stored replicate-minor (the values of all the
+// replicates for a given individual, chromosome and word are contiguous), so
+// that the loops over the replicates are the innermost ones. Each replicate
+// has its own random stream, from which it makes the same draws, in the same
+// order, as a Population: its generations and statistics are those of
+// Simulation::run() with that stream. A replicate stops once it has lost its
+// TEs; its rows are kept until written by writeRows().
+class LockstepPopulations
+{
+  int nbReps;
+  int nbDiploids;
+  int nbChrPerInd;
+  int nbSitesPerChr;
+  int expNbTEsPerInd;
+  int totalMapDist;
+  bool zygoteSelection;
+  float selMult;
+  float selExp;
+  int verbose;
+  vector<gsl_rng *> vRngs;
+  vector<string> vStats;
+
+  int nbWords;
+  vector<uint64_t> vWords;  // [ ( ( ind * nbChr + chr ) * nbWords + w ) * nbReps + rep ]
+  vector<uint64_t> vNewWords;
+  vector<int> vNbTEsPerChr;  // [ ( ind * nbChr + chr ) * nbReps + rep ]
+  vector<int> vNewNbTEsPerChr;
+  vector<int> vNbTEsPerInd;  // [ ind * nbReps + rep ]
+  vector<int> vNewNbTEsPerInd;
+  vector<char> vIsRunning;
+  vector<int> vNbGenDone;
+
+  vector<char> vIsPending;  // replicates still making the current offspring
+  vector<int> vParents;  // [ homologue * nbReps + rep ]
+  vector<uint64_t> vMasks;  // [ ( ( homologue * nbPairs + pair ) * nbWords + w ) * nbReps + rep ]
+  vector<int> vCoLoci;
+  vector<uint64_t> vChrWords;
+
+  vector<double> vNbTEsPerIndStats;  // [ ind * nbReps + rep ]
+  vector<double> vFreqTEsPerLoc;  // [ locus * nbReps + rep ]
+  vector<int> vNbTEsPerLoc;
+  vector<int> vNbOccLoci;
+  vector< vector<double> > vRowValues;  // of each replicate, row after row
+  vector< vector<int> > vRowNbTEs;
+  vector<double> vRowCopy;
+
+  size_t getWordIndex( int ind, int chr, int w ) const
+  {
+    return( ( ( (size_t) ind * nbChrPerInd + chr ) * nbWords + w ) * nbReps );
+  }
+  size_t getChrIndex( int ind, int chr ) const
+  {
+    return( ( (size_t) ind * nbChrPerInd + chr ) * nbReps );
+  }
+  const uint64_t * getChromosome( int, int, int );
+  void resize( void );
+  void makeGamete( int, int, int );
+  template<class Selection> void reproduce( void );
+  void removeTEs( float );
+  template<class Regulation> void insertTEs( float, float );
+  template<class Regulation, class Selection>
+  void makeGeneration( float, float, float );
+  void computeStatsValues( int );
+
+ public:
+  LockstepPopulations( void );
+
+  void setNbDiploids( int );
+  void setNbChrPerIndividual( int );
+  void setNbSitesPerChromosome( int );
+  void setExpNbTEsPerIndividual( int );
+  void setTotalMapDist( int );
+  void setZygoteSelection( bool );
+  void setSelMultiplicator( float );
+  void setSelExponent( float );
+  void setVerbose( int );
+  void setRngs( vector<gsl_rng *> );
+  void setStats( vector<string> );
+
+  int getNbReplicates( void );
+  static bool isAvailableStat( string );
+
+  void initialize( void );
+  void setGenomes( const GenomeMatrix & );
+  int getNbTEs( int, int );
+  int getSumNbTEs( int );
+  bool isTranspElemAtSite( int, int, int, int );
+  int getNbGenerationsDone( int );
+  void makeGeneration( float, float, float );
+  void run( int, float, float, float );
+  const vector<double> & getRowValues( int, int );
+  void writeRows( int, int, string, BinaryWriter *, Aggregator *, bool );
+  size_t getNbBytes( int );
+};
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * \file MemoryNew.cpp
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdlib>
+#include <new>
+using namespace std;
+
+#include "MemoryStats.h"
+
+// Replacement of the global operator new of the standard library, whose
+// allocations are otherwise out of reach: each one is reported to
+// MemoryStats::recordAllocation. It is linked into the programs which count
+// the allocations (modelCC83, test) rather than put in libTEs, so that the
+// other programs linked with the library keep their own allocator.
+
+void * operator new( size_t size )
+{
+  void * p = malloc( size > 0 ? size : 1 );
+  if( p == NULL )
+    throw bad_alloc();
+  MemoryStats::recordAllocation( size );
+  return( p );
+}
+
+void * operator new[]( size_t size )
+{
+  return( operator new( size ) );
+}
+
+void operator delete( void * p ) throw()
+{
+  free( p );
+}
+
+void operator delete[]( void * p ) throw()
+{
+  free( p );
+}
@@ -0,0 +1,124 @@
+/*
+ * \file MemoryStats.cpp
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>  // for max
+#include <unistd.h>  // for sysconf
+#include <sys/resource.h>  // for getrusage
+using namespace std;
+
+#include "MemoryStats.h"
+
+static MemoryStats::AllocHook allocHook = NULL;
+static __thread int phase = PHASE_OTHER;
+static AllocCounts vAllocCounts[ NB_PHASES ];
+
+static void countAllocation( size_t size )
+{
+  AllocCounts & counts = vAllocCounts[ phase ];
+  __atomic_fetch_add( &counts.nbAllocs, 1, __ATOMIC_RELAXED );
+  __atomic_fetch_add( &counts.nbBytes, (long) size, __ATOMIC_RELAXED );
+}
+
+void MemoryStats::setAllocHook( AllocHook hook )
+{
+  allocHook = hook;
+}
+
+void MemoryStats::recordAllocation( size_t size )
+{
+  if( allocHook != NULL )
+    allocHook( size );
+}
+
+void MemoryStats::startCounting( void )
+{
+  setAllocHook( &countAllocation );
+}
+
+void MemoryStats::stopCounting( void )
+{
+  setAllocHook( NULL );
+}
+
+bool MemoryStats::isCounting( void )
+{
+  return( allocHook == &countAllocation );
+}
+
+// returns the previous phase of the thread
+int MemoryStats::setPhase( int p )
+{
+  int previous = phase;
+  phase = p;
+  return( previous );
+}
+
+int MemoryStats::getPhase( void )
+{
+  return( phase );
+}
+
+// prefix of the output columns of the phase
+string MemoryStats::getPhaseName( int p )
+{
+  switch( p ){
+  case PHASE_REPRODUCTION: return( "repro" );
+  case PHASE_LOSS: return( "loss" );
+  case PHASE_TRANSPOSITION: return( "transp" );
+  case PHASE_STATS: return( "stats" );
+  case PHASE_OTHER: return( "other" );
+  }
+  return( "" );
+}
+
+// since the start of the program, in all the threads
+AllocCounts MemoryStats::getAllocCounts( int p )
+{
+  AllocCounts counts;
+  counts.nbAllocs = __atomic_load_n( &vAllocCounts[p].nbAllocs,
+                                     __ATOMIC_RELAXED );
+  counts.nbBytes = __atomic_load_n( &vAllocCounts[p].nbBytes,
+                                    __ATOMIC_RELAXED );
+  return( counts );
+}
+
+// in kB, 0 if unknown
+long MemoryStats::getCurrentRss( void )
+{
+  long size = 0, resident = 0;
+  FILE * fp = fopen( "/proc/self/statm", "r" );
+  if( fp == NULL )
+    return( 0 );
+  if( fscanf( fp, "%ld %ld", &size, &resident ) != 2 )
+    resident = 0;
+  fclose( fp );
+  return( resident * ( sysconf( _SC_PAGESIZE ) / 1024 ) );
+}
+
+// in kB
+long MemoryStats::getPeakRss( void )
+{
+  struct rusage usage;
+  if( getrusage( RUSAGE_SELF, &usage ) != 0 )
+    return( 0 );
+  // the high-water mark of the kernel is updated lazily, and can lag
+  // behind the current resident set size
+  return( max( usage.ru_maxrss, getCurrentRss() ) );
+}
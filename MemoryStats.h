@@ -0,0 +1,73 @@
+/*
+ * \file MemoryStats.h
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef MEMORYSTATS_H
+#define MEMORYSTATS_H
+
+#include <string>
+#include <cstddef>
+using namespace std;
+
+// phases of a generation to which the heap allocations are attributed
+enum { PHASE_REPRODUCTION, PHASE_LOSS, PHASE_TRANSPOSITION, PHASE_STATS,
+       PHASE_OTHER, NB_PHASES };
+
+// Nb of heap allocations and of bytes allocated.
+struct AllocCounts
+{
+  long nbAllocs;
+  long nbBytes;
+};
+
+// Memory instrumentation. The chunks of ChromosomeStore, as well as the
+// global operator new of the programs linked with MemoryNew.o (not part of
+// libTEs), report each allocation to recordAllocation, which passes it to
+// a hook if one is set; the counting hook of startCounting attributes it
+// to the phase of the thread. The resident set sizes are those of the
+// process (Linux only).
+class MemoryStats
+{
+ public:
+  typedef void (*AllocHook)( size_t );
+
+  static void setAllocHook( AllocHook );
+  static void recordAllocation( size_t );
+  static void startCounting( void );
+  static void stopCounting( void );
+  static bool isCounting( void );
+
+  static int setPhase( int );
+  static int getPhase( void );
+  static string getPhaseName( int );
+  static AllocCounts getAllocCounts( int );
+
+  static long getCurrentRss( void );
+  static long getPeakRss( void );
+};
+
+// sets the phase of the thread until the end of the scope
+class MemoryPhase
+{
+  int previous;
+
+ public:
+  MemoryPhase( int p ) { previous = MemoryStats::setPhase( p ); }
+  ~MemoryPhase( void ) { MemoryStats::setPhase( previous ); }
+};
+
+#endif
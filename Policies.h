@@ -0,0 +1,73 @@
+/*
+ * \file Policies.h
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef POLICIES_H
+#define POLICIES_H
+
+// Policies of the generation kernel of Population, fixed for a whole
+// simulation so that the model branches are resolved at compile time.
+
+// regulation of the transposition rate by the copy number (parameter k)
+struct NoRegulation
+{
+  static float getProbTransp( float probTransp0, float k, int nbTEs )
+  {
+    return( probTransp0 );
+  }
+};
+
+struct CopyNbRegulation
+{
+  static float getProbTransp( float probTransp0, float k, int nbTEs )
+  {
+    return( probTransp0 / float( 1 + k * nbTEs ) );
+  }
+};
+
+// selection on the nb of TEs, of the zygotes on their viability (isOn) or
+// of the parents on their fecundity
+struct NoSelection
+{
+  static const bool isOn = false;
+  static const bool isFecundity = false;
+};
+
+struct ZygoteSelection
+{
+  static const bool isOn = true;
+  static const bool isFecundity = false;
+};
+
+struct FecunditySelection
+{
+  static const bool isOn = false;
+  static const bool isFecundity = true;
+};
+
+// messages of the given level are printed if the verbosity is above it
+struct NoLogging
+{
+  static bool isOn( int verbose, int level ) { return( false ); }
+};
+
+struct VerboseLogging
+{
+  static bool isOn( int verbose, int level ) { return( verbose > level ); }
+};
+
+#endif
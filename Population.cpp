@@ -19,19 +19,59 @@
 #include <iostream>
 #include <iomanip>  // for setprecision
 #include <fstream>
+#include <sstream>
 #include <numeric>
 #include <gsl/gsl_vector.h>
 #include <gsl/gsl_statistics.h>
 #include <gsl/gsl_blas.h>
 #include <gsl/gsl_sort_vector.h>
+#include <gsl/gsl_randist.h>
+#include <cmath>
+#include <algorithm>  // for sort
 #include <typeinfo>  // for typeid
+#include <cstring>  // for memcpy
+#include <pthread.h>
 using namespace std;
 
 #include "Population.h"
 #include "Individual.h"
+#include "Policies.h"
+
+// gametes ahead whose parents are prefetched (see makePlannedOffspring)
+static const int PREFETCH_GAMETES = 4;
+
+// individuals per chunk of the fast initialization, each with its stream
+static const int INIT_CHUNK = 256;
+
+// chunks of individuals, taken in turn by the threads
+struct InitBatch
+{
+  Population * pop;
+  int nbDiploids;
+  vector<unsigned long> vSeeds;
+  int next;
+};
+
+static void * runInitWorker( void * arg )
+{
+  InitBatch * batch = (InitBatch *) arg;
+  while( true ){
+    int chunk = __atomic_fetch_add( &batch->next, 1, __ATOMIC_RELAXED );
+    if( chunk >= (int) batch->vSeeds.size() )
+      break;
+    int first = chunk * INIT_CHUNK;
+    batch->pop->initializeIndividuals( first,
+                                       min( first + INIT_CHUNK, batch->nbDiploids ),
+                                       batch->vSeeds[ chunk ] );
+  }
+  return( NULL );
+}
 
 Population::Population( void )
 {
+  genomes.setStore( &store );
+  newGenomes.setStore( &store );
+  parentTable = NULL;
   reset();
 }
 
@@ -43,10 +83,31 @@ void Population::reset( void )
   setExpNbTEsPerIndividual( 0 );
   setTotalMapDist( 0 );
   setZygoteSelection( false );
+  setFecunditySelection( false );
   setSelMultiplicator( 0.0 );
   setSelExponent( 0.0 );
   setVerbose( 0 );
-  vInd.clear();
+  setStats( getDefaultStats() );
+  setBinaryWriter( NULL );
+  setTreeSequence( NULL );
+  setEventTrace( NULL );
+  setLinkageDisequilibrium( NULL );
+  setExitOnSaturation( true );
+  setMoran( false );
+  setFastInitialization( false );
+  setNbThreads( 1 );
+  vFamProbLoss.clear();
+  vFamProbTransp0.clear();
+  vFamK.clear();
+  saturated = false;
+  newGenomes.resize( 0, 0, 0 );
+  genomes.resize( 0, 0, 0 );
+  nbDraws = 0;
+  resetLoopCounts( true );
+  for( int phase=0; phase<NB_PHASES; ++phase )
+    vAllocsAtGen[ phase ] = MemoryStats::getAllocCounts( phase );
+  statsAllocs.nbAllocs = statsAllocs.nbBytes = 0;
+  isSnapshot = false;
 }
 
 void Population::setNbDiploids( int nd )
@@ -79,6 +140,13 @@ void Population::setZygoteSelection( bool zs )
   zygoteSelection = zs;
 }
 
+// parents sampled in proportion to their fitness rather than zygotes
+// rejected, see makeParentTable()
+void Population::setFecunditySelection( bool fs )
+{
+  fecunditySelection = fs;
+}
+
 void Population::setSelMultiplicator( float sm )
 {
   selMult = sm;
@@ -99,6 +167,77 @@ void Population::setRng( gsl_rng * rng )
   r = rng;
 }
 
+void Population::setStats( vector<string> vs )
+{
+  vStats = vs;
+}
+
+void Population::setBinaryWriter( BinaryWriter * bw )
+{
+  binOut = bw;
+}
+
+void Population::setTreeSequence( TreeSequence * ts )
+{
+  trees = ts;
+}
+
+void Population::setEventTrace( EventTrace * et )
+{
+  trace = et;
+}
+
+// used by the statistics of linkage disequilibrium, e.g. to set its nb of
+// threads; otherwise they use their own
+void Population::setLinkageDisequilibrium( LinkageDisequilibrium * l )
+{
+  ld = l;
+}
+
+// if false, a transposition into an individual without empty sites stops
+// the generation and marks the population as saturated, see isSaturated()
+void Population::setExitOnSaturation( bool eos )
+{
+  exitOnSaturation = eos;
+}
+
+// overlapping generations (Moran process) instead of discrete ones
+// (Wright-Fisher), see makeMoranGeneration()
+void Population::setMoran( bool m )
+{
+  if( m && getNbFamilies() > 1 ){
+    cerr << "ERROR: the Moran process has a single TE family" << endl;
+    exit( EXIT_FAILURE );
+  }
+  moran = m;
+  hasMoranStats = false;
+}
+
+// see initializeIndividuals()
+void Population::setFastInitialization( bool fi )
+{
+  fastInit = fi;
+}
+
+void Population::setNbThreads( int nt )
+{
+  nbThreads = max( nt, 1 );
+}
+
+// adds a TE family with its own loss, transposition and regulation, the
+// first family having those given to the generation; the families share
+// the sites, the regulation and the selection on the total nb of TEs
+void Population::addFamily( float probLoss, float probTransp0, float k )
+{
+  if( moran ){
+    cerr << "ERROR: the Moran process has a single TE family" << endl;
+    exit( EXIT_FAILURE );
+  }
+  vFamProbLoss.push_back( probLoss );
+  vFamProbTransp0.push_back( probTransp0 );
+  vFamK.push_back( k );
+}
+
 int Population::getNbDiploids( void )
 {
   return( nbDiploids );
@@ -129,6 +268,11 @@ bool Population::getZygoteSelection( void )
   return( zygoteSelection );
 }
 
+bool Population::getFecunditySelection( void )
+{
+  return( fecunditySelection );
+}
+
 float Population::getSelMultiplicator( void )
 {
   return( selMult );
@@ -149,45 +293,284 @@ gsl_rng* Population::getRng( void )
   return( r );
 }
 
+vector<string> Population::getStats( void )
+{
+  return( vStats );
+}
+
+bool Population::getMoran( void )
+{
+  return( moran );
+}
+
+bool Population::getFastInitialization( void )
+{
+  return( fastInit );
+}
+
+int Population::getNbThreads( void )
+{
+  return( nbThreads );
+}
+
+int Population::getNbFamilies( void )
+{
+  return( 1 + vFamProbLoss.size() );
+}
+
+bool Population::isSaturated( void )
+{
+  return( saturated );
+}
+
+// the columns written by default
+vector<string> Population::getDefaultStats( void )
+{
+  vector<string> vAvail;
+  vAvail.push_back( "nC" );
+  vAvail.push_back( "meanC" );
+  vAvail.push_back( "varC" );
+  vAvail.push_back( "sdC" );
+  vAvail.push_back( "minC" );
+  vAvail.push_back( "q25C" );
+  vAvail.push_back( "medC" );
+  vAvail.push_back( "q75C" );
+  vAvail.push_back( "maxC" );
+  vAvail.push_back( "empty" );
+  vAvail.push_back( "meanL" );
+  vAvail.push_back( "varL" );
+  vAvail.push_back( "sdL" );
+  return( vAvail );
+}
+
+vector<string> Population::getAvailableStats( void )
+{
+  vector<string> vAvail = getDefaultStats();
+  vAvail.push_back( "nHap" );
+  // for each rejection loop: nb of attempts, acceptance ratio and wasted
+  // random draws in the generation
+  for( int loop=0; loop<NB_LOOPS; ++loop ){
+    vAvail.push_back( getLoopName( loop ) + "Try" );
+    vAvail.push_back( getLoopName( loop ) + "Acc" );
+    vAvail.push_back( getLoopName( loop ) + "Waste" );
+  }
+  // linkage disequilibrium between the segregating loci: their nb, mean D
+  // and mean r2 of the pairs on the same chromosome or on different ones
+  vAvail.push_back( "nSeg" );
+  vAvail.push_back( "meanD" );
+  vAvail.push_back( "meanR2Linked" );
+  vAvail.push_back( "meanR2Unlinked" );
+  // memory of the process (see MemoryStats), and heap allocations of each
+  // phase of the generation (of the previous one for the statistics)
+  vAvail.push_back( "rssKB" );
+  vAvail.push_back( "peakRssKB" );
+  for( int phase=0; phase<PHASE_OTHER; ++phase ){
+    vAvail.push_back( MemoryStats::getPhaseName( phase ) + "Allocs" );
+    vAvail.push_back( MemoryStats::getPhaseName( phase ) + "Bytes" );
+  }
+  return( vAvail );
+}
+
+// Statistics of each of the first "nbFamilies" TE families, named
+// "f<i>.<stat>" (i from 1) after the default statistics.
+vector<string> Population::getFamilyStats( int nbFamilies )
+{
+  vector<string> vDefault = getDefaultStats(), vFamStats;
+  for( int fam=0; fam<nbFamilies; ++fam )
+    for( size_t i=0; i<vDefault.size(); ++i ){
+      stringstream ss;
+      ss << "f" << fam + 1 << "." << vDefault[i];
+      vFamStats.push_back( ss.str() );
+    }
+  return( vFamStats );
+}
+
+// Family (from 0) of a statistic named as in getFamilyStats(), whose default
+// statistic is put into "name"; -1 for a statistic of all the families or
+// not about the TEs.
+int Population::getStatFamily( const string & stat, string & name )
+{
+  size_t dot = stat.find( '.' );
+  if( stat[0] == 'f' && dot != string::npos && dot > 1
+      && stat.find_first_not_of( "0123456789", 1 ) == dot ){
+    name = stat.substr( dot + 1 );
+    return( atoi( stat.substr( 1, dot - 1 ).c_str() ) - 1 );
+  }
+  name = stat;
+  return( -1 );
+}
+
+bool Population::isIntegerStat( string stat )
+{
+  getStatFamily( stat, stat );
+  return( stat == "nC" || stat == "minC" || stat == "maxC"
+          || stat == "nHap" || stat == "nSeg"
+          || ( stat.size() > 3 && stat.compare( stat.size()-3, 3, "Try" ) == 0 )
+          || ( stat.size() > 5 && stat.compare( stat.size()-5, 5, "Waste" ) == 0 )
+          || ( stat.size() > 2 && stat.compare( stat.size()-2, 2, "KB" ) == 0 )
+          || ( stat.size() > 6 && stat.compare( stat.size()-6, 6, "Allocs" ) == 0 )
+          || ( stat.size() > 5 && stat.compare( stat.size()-5, 5, "Bytes" ) == 0 ) );
+}
+
 void Population::initialize( void )
 {
   if( getVerbose() > 0 )
     cout << "initialization" << endl;
+  newGenomes.resize( 0, 0, 0 );
+  newGenomes.setNbFamilies( getNbFamilies() );
+  genomes.resize( nbDiploids, nbChrPerInd, nbSitesPerChr );
+  genomes.setNbFamilies( getNbFamilies() );
+  hasMoranStats = false;
+  resetLoopCounts( true );
+  if( trees != NULL ){
+    trees->setSequenceLength( getNbLociPerIndividual() );
+    trees->initialize( nbDiploids );
+  }
+  // each family has on average "expNbTEsPerInd" TEs per individual
+  float probTEPerSite = expNbTEsPerInd / float( nbChrPerInd * nbSitesPerChr );
+  if( getNbFamilies() * probTEPerSite > 1 ){
+    cerr << "ERROR: more initial TEs than sites" << endl;
+    exit( EXIT_FAILURE );
+  }
+  if( fastInit ){
+    // the chunks of individuals are drawn in parallel, each from its own
+    // stream seeded from "r", so that the genomes don't depend on the nb
+    // of threads; the chromosomes get their private blocks beforehand, as
+    // the store isn't shared between threads
+    for( int i=0; i<nbDiploids; ++i )
+      for( int chr=0; chr<nbChrPerInd; ++chr )
+        genomes.newChromosome( i, chr );
+    InitBatch batch;
+    batch.pop = this;
+    batch.nbDiploids = nbDiploids;
+    for( int first=0; first<nbDiploids; first+=INIT_CHUNK )
+      batch.vSeeds.push_back( gsl_rng_get( r ) );
+    batch.next = 0;
+    int nbWorkers = min( nbThreads, (int) batch.vSeeds.size() );
+    vector<pthread_t> vThreads( max( nbWorkers - 1, 0 ) );
+    for( size_t t=0; t<vThreads.size(); ++t )
+      if( pthread_create( &vThreads[t], NULL, runInitWorker, &batch ) != 0 ){
+        cerr << "ERROR: can't start the initialization threads" << endl;
+        exit( EXIT_FAILURE );
+      }
+    runInitWorker( &batch );
+    for( size_t t=0; t<vThreads.size(); ++t )
+      pthread_join( vThreads[t], NULL );
+    recordInitialTEs();
+    return;
+  }
   for( int i=0; i<nbDiploids; ++i ){
-    if( getVerbose() > 1 )
-      cout << "initialize individual " << i+1 << endl;
-    Individual ind;
-    ind.setNbChromosomes( nbChrPerInd );
-    ind.setNbSitesPerChromosome( nbSitesPerChr );
-    ind.setExpNbTEsPerIndividual( expNbTEsPerInd );
-    ind.setZygoteSelection( zygoteSelection );
-    ind.setSelMultiplicator( selMult );
-    ind.setSelExponent( selExp );
-    ind.setVerbose( verbose-1 );
-    ind.setRng( r );
-    ind.initialize();
-    vInd.push_back( ind );
+    for( int chr=0; chr<nbChrPerInd; ++chr )
+      for( int site=0; site<nbSitesPerChr; ++site ){
+        float probTE = gsl_rng_uniform( r );
+        if( probTE < getNbFamilies() * probTEPerSite ){
+          genomes.insertTE( i, chr, site, (int) ( probTE / probTEPerSite ) );
+          if( trees != NULL )
+            trees->addMutation( i, chr % 2, ( chr / 2 ) * nbSitesPerChr + site,
+                                '1' );
+          if( trace != NULL )
+            trace->record( EVENT_INSERTION, i, chr, site, genomes.getNbTEs( i ) );
+        }
+      }
+  }
+}
+
+// Draws the TEs of the individuals from "first" to "last" (excluded) with
+// their own stream: the nb of TEs of each chromosome is binomial, their
+// sites are placed by Floyd's sampling and their families drawn uniformly,
+// as with one draw per site, but in a time proportional to the nb of TEs.
+// The chromosomes must have private blocks (see initialize()).
+void Population::initializeIndividuals( int first, int last,
+                                        unsigned long seed )
+{
+  gsl_rng * rInit = gsl_rng_alloc( r->type );
+  gsl_rng_set( rInit, seed );
+  int nbFamilies = getNbFamilies();
+  int nbWords = genomes.getNbWordsPerChromosome();
+  float probTEPerSite = expNbTEsPerInd / float( nbChrPerInd * nbSitesPerChr );
+  double probTE = min( 1.0, nbFamilies * (double) probTEPerSite );
+  for( int i=first; i<last; ++i ){
+    for( int chr=0; chr<nbChrPerInd; ++chr ){
+      uint64_t * pChr = genomes.newChromosome( i, chr );
+      memset( pChr, 0, (size_t) nbFamilies * nbWords * sizeof(uint64_t) );
+      int nbTEs = gsl_ran_binomial( rInit, probTE, nbSitesPerChr );
+      for( int j=nbSitesPerChr-nbTEs; j<nbSitesPerChr; ++j ){
+        int site = gsl_rng_uniform_int( rInit, j + 1 );
+        if( ( pChr[ site >> 6 ] >> ( site & 63 ) ) & 1 )
+          site = j;
+        pChr[ site >> 6 ] |= (uint64_t) 1 << ( site & 63 );
+      }
+      if( nbFamilies > 1 )
+        for( int w=0; w<nbWords; ++w )
+          for( uint64_t word=pChr[w]; word!=0; word&=word-1 ){
+            int fam = gsl_rng_uniform_int( rInit, nbFamilies );
+            uint64_t bit = word & -word;
+            pChr[w] &= ~bit;
+            pChr[ fam * nbWords + w ] |= bit;
+          }
+    }
+    genomes.updateNbTEs( i );
+  }
+  gsl_rng_free( rInit );
+}
+
+// the TEs of the fast initialization into the genealogy and the trace, in
+// the same order as with one draw per site
+void Population::recordInitialTEs( void )
+{
+  if( trees == NULL && trace == NULL )
+    return;
+  int nbFamilies = getNbFamilies();
+  int nbWords = genomes.getNbWordsPerChromosome();
+  for( int i=0; i<nbDiploids; ++i ){
+    int nbTEs = 0;
+    for( int chr=0; chr<nbChrPerInd; ++chr ){
+      const uint64_t * pChr = genomes.getChromosome( i, chr );
+      for( int w=0; w<nbWords; ++w ){
+        uint64_t word = pChr[w];
+        for( int fam=1; fam<nbFamilies; ++fam )
+          word |= pChr[ fam * nbWords + w ];
+        for( ; word!=0; word&=word-1 ){
+          int site = 64 * w + __builtin_ctzll( word );
+          ++ nbTEs;
+          if( trees != NULL )
+            trees->addMutation( i, chr % 2, ( chr / 2 ) * nbSitesPerChr + site,
+                                '1' );
+          if( trace != NULL )
+            trace->record( EVENT_INSERTION, i, chr, site, nbTEs );
+        }
+      }
+    }
   }
 }
 
 vector<double> Population::getNbTEsPerInd( void )
+{
+  return( getNbTEsPerInd( -1 ) );
+}
+
+// of TE family "fam", or of all the families if -1
+vector<double> Population::getNbTEsPerInd( int fam )
 {
   vector<double> vNbTEsPerInd;
   for( int i=0; i<nbDiploids; ++i )
-    vNbTEsPerInd.push_back( vInd[i].getNbTEs() );
+    vNbTEsPerInd.push_back( fam == -1 ? genomes.getNbTEs( i )
+                            : genomes.getNbFamilyTEs( i, fam ) );
   return( vNbTEsPerInd );
 }
 
 void Population::getNbTEsPerInd( gsl_vector *vNbTEsPerInd )
 {
   for( int i=0; i<nbDiploids; ++i )
-    gsl_vector_set( vNbTEsPerInd, i, vInd[i].getNbTEs() );
+    gsl_vector_set( vNbTEsPerInd, i, genomes.getNbTEs( i ) );
 }
 
 int Population::getSumNbTEs( void )
 {
-  vector<double> vNbTEsPerInd = getNbTEsPerInd();
-  return( getSumNbTEs( vNbTEsPerInd ) );
+  int sum = 0;
+  for( int i=0; i<nbDiploids; ++i )
+    sum += genomes.getNbTEs( i );
+  return( sum );
 }
 
 int Population::getSumNbTEs( vector<double> vNbTEsPerInd )
@@ -252,14 +635,82 @@ void Population::printDistribTEsPerInd( void )
   cout << endl;
 }
 
-void Population::sampleCouple( Individual &parent1, Individual &parent2 )
+void Population::sampleCouple( int &idPar1, int &idPar2 )
+{
+  sampleCouple( idPar1, idPar2, -1 );
+}
+
+// two distinct parents, other than "idExcluded" (if not -1)
+void Population::sampleCouple( int &idPar1, int &idPar2, int idExcluded )
 {
-  int idPar1 = gsl_rng_uniform_int( r, nbDiploids );
-  int idPar2 = gsl_rng_uniform_int( r, nbDiploids );
-  while( idPar2 == idPar1 )
+  idPar1 = gsl_rng_uniform_int( r, nbDiploids );
+  int nbAttempts = 1;
+  while( idPar1 == idExcluded ){
+    idPar1 = gsl_rng_uniform_int( r, nbDiploids );
+    ++ nbAttempts;
+  }
+  idPar2 = gsl_rng_uniform_int( r, nbDiploids );
+  while( idPar2 == idPar1 || idPar2 == idExcluded ){
     idPar2 = gsl_rng_uniform_int( r, nbDiploids );
-  parent1 = vInd[ idPar1 ];
-  parent2 = vInd[ idPar2 ];
+    ++ nbAttempts;
+  }
+  vLoopCounts[ LOOP_COUPLE ].nbAttempts += nbAttempts;
+  ++ vLoopCounts[ LOOP_COUPLE ].nbAccepted;
+  vLoopCounts[ LOOP_COUPLE ].nbWastedDraws += nbAttempts - 1;
+  nbDraws += 1 + nbAttempts;
+}
+
+// two distinct parents drawn in proportion to their fitness
+void Population::sampleParents( int &idPar1, int &idPar2 )
+{
+  idPar1 = gsl_ran_discrete( r, parentTable );
+  idPar2 = gsl_ran_discrete( r, parentTable );
+  int nbAttempts = 1;
+  while( idPar2 == idPar1 ){
+    idPar2 = gsl_ran_discrete( r, parentTable );
+    ++ nbAttempts;
+  }
+  vLoopCounts[ LOOP_COUPLE ].nbAttempts += nbAttempts;
+  ++ vLoopCounts[ LOOP_COUPLE ].nbAccepted;
+  vLoopCounts[ LOOP_COUPLE ].nbWastedDraws += nbAttempts - 1;
+  nbDraws += 1 + nbAttempts;
+}
+
+void Population::sampleCouple( Individual &parent1, Individual &parent2 )
+{
+  int idPar1, idPar2;
+  sampleCouple( idPar1, idPar2 );
+  parent1 = getIndividual( idPar1 );
+  parent2 = getIndividual( idPar2 );
+}
+
+Individual Population::getIndividual( int idInd )
+{
+  float probTEPerSite = expNbTEsPerInd / float( nbChrPerInd * nbSitesPerChr );
+  vector<Chromosome> vChr;
+  for( int chr=0; chr<nbChrPerInd; ++chr ){
+    Chromosome iChr( nbSitesPerChr, probTEPerSite, verbose-1, r );
+    for( int site=0; site<nbSitesPerChr; ++site )
+      if( genomes.isTranspElemAtSite( idInd, chr, site ) )
+        iChr[ site ] = 1;
+    vChr.push_back( iChr );
+  }
+  Individual ind;
+  ind.setNbChromosomes( nbChrPerInd );
+  ind.setNbSitesPerChromosome( nbSitesPerChr );
+  ind.setExpNbTEsPerIndividual( expNbTEsPerInd );
+  ind.setZygoteSelection( zygoteSelection );
+  ind.setSelMultiplicator( selMult );
+  ind.setSelExponent( selExp );
+  ind.setVerbose( verbose-1 );
+  ind.setRng( r );
+  ind.setChromosomes( vChr );
+  return( ind );
+}
+
+GenomeMatrix & Population::getGenomes( void )
+{
+  return( genomes );
 }
 
 void Population::addIndividual( void )
@@ -275,105 +726,899 @@ void Population::setIndividuals( vector<Individual> vNewInd )
     cerr << "ERROR: new population has different features" << endl;
     exit( EXIT_FAILURE );
   }
-  vInd = vNewInd;
+  genomes.resize( nbDiploids, nbChrPerInd, nbSitesPerChr );
+  hasMoranStats = false;
+  for( int i=0; i<nbDiploids; ++i )
+    for( int chr=0; chr<nbChrPerInd; ++chr )
+      for( int site=0; site<nbSitesPerChr; ++site )
+        if( vNewInd[i].getChromosome( chr ).isTranspElemAtSite( site ) )
+          genomes.insertTE( i, chr, site );
+}
+
+// Starts from a copy of the given genomes instead of initialize(), e.g. to
+// fork replicates from a common burn-in.
+void Population::setGenomes( const GenomeMatrix & gm )
+{
+  if( gm.getNbIndividuals() != nbDiploids
+      || gm.getNbChrPerIndividual() != nbChrPerInd
+      || gm.getNbSitesPerChromosome() != nbSitesPerChr
+      || gm.getNbFamilies() != getNbFamilies() ){
+    cerr << "ERROR: new population has different features" << endl;
+    exit( EXIT_FAILURE );
+  }
+  newGenomes.resize( 0, 0, 0 );
+  newGenomes.setNbFamilies( getNbFamilies() );
+  genomes = gm;
+  hasMoranStats = false;
+  nbDraws = 0;
+  resetLoopCounts( true );
+  if( trees != NULL ){
+    trees->setSequenceLength( getNbLociPerIndividual() );
+    trees->initialize( nbDiploids );
+    for( int i=0; i<nbDiploids; ++i )
+      for( int chr=0; chr<nbChrPerInd; ++chr )
+        for( int site=0; site<nbSitesPerChr; ++site )
+          if( genomes.isTranspElemAtSite( i, chr, site ) )
+            trees->addMutation( i, chr % 2, ( chr / 2 ) * nbSitesPerChr + site,
+                                '1' );
+  }
 }
 
+// Writes the gamete of parent "idPar" into the given homologue of each pair
+// of chromosomes of individual "idChild" of "dest". The random draws are the
+// same, and in the same order, as with Individual::getGamete(). Without
+// crossing-over, or if both parental homologues are identical, the parental
+// chromosome is shared rather than copied.
+template<class Logging, int NW>
+void Population::makeGamete( int idPar, GenomeMatrix & dest, int idChild,
+                             int homologue )
+{
+  int nbWords = genomes.getNbWordsPerChromosome();
+  int nbFamilies = genomes.getNbFamilies();
+  for( int pair=0; 2*pair<nbChrPerInd; ++pair ){
+    int nbCrossOvers = gsl_ran_poisson( r, totalMapDist );
+    vCoLoci.clear();
+    for( int i=0; i<nbCrossOvers; ++i )
+      vCoLoci.push_back( gsl_rng_uniform_int( r, nbSitesPerChr ) );
+    if( trace != NULL )
+      for( int i=0; i<nbCrossOvers; ++i )
+        trace->record( EVENT_CROSSOVER, idChild, 2*pair + homologue,
+                       vCoLoci[i], idPar );
+    int idChr = gsl_rng_uniform_int( r, 2 );
+    nbDraws += 2 + nbCrossOvers;
+    if( trees != NULL )
+      recordGamete( idPar, idChild, homologue, pair, idChr );
+    const uint64_t * pChr1 = genomes.getChromosome( idPar, 2*pair );
+    const uint64_t * pChr2 = genomes.getChromosome( idPar, 2*pair + 1 );
+    if( nbCrossOvers == 0 )
+      dest.shareChromosome( idChild, 2*pair + homologue,
+                            genomes, idPar, 2*pair + idChr );
+    else if( pChr1 == pChr2
+             || ( genomes.getNbTEs( idPar, 2*pair ) == genomes.getNbTEs( idPar, 2*pair + 1 )
+                  && ChromosomeWords<NW>::isEqual( pChr1, pChr2, nbWords,
+                                                   nbFamilies ) ) )
+      dest.shareChromosome( idChild, 2*pair + homologue,
+                            genomes, idPar, 2*pair );
+    else{
+      uint64_t * pChild = dest.newChromosome( idChild, 2*pair + homologue );
+      ChromosomeWords<NW>::recombine( pChild, pChr1, pChr2, nbWords,
+                                      nbFamilies, vCoLoci, idChr == 1 );
+      if( nbFamilies == 1 )
+        dest.setNbTEs( idChild, 2*pair + homologue,
+                       ChromosomeWords<NW>::countTEs( pChild, nbWords ) );
+      else
+        dest.updateNbTEs( idChild, 2*pair + homologue );
+    }
+  }
+}
+
+// Records the segments of the gamete made from the given pair of
+// chromosomes, as in makeGamete() where "vCoLoci" was filled.
+void Population::recordGamete( int idPar, int idChild, int homologue,
+                               int pair, int idChr )
+{
+  vector<int> vSortedLoci( vCoLoci );
+  sort( vSortedLoci.begin(), vSortedLoci.end() );
+  int offset = pair * nbSitesPerChr;
+  int left = 0;
+  int parHom = idChr;
+  for( size_t i=0; i<vSortedLoci.size(); ++i ){
+    if( vSortedLoci[i] > left ){
+      trees->addSegment( idChild, homologue, offset + left,
+                         offset + vSortedLoci[i], idPar, parHom );
+      left = vSortedLoci[i];
+    }
+    parHom = 1 - parHom;
+  }
+  trees->addSegment( idChild, homologue, offset + left,
+                     offset + nbSitesPerChr, idPar, parHom );
+}
+
+float Population::getFitness( GenomeMatrix & gm, int idInd )
+{
+  return( 1 - selMult * pow( gm.getNbTEs( idInd ), selExp ) );
+}
+
+template<class Selection>
+bool Population::isViable( GenomeMatrix & gm, int idInd )
+{
+  if( ! Selection::isOn )
+    return( true );
+  float probSel = gsl_rng_uniform( r );
+  ++ nbDraws;
+  return( probSel <= getFitness( gm, idInd ) );
+}
+
+// Walker's alias table of the fitness of the parents, built in O(N) once
+// per generation, from which each parent is then drawn in O(1).
+void Population::makeParentTable( void )
+{
+  vector<double> vFitness( nbDiploids );
+  int nbFertile = 0;
+  for( int i=0; i<nbDiploids; ++i ){
+    vFitness[i] = max( getFitness( genomes, i ), 0.0f );
+    if( vFitness[i] > 0 )
+      ++ nbFertile;
+  }
+  if( nbFertile < 2 ){
+    cerr << "ERROR: less than 2 individuals with a positive fitness" << endl;
+    exit( EXIT_FAILURE );
+  }
+  parentTable = gsl_ran_discrete_preproc( nbDiploids, &vFitness[0] );
+}
+
+// The public steps of a generation check the run-constant parameters at each
+// call; Simulation::run() rather gets once a kernel fully specialized on them
+// (see getGenerationKernel).
+
 void Population::makeNewGeneration( int v )
+{
+  hasMoranStats = false;
+  if( zygoteSelection )
+    reproduce<ZygoteSelection,VerboseLogging>();
+  else if( fecunditySelection )
+    reproduce<FecunditySelection,VerboseLogging>();
+  else
+    reproduce<NoSelection,VerboseLogging>();
+}
+
+void Population::loss( float probLoss )
+{
+  hasMoranStats = false;
+  if( genomes.getNbWordsPerChromosome() == 1 )
+    removeTEs<VerboseLogging,1>( probLoss );
+  else
+    removeTEs<VerboseLogging,0>( probLoss );
+}
+
+void Population::transposition( float probTransp0, float k )
+{
+  hasMoranStats = false;
+  if( k == 0 )
+    insertTEs<NoRegulation,VerboseLogging>( probTransp0, k );
+  else
+    insertTEs<CopyNbRegulation,VerboseLogging>( probTransp0, k );
+}
+
+// reproduction, loss and transposition, i.e. one generation
+template<class Regulation, class Selection, class Logging, int NW>
+void Population::makeGeneration( float probLoss, float probTransp0, float k )
+{
+  hasMoranStats = false;
+  resetAllocCounts();
+  int phase = MemoryStats::setPhase( PHASE_REPRODUCTION );
+  reproduce<Selection,Logging,NW>();
+  MemoryStats::setPhase( PHASE_LOSS );
+  removeTEs<Logging,NW>( probLoss );
+  MemoryStats::setPhase( PHASE_TRANSPOSITION );
+  insertTEs<Regulation,Logging>( probTransp0, k );
+  MemoryStats::setPhase( phase );
+}
+
+// Moran process: a generation is made of nbDiploids steps, each one
+// replacing an individual drawn at random by the viable offspring of two
+// others, which then undergoes loss and transposition. The statistics are
+// updated from the replaced individual and the newborn (see
+// updateMoranStats).
+template<class Regulation, class Selection, class Logging, int NW>
+void Population::makeMoranGeneration( float probLoss, float probTransp0,
+                                      float k )
+{
+  if( Selection::isFecundity ){
+    cerr << "ERROR: the fecundity selection requires discrete generations" << endl;
+    exit( EXIT_FAILURE );
+  }
+  resetAllocCounts();
+  resetLoopCounts( false );
+  if( ! hasMoranStats )
+    initMoranStats();
+  int phase = MemoryStats::getPhase();
+  for( int step=0; step<nbDiploids && ! saturated; ++step ){
+    MemoryStats::setPhase( PHASE_REPRODUCTION );
+    int idDead = gsl_rng_uniform_int( r, nbDiploids );
+    ++ nbDraws;
+    updateMoranStats( idDead, -1 );
+    while( ! makeChild<Selection,Logging,NW>( genomes, idDead, idDead ) )
+      ;
+    MemoryStats::setPhase( PHASE_LOSS );
+    removeTEs<Logging,NW>( idDead, probLoss );
+    MemoryStats::setPhase( PHASE_TRANSPOSITION );
+    insertTEs<Regulation,Logging>( idDead, probTransp0, k );
+    updateMoranStats( idDead, 1 );
+  }
+  MemoryStats::setPhase( phase );
+}
+
+template<class Regulation, class Selection, class Logging>
+Population::GenerationKernel Population::getGenerationKernel( void )
+{
+  if( moran ){
+    if( genomes.getNbWordsPerChromosome() == 1 )
+      return( &Population::makeMoranGeneration<Regulation,Selection,Logging,1> );
+    return( &Population::makeMoranGeneration<Regulation,Selection,Logging,0> );
+  }
+  if( genomes.getNbWordsPerChromosome() == 1 )
+    return( &Population::makeGeneration<Regulation,Selection,Logging,1> );
+  return( &Population::makeGeneration<Regulation,Selection,Logging,0> );
+}
+
+template<class Regulation, class Selection>
+Population::GenerationKernel Population::getGenerationKernel( void )
 {
   if( getVerbose() > 0 )
-    cout << typeid(this).name() << "::" <<  __FUNCTION__ << endl << flush;
-  vector<Individual> vNewInd;
+    return( getGenerationKernel<Regulation,Selection,VerboseLogging>() );
+  return( getGenerationKernel<Regulation,Selection,NoLogging>() );
+}
+
+template<class Regulation>
+Population::GenerationKernel Population::getGenerationKernel( void )
+{
+  if( zygoteSelection )
+    return( getGenerationKernel<Regulation,ZygoteSelection>() );
+  if( fecunditySelection )
+    return( getGenerationKernel<Regulation,FecunditySelection>() );
+  return( getGenerationKernel<Regulation,NoSelection>() );
+}
+
+// Returns the generation kernel specialized on the life cycle, the
+// regulation (k), the selection, the verbosity and the nb of words per
+// chromosome, as set when the population is initialized; use it as
+// "(pop.*kernel)( l, t, k )".
+Population::GenerationKernel Population::getGenerationKernel( float k )
+{
+  if( k == 0 )
+    return( getGenerationKernel<NoRegulation>() );
+  return( getGenerationKernel<CopyNbRegulation>() );
+}
+
+template<class Selection, class Logging>
+void Population::reproduce( void )
+{
+  if( genomes.getNbWordsPerChromosome() == 1 )
+    reproduce<Selection,Logging,1>();
+  else
+    reproduce<Selection,Logging,0>();
+}
+
+template<class Selection, class Logging, int NW>
+void Population::reproduce( void )
+{
+  if( Logging::isOn( getVerbose(), 0 ) )
+    cout << typeid(this).name() << "::makeNewGeneration" << endl << flush;
+  resetLoopCounts( false );
+  newGenomes.resize( nbDiploids, nbChrPerInd, nbSitesPerChr );
+  store.sortFreeBlocks();
+  if( trees != NULL )
+    trees->startGeneration( nbDiploids );
+  if( Selection::isFecundity )
+    makeParentTable();
+  makeOffspring<Selection,Logging,NW>();
+  if( Selection::isFecundity ){
+    gsl_ran_discrete_free( parentTable );
+    parentTable = NULL;
+  }
+  genomes.swap( newGenomes );
+  // release the parents, so that the blocks only used by the offspring can
+  // be modified in place by loss() and transposition()
+  newGenomes.resize( 0, 0, 0 );
+  if( trees != NULL )
+    trees->endGeneration();
+}
+
+// Fills "newGenomes" with viable offspring, for chromosomes of NW words
+// (see ChromosomeWords).
+template<class Selection, class Logging, int NW>
+void Population::makeOffspring( void )
+{
+  // the genealogy and the trace are recorded child by child
+  if( trees == NULL && trace == NULL ){
+    makePlannedOffspring<Selection,NW>();
+    return;
+  }
   int i = 0;
-  while( i < getNbDiploids() ){
-    if( getVerbose() > 1 )
-      cout << "make individual " << i+1 << endl << flush;
-    Individual parent1, parent2;
-    sampleCouple( parent1, parent2 );
-    vector<Chromosome> gamete1, gamete2;
-    parent1.getGamete( totalMapDist, gamete1 );
-    parent2.getGamete( totalMapDist, gamete2 );
-    Individual ind = Individual();
-    ind.fecundation( gamete1, gamete2, zygoteSelection,
-                     selMult, selExp, verbose-1 );
-    if( ind.isViable() ){
-      vNewInd.push_back( ind );
+  while( i < getNbDiploids() )
+    if( makeChild<Selection,Logging,NW>( newGenomes, i, -1 ) )
       ++i;
+}
+
+// Same offspring as makeChild() one after the other, but made in rounds:
+// the draws of the remaining attempts are planned first, in the same order,
+// then their gametes are written in the order of the parents, so that the
+// chromosomes of each parent are read together, and the viable children
+// are finally moved to the first free individuals. As an attempt makes the
+// same draws whether viable or not, and as at least as many attempts remain
+// as free individuals, the draws are those of makeChild().
+template<class Selection, int NW>
+void Population::makePlannedOffspring( void )
+{
+  int nbPairs = ( nbChrPerInd + 1 ) / 2;
+  int nbWords = genomes.getNbWordsPerChromosome();
+  int nbDone = 0;
+  while( nbDone < nbDiploids ){
+    int nbAttempts = nbDiploids - nbDone;
+    planMatings<Selection>( nbAttempts );
+    // gamete g is the homologue g % 2 of attempt g / 2; the gametes are
+    // sorted by parent, and the children keep their blocks in their order
+    int nbGametes = 2 * nbAttempts;
+    vGameteStart.assign( nbDiploids + 1, 0 );
+    for( int g=0; g<nbGametes; ++g )
+      ++ vGameteStart[ vPlanParents[g] + 1 ];
+    for( int i=0; i<nbDiploids; ++i )
+      vGameteStart[ i + 1 ] += vGameteStart[i];
+    vGameteOrder.resize( nbGametes );
+    for( int g=0; g<nbGametes; ++g )
+      vGameteOrder[ vGameteStart[ vPlanParents[g] ]++ ] = g;
+    for( int i=nbDone; i<nbDiploids; ++i )
+      for( int chr=0; chr<nbChrPerInd; ++chr )
+        newGenomes.newChromosome( i, chr );
+    for( int o=0; o<nbGametes; ++o ){
+      if( o + PREFETCH_GAMETES < nbGametes ){
+        int idNext = vPlanParents[ vGameteOrder[ o + PREFETCH_GAMETES ] ];
+        for( int chr=0; chr<nbChrPerInd; ++chr )
+          __builtin_prefetch( genomes.getChromosome( idNext, chr ) );
+      }
+      int g = vGameteOrder[o];
+      for( int pair=0; pair<nbPairs; ++pair )
+        writePlannedGamete<NW>( vPlanParents[g], newGenomes, nbDone + g / 2,
+                                g % 2, pair,
+                                &vPlanFlips[ ( (size_t) g * nbPairs + pair )
+                                             * nbWords ] );
+    }
+    int nbViable = 0;
+    for( int a=0; a<nbAttempts; ++a ){
+      int idChild = nbDone + a;
+      ++ vLoopCounts[ LOOP_VIABLE ].nbAttempts;
+      if( Selection::isOn
+          && vPlanProbSel[a] > getFitness( newGenomes, idChild ) ){
+        vLoopCounts[ LOOP_VIABLE ].nbWastedDraws += vPlanNbDraws[a];
+        continue;
+      }
+      ++ vLoopCounts[ LOOP_VIABLE ].nbAccepted;
+      if( nbDone + nbViable != idChild )
+        for( int chr=0; chr<nbChrPerInd; ++chr )
+          newGenomes.shareChromosome( nbDone + nbViable, chr,
+                                      newGenomes, idChild, chr );
+      ++ nbViable;
     }
+    nbDone += nbViable;
   }
-  setIndividuals( vNewInd );
 }
 
-void Population::loss( float probLoss )
+// Draws the parents, crossing-overs and homologues of "nbAttempts"
+// children, then their viability, as makeChild() for each in turn. The
+// crossing-overs of each gamete are kept as the words of the mask of the
+// sites coming from the second homologue (see GenomeMatrix::recombine).
+template<class Selection>
+void Population::planMatings( int nbAttempts )
 {
-  if( getVerbose() > 0 )
-    cout << typeid(this).name() << "::" <<  __FUNCTION__ << endl << flush;
+  int nbPairs = ( nbChrPerInd + 1 ) / 2;
+  int nbWords = genomes.getNbWordsPerChromosome();
+  vPlanParents.resize( 2 * nbAttempts );
+  vPlanFlips.assign( (size_t) 2 * nbAttempts * nbPairs * nbWords, 0 );
+  vPlanProbSel.resize( nbAttempts );
+  vPlanNbDraws.resize( nbAttempts );
+  for( int a=0; a<nbAttempts; ++a ){
+    long nbDrawsBefore = nbDraws;
+    if( Selection::isFecundity )
+      sampleParents( vPlanParents[ 2*a ], vPlanParents[ 2*a + 1 ] );
+    else
+      sampleCouple( vPlanParents[ 2*a ], vPlanParents[ 2*a + 1 ], -1 );
+    for( int gp=2*a*nbPairs; gp<(2*a + 2)*nbPairs; ++gp ){
+      uint64_t * pFlip = &vPlanFlips[ (size_t) gp * nbWords ];
+      int nbCrossOvers = gsl_ran_poisson( r, totalMapDist );
+      for( int i=0; i<nbCrossOvers; ++i ){
+        int site = gsl_rng_uniform_int( r, nbSitesPerChr );
+        pFlip[ site >> 6 ] ^= ~( (uint64_t) 0 ) << ( site & 63 );
+      }
+      uint64_t carry = gsl_rng_uniform_int( r, 2 ) == 1 ? ~( (uint64_t) 0 ) : 0;
+      for( int w=0; w<nbWords; ++w ){
+        uint64_t partial = pFlip[w];
+        pFlip[w] = partial ^ carry;
+        carry ^= (uint64_t) 0 - ( partial >> 63 );
+      }
+      nbDraws += 2 + nbCrossOvers;
+    }
+    if( Selection::isOn ){
+      vPlanProbSel[a] = gsl_rng_uniform( r );
+      ++ nbDraws;
+    }
+    vPlanNbDraws[a] = nbDraws - nbDrawsBefore;
+  }
+}
+
+// Writes the chromosome of the gamete made from the given pair, whose sites
+// come from the second homologue where the planned mask is set.
+template<int NW>
+void Population::writePlannedGamete( int idPar, GenomeMatrix & dest,
+                                     int idChild, int homologue, int pair,
+                                     const uint64_t * pFlip )
+{
+  int nbWords = NW > 0 ? NW : genomes.getNbWordsPerChromosome();
+  int nbFamilies = genomes.getNbFamilies();
+  const uint64_t * pChr1 = genomes.getChromosome( idPar, 2*pair );
+  const uint64_t * pChr2 = genomes.getChromosome( idPar, 2*pair + 1 );
+  bool isWhole = pFlip[0] == 0 || pFlip[0] == ~( (uint64_t) 0 );
+  for( int w=1; w<nbWords && isWhole; ++w )
+    isWhole = pFlip[w] == pFlip[0];
+  if( isWhole )
+    dest.shareChromosome( idChild, 2*pair + homologue,
+                          genomes, idPar, 2*pair + ( pFlip[0] != 0 ) );
+  else if( pChr1 == pChr2
+           || ( genomes.getNbTEs( idPar, 2*pair ) == genomes.getNbTEs( idPar, 2*pair + 1 )
+                && ChromosomeWords<NW>::isEqual( pChr1, pChr2, nbWords,
+                                                 nbFamilies ) ) )
+    dest.shareChromosome( idChild, 2*pair + homologue,
+                          genomes, idPar, 2*pair );
+  else{
+    uint64_t * pChild = dest.newChromosome( idChild, 2*pair + homologue );
+    for( int p=0; p<nbFamilies; ++p )
+      for( int w=0; w<nbWords; ++w ){
+        size_t i = (size_t) p * nbWords + w;
+        pChild[i] = ( pChr1[i] & ~pFlip[w] ) | ( pChr2[i] & pFlip[w] );
+      }
+    if( nbFamilies == 1 )
+      dest.setNbTEs( idChild, 2*pair + homologue,
+                     ChromosomeWords<NW>::countTEs( pChild, nbWords ) );
+    else
+      dest.updateNbTEs( idChild, 2*pair + homologue );
+  }
+}
+
+// Writes into individual "i" of "dest" the offspring of two parents other
+// than "idExcluded" (if not -1), and returns whether it is viable.
+template<class Selection, class Logging, int NW>
+bool Population::makeChild( GenomeMatrix & dest, int i, int idExcluded )
+{
+  long nbDrawsBefore = nbDraws;
+  int idPar1, idPar2;
+  if( Selection::isFecundity )
+    sampleParents( idPar1, idPar2 );
+  else
+    sampleCouple( idPar1, idPar2, idExcluded );
+  if( trees != NULL )
+    trees->startChild( i );
+  makeGamete<Logging,NW>( idPar1, dest, i, 0 );
+  makeGamete<Logging,NW>( idPar2, dest, i, 1 );
+  ++ vLoopCounts[ LOOP_VIABLE ].nbAttempts;
+  if( isViable<Selection>( dest, i ) ){
+    ++ vLoopCounts[ LOOP_VIABLE ].nbAccepted;
+    return( true );
+  }
+  vLoopCounts[ LOOP_VIABLE ].nbWastedDraws += nbDraws - nbDrawsBefore;
+  if( trees != NULL )
+    trees->rejectChild();
+  if( trace != NULL )
+    trace->record( EVENT_REJECTION, i, 0, 0, dest.getNbTEs( i ) );
+  return( false );
+}
+
+template<class Logging, int NW>
+void Population::removeTEs( float probLoss )
+{
+  if( Logging::isOn( getVerbose(), 0 ) )
+    cout << typeid(this).name() << "::loss" << endl << flush;
   int nbLosses = 0;
   for( int i=0; i<nbDiploids; ++i )
-    nbLosses += vInd[i].loss( probLoss );
-  if( getVerbose() > 0 )
+    nbLosses += removeTEs<Logging,NW>( i, probLoss );
+  if( Logging::isOn( getVerbose(), 0 ) )
     cout << "nb of losses: " << nbLosses << endl;
 }
 
-void Population::transposition( float probTransp0, float k )
+// losses of individual "i", whose nb is returned
+template<class Logging, int NW>
+int Population::removeTEs( int i, float probLoss )
 {
-  if( getVerbose() > 0 )
-    cout << typeid(this).name() << "::" <<  __FUNCTION__ << endl << flush;
+  int nbLoss = removeFamilyTEs<Logging,NW>( i, 0, probLoss );
+  for( size_t fam=1; fam<=vFamProbLoss.size(); ++fam )
+    nbLoss += removeFamilyTEs<Logging,NW>( i, fam, vFamProbLoss[fam-1] );
+  return( nbLoss );
+}
+
+// losses of the TEs of family "fam" of individual "i"
+template<class Logging, int NW>
+int Population::removeFamilyTEs( int i, int fam, float probLoss )
+{
+  int nbTEs = genomes.getNbFamilyTEs( i, fam );
+  if( nbTEs == 0 )
+    return( 0 );
+  int nbWords = genomes.getNbWordsPerChromosome();
+  float meanNbLoss = probLoss * nbTEs;
+  // an individual can't lose more TEs than it has
+  int nbLoss = min( (int) gsl_ran_poisson( r, meanNbLoss ), nbTEs );
+  for( int loss=0; loss<nbLoss; ++loss ){
+    int chr = gsl_rng_uniform_int( r, nbChrPerInd );
+    int nbAttempts = 1;
+    while( genomes.getNbFamilyTEs( i, chr, fam ) == 0 ){
+      chr = gsl_rng_uniform_int( r, nbChrPerInd );
+      ++ nbAttempts;
+    }
+    vLoopCounts[ LOOP_LOSS_CHR ].nbAttempts += nbAttempts;
+    ++ vLoopCounts[ LOOP_LOSS_CHR ].nbAccepted;
+    vLoopCounts[ LOOP_LOSS_CHR ].nbWastedDraws += nbAttempts - 1;
+    int rankLostTE = gsl_rng_uniform_int( r, genomes.getNbFamilyTEs( i, chr, fam ) );
+    int site = ChromosomeWords<NW>::selectTE( genomes.getChromosome( i, chr )
+                                              + fam * nbWords,
+                                              nbWords, rankLostTE );
+    genomes.removeTE( i, chr, site, fam );
+    if( trace != NULL )
+      trace->record( EVENT_LOSS, i, chr, site, genomes.getNbTEs( i ) );
+    if( trees != NULL )
+      trees->addMutation( i, chr % 2, ( chr / 2 ) * nbSitesPerChr + site, '0' );
+  }
+  return( nbLoss );
+}
+
+template<class Regulation, class Logging>
+void Population::insertTEs( float probTransp0, float k )
+{
+  if( Logging::isOn( getVerbose(), 0 ) )
+    cout << typeid(this).name() << "::transposition" << endl << flush;
   int nbTransp = 0;
-  for( int i=0; i<nbDiploids; ++i )
-    nbTransp += vInd[i].transposition( probTransp0, k );
-  if( getVerbose() > 0 )
+  for( int i=0; i<nbDiploids; ++i ){
+    int nbTranspInd = insertTEs<Regulation,Logging>( i, probTransp0, k );
+    if( nbTranspInd < 0 )
+      return;
+    nbTransp += nbTranspInd;
+  }
+  if( Logging::isOn( getVerbose(), 0 ) )
     cout << "nb of transpositions: " << nbTransp << endl;
 }
 
+// transpositions of individual "i", whose nb is returned, or -1 if the
+// individual has no more empty sites (see setExitOnSaturation)
+template<class Regulation, class Logging>
+int Population::insertTEs( int i, float probTransp0, float k )
+{
+  // the regulation of each family depends on the TEs of all the families
+  // before their transpositions
+  int nbTEs = genomes.getNbTEs( i );
+  float probTransp = Regulation::getProbTransp( probTransp0, k, nbTEs );
+  int nbTransp = insertFamilyTEs<Logging>( i, 0, probTransp );
+  for( size_t fam=1; fam<=vFamProbTransp0.size() && nbTransp >= 0; ++fam ){
+    probTransp = CopyNbRegulation::getProbTransp( vFamProbTransp0[fam-1],
+                                                  vFamK[fam-1], nbTEs );
+    int nbFamTransp = insertFamilyTEs<Logging>( i, fam, probTransp );
+    nbTransp = nbFamTransp < 0 ? -1 : nbTransp + nbFamTransp;
+  }
+  return( nbTransp );
+}
+
+// transpositions of the TEs of family "fam" of individual "i", at the given
+// rate, into sites empty in all the families
+template<class Logging>
+int Population::insertFamilyTEs( int i, int fam, float probTransp )
+{
+  int nbFamTEs = genomes.getNbFamilyTEs( i, fam );
+  if( nbFamTEs == 0 )
+    return( 0 );
+  int nbTEs = genomes.getNbTEs( i );
+  float meanNbTransp = probTransp * nbFamTEs;
+  int nbTranspInd = gsl_ran_poisson( r, meanNbTransp );
+  if( nbTEs + nbTranspInd >= nbChrPerInd * nbSitesPerChr ){
+    if( exitOnSaturation ){
+      cerr << "WARNING: too many TEs and no more empty sites" << endl;
+      exit( EXIT_FAILURE );
+    }
+    saturated = true;
+    return( -1 );
+  }
+  for( int transp=0; transp<nbTranspInd; ++transp ){
+    int chr = gsl_rng_uniform_int( r, nbChrPerInd );
+    int nbAttempts = 1;
+    while( genomes.getNbTEs( i, chr ) == nbSitesPerChr ){
+      chr = gsl_rng_uniform_int( r, nbChrPerInd );
+      ++ nbAttempts;
+    }
+    vLoopCounts[ LOOP_TRANSP_CHR ].nbAttempts += nbAttempts;
+    ++ vLoopCounts[ LOOP_TRANSP_CHR ].nbAccepted;
+    vLoopCounts[ LOOP_TRANSP_CHR ].nbWastedDraws += nbAttempts - 1;
+    int insSite = gsl_rng_uniform_int( r, nbSitesPerChr );
+    nbAttempts = 1;
+    while( genomes.isTranspElemAtSite( i, chr, insSite ) ){
+      insSite = gsl_rng_uniform_int( r, nbSitesPerChr );
+      ++ nbAttempts;
+    }
+    vLoopCounts[ LOOP_TRANSP_SITE ].nbAttempts += nbAttempts;
+    ++ vLoopCounts[ LOOP_TRANSP_SITE ].nbAccepted;
+    vLoopCounts[ LOOP_TRANSP_SITE ].nbWastedDraws += nbAttempts - 1;
+    genomes.insertTE( i, chr, insSite, fam );
+    if( trace != NULL )
+      trace->record( EVENT_INSERTION, i, chr, insSite, genomes.getNbTEs( i ) );
+    if( trees != NULL )
+      trees->addMutation( i, chr % 2, ( chr / 2 ) * nbSitesPerChr + insSite,
+                          '1' );
+  }
+  return( nbTranspInd );
+}
+
+// Copies what the statistics need from "src", at the end of a generation,
+// so that they can be computed on this population, e.g. by another thread,
+// while "src" makes the next one: the chromosomes are copied once into the
+// store of this population, and the loop and allocation counts frozen. The
+// allocations of the statistics of the previous generation are given, as
+// those of "src" are only known if it computed them itself.
+void Population::takeSnapshot( Population & src, AllocCounts prevStatsAllocs )
+{
+  nbDiploids = src.nbDiploids;
+  nbChrPerInd = src.nbChrPerInd;
+  nbSitesPerChr = src.nbSitesPerChr;
+  vStats = src.vStats;
+  binOut = src.binOut;
+  vFamProbLoss = src.vFamProbLoss;
+  vFamProbTransp0 = src.vFamProbTransp0;
+  vFamK = src.vFamK;
+  genomes = src.genomes;
+  for( int loop=0; loop<NB_LOOPS; ++loop )
+    vLoopCounts[ loop ] = src.vLoopCounts[ loop ];
+  for( int phase=0; phase<NB_PHASES; ++phase )
+    vSnapshotAllocs[ phase ] = src.getAllocCounts( phase );
+  vSnapshotAllocs[ PHASE_STATS ] = prevStatsAllocs;
+  isSnapshot = true;
+  hasMoranStats = src.hasMoranStats;
+  if( hasMoranStats ){
+    moranSumNbTEs = src.moranSumNbTEs;
+    moranSumSqNbTEs = src.moranSumSqNbTEs;
+    moranNbOccLoci = src.moranNbOccLoci;
+    vMoranNbTEsPerLoc = src.vMoranNbTEsPerLoc;
+  }
+}
+
+void Population::getStatsValues( vector<double> & vValues )
+{
+  MemoryPhase memoryPhase( PHASE_STATS );
+
+  // columns ending in "C" derive from the nb of TEs per individual, those
+  // ending in "L" from the TE frequency per locus, of all the TE families or
+  // of one (see getStatFamily): only compute what is needed (the moments of
+  // the nb of TEs are kept up to date by the Moran process)
+  int nbFamilies = getNbFamilies();
+  vector<bool> vNeedPerInd( nbFamilies + 1, false );
+  vector<bool> vNeedPerLoc( nbFamilies + 1, false );
+  bool needLd = false;
+  string stat;
+  for( size_t i=0; i<vStats.size(); ++i ){
+    int fam = getStatFamily( vStats[i], stat );
+    if( fam >= nbFamilies ){
+      cerr << "ERROR: statistic '" << vStats[i] << "' of a missing TE family"
+           << endl;
+      exit( EXIT_FAILURE );
+    }
+    char last = stat[ stat.size()-1 ];
+    if( last == 'C' ){
+      if( fam >= 0 || ! hasMoranStats || ! isMomentStat( stat ) )
+        vNeedPerInd[ fam + 1 ] = true;
+    }
+    else if( last == 'L' )
+      vNeedPerLoc[ fam + 1 ] = true;
+    else if( stat == "nSeg" || stat == "meanD"
+             || stat.compare( 0, 6, "meanR2" ) == 0 )
+      needLd = true;
+  }
+
+  vector< vector<double> > vvNbTEsPerInd( nbFamilies + 1 );
+  vector< vector<double> > vvFreqTEsPerLoc( nbFamilies + 1 );
+  vector<gsl_vector_view> vGvNbTEsPerInd( nbFamilies + 1 );
+  vector<gsl_vector_view> vGvFreqTEsPerLoc( nbFamilies + 1 );
+  for( int fam=-1; fam<nbFamilies; ++fam ){
+    if( vNeedPerInd[ fam + 1 ] ){
+      vvNbTEsPerInd[ fam + 1 ] = getNbTEsPerInd( fam );
+      vGvNbTEsPerInd[ fam + 1 ]
+        = gsl_vector_view_array( &vvNbTEsPerInd[ fam + 1 ][0], nbDiploids );
+    }
+    if( vNeedPerLoc[ fam + 1 ] ){
+      vvFreqTEsPerLoc[ fam + 1 ].resize( getNbLociPerIndividual() );
+      getFreqTEsPerLocus( &vvFreqTEsPerLoc[ fam + 1 ][0], fam );
+      vGvFreqTEsPerLoc[ fam + 1 ]
+        = gsl_vector_view_array( &vvFreqTEsPerLoc[ fam + 1 ][0],
+                                 getNbLociPerIndividual() );
+    }
+  }
+  LinkageDisequilibrium ownLd;
+  LinkageDisequilibrium & popLd = ( ld != NULL ) ? *ld : ownLd;
+  if( needLd )
+    popLd.compute( genomes );
+
+  vValues.clear();
+  for( size_t i=0; i<vStats.size(); ++i ){
+    int fam = getStatFamily( vStats[i], stat );
+    gsl_vector_view gvNbTEsPerInd = vGvNbTEsPerInd[ fam + 1 ];
+    gsl_vector_view gvFreqTEsPerLoc = vGvFreqTEsPerLoc[ fam + 1 ];
+    if( fam == -1 && hasMoranStats && isMomentStat( stat ) )
+      vValues.push_back( getMoranMoment( stat ) );
+    else if( stat == "nC" )
+      vValues.push_back( getSumNbTEs( gvNbTEsPerInd ) );
+    else if( stat == "meanC" )
+      vValues.push_back( getMeanNbTEs( gvNbTEsPerInd ) );
+    else if( stat == "varC" )
+      vValues.push_back( getVarNbTEs( gvNbTEsPerInd ) );
+    else if( stat == "sdC" )
+      vValues.push_back( getSdNbTEs( gvNbTEsPerInd ) );
+    else if( stat == "minC" )
+      vValues.push_back( getMinNbTEs( gvNbTEsPerInd ) );
+    else if( stat == "q25C" )
+      vValues.push_back( getQuantileNbTEs( gvNbTEsPerInd, 0.25 ) );
+    else if( stat == "medC" )
+      vValues.push_back( getQuantileNbTEs( gvNbTEsPerInd, 0.50 ) );
+    else if( stat == "q75C" )
+      vValues.push_back( getQuantileNbTEs( gvNbTEsPerInd, 0.75 ) );
+    else if( stat == "maxC" )
+      vValues.push_back( getMaxNbTEs( gvNbTEsPerInd ) );
+    else if( stat == "empty" )
+      vValues.push_back( getPropEmptyLoci( fam ) );
+    else if( stat == "meanL" )
+      vValues.push_back( getMeanFreqTEsPerLocus( gvFreqTEsPerLoc ) );
+    else if( stat == "varL" )
+      vValues.push_back( getVarFreqTEsPerLocus( gvFreqTEsPerLoc ) );
+    else if( stat == "sdL" )
+      vValues.push_back( getSdFreqTEsPerLocus( gvFreqTEsPerLoc ) );
+    else if( stat == "nHap" )
+      vValues.push_back( getNbHaplotypes() );
+    else if( stat == "nSeg" )
+      vValues.push_back( popLd.getNbSegregatingLoci() );
+    else if( stat == "meanD" )
+      vValues.push_back( popLd.getMeanD() );
+    else if( stat == "meanR2Linked" )
+      vValues.push_back( popLd.getMeanR2Linked() );
+    else if( stat == "meanR2Unlinked" )
+      vValues.push_back( popLd.getMeanR2Unlinked() );
+    else if( stat == "rssKB" )
+      vValues.push_back( MemoryStats::getCurrentRss() );
+    else if( stat == "peakRssKB" )
+      vValues.push_back( MemoryStats::getPeakRss() );
+    else if( ( stat.size() > 6 && stat.compare( stat.size()-6, 6, "Allocs" ) == 0 )
+             || ( stat.size() > 5 && stat.compare( stat.size()-5, 5, "Bytes" ) == 0 ) ){
+      for( int phase=0; phase<PHASE_OTHER; ++phase ){
+        AllocCounts counts = getAllocCounts( phase );
+        if( stat == MemoryStats::getPhaseName( phase ) + "Allocs" )
+          vValues.push_back( counts.nbAllocs );
+        else if( stat == MemoryStats::getPhaseName( phase ) + "Bytes" )
+          vValues.push_back( counts.nbBytes );
+      }
+    }
+    else
+      for( int loop=0; loop<NB_LOOPS; ++loop ){
+        const LoopCounts & lc = vLoopCounts[ loop ];
+        if( stat == getLoopName( loop ) + "Try" )
+          vValues.push_back( lc.nbAttempts );
+        else if( stat == getLoopName( loop ) + "Acc" )
+          vValues.push_back( lc.nbAttempts == 0 ? 1.0
+                             : (double) lc.nbAccepted / lc.nbAttempts );
+        else if( stat == getLoopName( loop ) + "Waste" )
+          vValues.push_back( lc.nbWastedDraws );
+      }
+  }
+}
+
 void Population::saveData( int simu, int gen, string outFile )
 {
-  string sep = "\t";
+  vector<double> vValues;
+  getStatsValues( vValues );
+  saveData( simu, gen, outFile, vValues );
+}
+
+// writes values already computed by getStatsValues()
+void Population::saveData( int simu, int gen, string outFile,
+                           const vector<double> & vValues )
+{
+  MemoryPhase memoryPhase( PHASE_STATS );
+  if( binOut != NULL ){
+    binOut->writeRow( simu, gen, vValues );
+    return;
+  }
+
   ofstream outStream;
   outStream.open( outFile.c_str(),
                   fstream::in | fstream::out | fstream::app );
-  outStream << simu << sep << gen << sep;
-
-  vector<double> vNbTEsPerInd = getNbTEsPerInd();
-  gsl_vector_view gvNbTEsPerInd = gsl_vector_view_array( &vNbTEsPerInd[0],
-                                                         vNbTEsPerInd.size() );
-  outStream << getSumNbTEs( gvNbTEsPerInd ) << sep;
-  outStream << setprecision(3) << getMeanNbTEs( gvNbTEsPerInd ) << sep;
-  outStream << setprecision(3) << getVarNbTEs( gvNbTEsPerInd ) << sep;
-  outStream << setprecision(3) << getSdNbTEs( gvNbTEsPerInd ) << sep;
-  outStream << getMinNbTEs( gvNbTEsPerInd ) << sep;
-  outStream << setprecision(3) << getQuantileNbTEs( gvNbTEsPerInd, 0.25 ) << sep;
-  outStream << setprecision(3) << getQuantileNbTEs( gvNbTEsPerInd, 0.50 ) << sep;
-  outStream << setprecision(3) << getQuantileNbTEs( gvNbTEsPerInd, 0.75 ) << sep;
-  outStream << getMaxNbTEs( gvNbTEsPerInd ) << sep;
-
-  vector<double> vFreqTEsPerLoc = getFreqTEsPerLocus();
-  gsl_vector_view gvFreqTEsPerLoc = gsl_vector_view_array( &vFreqTEsPerLoc[0],
-                                                           vFreqTEsPerLoc.size() );
-  outStream << setprecision(3) << getPropEmptyLoci() << sep;
-  outStream << setprecision(3) << getMeanFreqTEsPerLocus( gvFreqTEsPerLoc ) << sep;
-  outStream << setprecision(3) << getVarFreqTEsPerLocus( gvFreqTEsPerLoc ) << sep;
-
-  outStream << endl;
+  writeRow( outStream, vStats, simu, gen, vValues );
   outStream.close();
 }
 
+// one row of the TSV output
+void Population::writeRow( ostream & out, const vector<string> & vStats,
+                           int simu, int gen, const vector<double> & vValues )
+{
+  string sep = "\t";
+  out << simu << sep << gen;
+  for( size_t i=0; i<vStats.size(); ++i ){
+    out << sep;
+    if( isIntegerStat( vStats[i] ) )
+      out << (int) vValues[i];
+    else
+      out << setprecision(3) << (float) vValues[i];
+  }
+  out << endl;
+}
+
 void Population::getOccPerLocus( vector< vector<int> > & vOcc )
 {
-  for( int ind=0; ind<nbDiploids; ++ind )
-    vInd[ ind ].getOccPerLocus( vOcc[ ind ] );
+  for( int ind=0; ind<nbDiploids; ++ind ){
+    int locus = 0;
+    for( int chr=0; chr<nbChrPerInd; chr+=2 )  // "+=2" -> diploids
+      for( int site=0; site<nbSitesPerChr; ++site ){
+        vOcc[ ind ][ locus ] += genomes.isTranspElemAtSite( ind, chr, site )
+          + genomes.isTranspElemAtSite( ind, chr+1, site );
+        ++ locus;
+      }
+  }
 }
 
 vector<double> Population::getFreqTEsPerLocus()
 {
-  vector<double> vFreqTEsPerLoc;
+  vector<double> vFreqTEsPerLoc( getNbLociPerIndividual() );
+  getFreqTEsPerLocus( &vFreqTEsPerLoc[0] );
+  return( vFreqTEsPerLoc );
+}
+
+// fills the given array, of getNbLociPerIndividual() elements
+void Population::getFreqTEsPerLocus( double * pFreqTEsPerLoc )
+{
+  getFreqTEsPerLocus( pFreqTEsPerLoc, -1 );
+}
+
+// of TE family "fam", or of all the families if -1
+void Population::getFreqTEsPerLocus( double * pFreqTEsPerLoc, int fam )
+{
   int nbLociPerInd = getNbLociPerIndividual();
-  for( int loc=0; loc<nbLociPerInd; ++loc ){
-    int nbTEs = 0;
+  if( fam == -1 && hasMoranStats ){
+    for( int loc=0; loc<nbLociPerInd; ++loc )
+      pFreqTEsPerLoc[ loc ] = (float) vMoranNbTEsPerLoc[ loc ]
+        / ( (nbChrPerInd/2) * nbDiploids );
+    return;
+  }
+  // one pass over the distinct chromosomes, weighted by the nb of times they
+  // are shared, visiting only the occupied sites
+  int nbWords = genomes.getNbWordsPerChromosome();
+  int firstPlane = fam == -1 ? 0 : fam;
+  int lastPlane = fam == -1 ? genomes.getNbFamilies() - 1 : fam;
+  vector<int> vNbTEsPerLoc( nbLociPerInd, 0 );
+  vector<int> vNbCopies( store.getNbBlocks(), 0 );
+  vector<int> vIds;
+  for( int chr=0; chr<nbChrPerInd; chr+=2 ){
+    vIds.clear();
     for( int ind=0; ind<nbDiploids; ++ind )
-      nbTEs += vInd[ ind ].getNbTEsForLocus( loc );
-    vFreqTEsPerLoc.push_back( (float) nbTEs / ( (nbChrPerInd/2) * nbDiploids ) );
+      for( int hom=0; hom<2; ++hom ){
+        if( genomes.getNbTEs( ind, chr+hom ) == 0 )
+          continue;
+        int id = genomes.getChromosomeId( ind, chr+hom );
+        if( vNbCopies[id]++ == 0 )
+          vIds.push_back( id );
+      }
+    int firstLocus = ( chr / 2 ) * nbSitesPerChr;
+    for( size_t i=0; i<vIds.size(); ++i ){
+      const uint64_t * pChr = store.getBlock( vIds[i] );
+      int nbCopies = vNbCopies[ vIds[i] ];
+      vNbCopies[ vIds[i] ] = 0;
+      for( int plane=firstPlane; plane<=lastPlane; ++plane )
+        for( int w=0; w<nbWords; ++w )
+          for( uint64_t word=pChr[ plane * nbWords + w ]; word != 0;
+               word &= word - 1 )
+            vNbTEsPerLoc[ firstLocus + 64 * w + __builtin_ctzll( word ) ]
+              += nbCopies;
+    }
   }
-  return( vFreqTEsPerLoc );
+  for( int loc=0; loc<nbLociPerInd; ++loc )
+    pFreqTEsPerLoc[ loc ] = (float) vNbTEsPerLoc[ loc ]
+      / ( (nbChrPerInd/2) * nbDiploids );
 }
 
 float Population::getMeanFreqTEsPerLocus( gsl_vector_view gvFreqTEsPerLoc )
@@ -386,19 +1631,139 @@ float Population::getVarFreqTEsPerLocus( gsl_vector_view gvFreqTEsPerLoc )
   return( gsl_stats_variance( gvFreqTEsPerLoc.vector.data, 1, getNbLociPerIndividual() ) );
 }
 
+float Population::getSdFreqTEsPerLocus( gsl_vector_view gvFreqTEsPerLoc )
+{
+  return( gsl_stats_sd( gvFreqTEsPerLoc.vector.data, 1, getNbLociPerIndividual() ) );
+}
+
 float Population::getPropEmptyLoci( void )
 {
+  return( getPropEmptyLoci( -1 ) );
+}
+
+// of TE family "fam", or of all the families if -1
+float Population::getPropEmptyLoci( int fam )
+{
+  // a locus is empty in an individual if neither homologue has a TE there
   int nbLociPerInd = getNbLociPerIndividual();
-  vector< vector<int> > vOcc ( nbDiploids, vector<int>( nbLociPerInd, 0 ) );
-  getOccPerLocus( vOcc );
-  int nbEmptyLoci = 0;
-  for( int loc=0; loc<nbLociPerInd; ++loc )
-    for( int ind=0; ind<nbDiploids; ++ind )
-      if( vOcc[ ind ][ loc ] == 0 )
-        ++ nbEmptyLoci;
+  if( fam == -1 && hasMoranStats )
+    return( (float) ( nbLociPerInd * nbDiploids - moranNbOccLoci )
+            / ( nbLociPerInd * nbDiploids ) );
+  int nbWords = genomes.getNbWordsPerChromosome();
+  int firstPlane = fam == -1 ? 0 : fam;
+  int lastPlane = fam == -1 ? genomes.getNbFamilies() - 1 : fam;
+  int nbOccLoci = 0;
+  for( int ind=0; ind<nbDiploids; ++ind )
+    for( int chr=0; chr<nbChrPerInd; chr+=2 ){
+      if( genomes.getNbTEs( ind, chr ) + genomes.getNbTEs( ind, chr+1 ) == 0 )
+        continue;
+      const uint64_t * pChr1 = genomes.getChromosome( ind, chr );
+      const uint64_t * pChr2 = genomes.getChromosome( ind, chr+1 );
+      for( int w=0; w<nbWords; ++w ){
+        uint64_t word = 0;
+        for( int plane=firstPlane; plane<=lastPlane; ++plane )
+          word |= pChr1[ plane * nbWords + w ] | pChr2[ plane * nbWords + w ];
+        nbOccLoci += __builtin_popcountll( word );
+      }
+    }
+  int nbEmptyLoci = nbLociPerInd * nbDiploids - nbOccLoci;
   return( (float) nbEmptyLoci / ( nbLociPerInd * nbDiploids ) );
 }
 
+// Adds ("sign" = 1) or removes ("sign" = -1) individual "ind" from the
+// statistics kept up to date by the Moran process: sum and sum of squares
+// of the nb of TEs, nb of TEs per locus and nb of occupied loci.
+void Population::updateMoranStats( int ind, int sign )
+{
+  int nbTEs = genomes.getNbTEs( ind );
+  moranSumNbTEs += sign * nbTEs;
+  moranSumSqNbTEs += sign * (long) nbTEs * nbTEs;
+  if( nbTEs == 0 )
+    return;
+  int nbWords = genomes.getNbWordsPerChromosome();
+  for( int chr=0; chr<nbChrPerInd; chr+=2 ){
+    const uint64_t * pChr1 = genomes.getChromosome( ind, chr );
+    const uint64_t * pChr2 = genomes.getChromosome( ind, chr+1 );
+    int * pNbTEs = &vMoranNbTEsPerLoc[ ( chr / 2 ) * nbSitesPerChr ];
+    for( int w=0; w<nbWords; ++w ){
+      moranNbOccLoci += sign * __builtin_popcountll( pChr1[w] | pChr2[w] );
+      for( uint64_t word=pChr1[w]; word != 0; word &= word - 1 )
+        pNbTEs[ 64 * w + __builtin_ctzll( word ) ] += sign;
+      for( uint64_t word=pChr2[w]; word != 0; word &= word - 1 )
+        pNbTEs[ 64 * w + __builtin_ctzll( word ) ] += sign;
+    }
+  }
+}
+
+void Population::initMoranStats( void )
+{
+  moranSumNbTEs = 0;
+  moranSumSqNbTEs = 0;
+  moranNbOccLoci = 0;
+  vMoranNbTEsPerLoc.assign( getNbLociPerIndividual(), 0 );
+  for( int ind=0; ind<nbDiploids; ++ind )
+    updateMoranStats( ind, 1 );
+  hasMoranStats = true;
+}
+
+bool Population::isMomentStat( const string & stat )
+{
+  return( stat == "nC" || stat == "meanC" || stat == "varC" || stat == "sdC" );
+}
+
+// moment of the nb of TEs per individual from the sums of the Moran process
+float Population::getMoranMoment( const string & stat )
+{
+  double mean = moranSumNbTEs / (double) nbDiploids;
+  double var = ( (double) nbDiploids * moranSumSqNbTEs
+                 - (double) moranSumNbTEs * moranSumNbTEs )
+    / ( (double) nbDiploids * ( nbDiploids - 1 ) );
+  if( stat == "nC" )
+    return( moranSumNbTEs );
+  if( stat == "meanC" )
+    return( mean );
+  if( stat == "varC" )
+    return( var );
+  return( (float) mean == 0 ? 0 : sqrt( var ) );
+}
+
+// lexicographic order of the contents of chromosome blocks
+struct BlockLess
+{
+  const ChromosomeStore * store;
+  bool operator()( int a, int b ) const
+  {
+    const uint64_t * pA = store->getBlock( a );
+    const uint64_t * pB = store->getBlock( b );
+    return( lexicographical_compare( pA, pA + store->getNbWordsPerBlock(),
+                                     pB, pB + store->getNbWordsPerBlock() ) );
+  }
+};
+
+// Nb of distinct chromosomes (haplotypes) in the population, summed over the
+// pairs of homologous chromosomes. As identical chromosomes mostly share
+// their block, only the distinct blocks are compared.
+int Population::getNbHaplotypes( void )
+{
+  BlockLess blockLess;
+  blockLess.store = &store;
+  int nbHaplotypes = 0;
+  for( int chr=0; chr<nbChrPerInd; chr+=2 ){
+    vector<int> vIds;
+    for( int ind=0; ind<nbDiploids; ++ind ){
+      vIds.push_back( genomes.getChromosomeId( ind, chr ) );
+      vIds.push_back( genomes.getChromosomeId( ind, chr+1 ) );
+    }
+    sort( vIds.begin(), vIds.end() );
+    vIds.erase( unique( vIds.begin(), vIds.end() ), vIds.end() );
+    sort( vIds.begin(), vIds.end(), blockLess );
+    for( size_t i=0; i<vIds.size(); ++i )
+      if( i == 0 || blockLess( vIds[i-1], vIds[i] ) )
+        ++ nbHaplotypes;
+  }
+  return( nbHaplotypes );
+}
+
 int Population::getNbLociPerIndividual( void )
 {
   return( ( nbChrPerInd * nbSitesPerChr ) / 2 );
@@ -411,6 +1776,232 @@ void Population::printChrSequencesPerInd( void )
          << " (" << nbChrPerInd << " chr, "
          << getNbLociPerIndividual() << " loci, "
          << nbSitesPerChr * nbChrPerInd << " sites):" << endl;
-    vInd[ ind ].printChromosomes();
+    cout << "chromosomes (" << nbChrPerInd/2 << " pairs):" << endl;
+    for( int chr=0; chr<nbChrPerInd; ++chr ){
+      for( int site=0; site<nbSitesPerChr; ++site )
+        cout << genomes.isTranspElemAtSite( ind, chr, site );
+      cout << endl;
+    }
+  }
+}
+
+// starts counting a new generation, adding the counts of the current one to
+// the total unless it is also reset
+void Population::resetLoopCounts( bool resetTotal )
+{
+  for( int loop=0; loop<NB_LOOPS; ++loop ){
+    LoopCounts & total = vTotalLoopCounts[ loop ];
+    LoopCounts & current = vLoopCounts[ loop ];
+    if( resetTotal )
+      total.nbAttempts = total.nbAccepted = total.nbWastedDraws = 0;
+    else{
+      total.nbAttempts += current.nbAttempts;
+      total.nbAccepted += current.nbAccepted;
+      total.nbWastedDraws += current.nbWastedDraws;
+    }
+    current.nbAttempts = current.nbAccepted = current.nbWastedDraws = 0;
+  }
+}
+
+LoopCounts Population::getLoopCounts( int loop )
+{
+  return( vLoopCounts[ loop ] );
+}
+
+LoopCounts Population::getTotalLoopCounts( int loop )
+{
+  LoopCounts lc = vTotalLoopCounts[ loop ];
+  lc.nbAttempts += vLoopCounts[ loop ].nbAttempts;
+  lc.nbAccepted += vLoopCounts[ loop ].nbAccepted;
+  lc.nbWastedDraws += vLoopCounts[ loop ].nbWastedDraws;
+  return( lc );
+}
+
+// prefix of the output columns of the loop
+string Population::getLoopName( int loop )
+{
+  switch( loop ){
+  case LOOP_COUPLE: return( "couple" );
+  case LOOP_VIABLE: return( "viable" );
+  case LOOP_LOSS_CHR: return( "lossChr" );
+  case LOOP_TRANSP_CHR: return( "transpChr" );
+  case LOOP_TRANSP_SITE: return( "transpSite" );
+  }
+  return( "" );
+}
+
+void Population::printLoopCounts( void )
+{
+  cout << "rejection loops:" << endl;
+  for( int loop=0; loop<NB_LOOPS; ++loop ){
+    LoopCounts lc = getTotalLoopCounts( loop );
+    cout << "  " << getLoopName( loop )
+         << ": attempts=" << lc.nbAttempts
+         << " acceptance=" << setprecision(4)
+         << ( lc.nbAttempts == 0 ? 1.0 : (double) lc.nbAccepted / lc.nbAttempts )
+         << " wasted draws=" << lc.nbWastedDraws << endl;
+  }
+}
+
+// starts counting the allocations of a new generation
+void Population::resetAllocCounts( void )
+{
+  for( int phase=0; phase<NB_PHASES; ++phase ){
+    AllocCounts counts = MemoryStats::getAllocCounts( phase );
+    if( phase == PHASE_STATS ){
+      statsAllocs.nbAllocs = counts.nbAllocs - vAllocsAtGen[ phase ].nbAllocs;
+      statsAllocs.nbBytes = counts.nbBytes - vAllocsAtGen[ phase ].nbBytes;
+    }
+    vAllocsAtGen[ phase ] = counts;
+  }
+}
+
+// allocations of the phase in the current generation, except for the
+// statistics which are those of the previous one (the current ones being
+// under way); all zero unless MemoryStats counts them
+AllocCounts Population::getAllocCounts( int phase )
+{
+  if( isSnapshot )
+    return( vSnapshotAllocs[ phase ] );
+  if( phase == PHASE_STATS )
+    return( statsAllocs );
+  AllocCounts counts = MemoryStats::getAllocCounts( phase );
+  counts.nbAllocs -= vAllocsAtGen[ phase ].nbAllocs;
+  counts.nbBytes -= vAllocsAtGen[ phase ].nbBytes;
+  return( counts );
+}
+
+// bytes held by a part of the population: the genomes of both generations
+// (without their chromosomes), the chromosomes in the store, and the trees
+size_t Population::getNbBytes( int part )
+{
+  switch( part ){
+  case MEM_GENOMES:
+    return( genomes.getNbBytes() + newGenomes.getNbBytes()
+            + vCoLoci.capacity() * sizeof(int) );
+  case MEM_CHROMOSOMES:
+    return( store.getNbBytes() );
+  case MEM_TREES:
+    return( trees == NULL ? 0 : trees->getNbBytes() );
+  }
+  return( 0 );
+}
+
+string Population::getMemoryPartName( int part )
+{
+  switch( part ){
+  case MEM_GENOMES: return( "genomes" );
+  case MEM_CHROMOSOMES: return( "chromosomes" );
+  case MEM_TREES: return( "trees" );
+  }
+  return( "" );
+}
+
+// Writes the genomes and the loop counts, each distinct chromosome once:
+// int32 nb of individuals, of chromosomes per individual, of sites per
+// chromosome and of chromosomes written, these chromosomes (uint64 words),
+// then for each chromosome of each individual the int32 rank of its
+// content, and the loop counts (int64). Only a single TE family can be
+// written.
+void Population::writeState( FILE * fp )
+{
+  if( getNbFamilies() > 1 ){
+    cerr << "ERROR: the state of several TE families can't be saved" << endl;
+    exit( EXIT_FAILURE );
+  }
+  int nbWords = genomes.getNbWordsPerChromosome();
+  vector<int> vRanks( genomes.getStore()->getNbBlocks(), -1 );
+  vector<int32_t> vChrRanks;
+  vector<uint64_t> vWords;
+  int32_t nbDistinct = 0;
+  for( int i=0; i<nbDiploids; ++i )
+    for( int chr=0; chr<nbChrPerInd; ++chr ){
+      int id = genomes.getChromosomeId( i, chr );
+      if( vRanks[id] == -1 ){
+        vRanks[id] = nbDistinct ++;
+        const uint64_t * pChr = genomes.getChromosome( i, chr );
+        vWords.insert( vWords.end(), pChr, pChr + nbWords );
+      }
+      vChrRanks.push_back( vRanks[id] );
+    }
+  int32_t dims[4] = { nbDiploids, nbChrPerInd, nbSitesPerChr, nbDistinct };
+  vector<int64_t> vCounts;
+  for( int loop=0; loop<NB_LOOPS; ++loop ){
+    vCounts.push_back( vTotalLoopCounts[loop].nbAttempts );
+    vCounts.push_back( vTotalLoopCounts[loop].nbAccepted );
+    vCounts.push_back( vTotalLoopCounts[loop].nbWastedDraws );
+    vCounts.push_back( vLoopCounts[loop].nbAttempts );
+    vCounts.push_back( vLoopCounts[loop].nbAccepted );
+    vCounts.push_back( vLoopCounts[loop].nbWastedDraws );
+  }
+  vCounts.push_back( nbDraws );
+  if( fwrite( dims, sizeof(int32_t), 4, fp ) != 4
+      || fwrite( &vWords[0], sizeof(uint64_t), vWords.size(), fp ) != vWords.size()
+      || fwrite( &vChrRanks[0], sizeof(int32_t), vChrRanks.size(), fp )
+      != vChrRanks.size()
+      || fwrite( &vCounts[0], sizeof(int64_t), vCounts.size(), fp )
+      != vCounts.size() ){
+    cerr << "ERROR: can't write the state of the population" << endl;
+    exit( EXIT_FAILURE );
+  }
+}
+
+// Reads the state written by writeState(), for the same parameters;
+// identical chromosomes are shared again.
+void Population::readState( FILE * fp )
+{
+  if( getNbFamilies() > 1 ){
+    cerr << "ERROR: the state of several TE families can't be read" << endl;
+    exit( EXIT_FAILURE );
+  }
+  hasMoranStats = false;
+  int32_t dims[4];
+  if( fread( dims, sizeof(int32_t), 4, fp ) != 4
+      || dims[0] != nbDiploids || dims[1] != nbChrPerInd
+      || dims[2] != nbSitesPerChr ){
+    cerr << "ERROR: the saved population has different features" << endl;
+    exit( EXIT_FAILURE );
+  }
+  newGenomes.resize( 0, 0, 0 );
+  genomes.resize( nbDiploids, nbChrPerInd, nbSitesPerChr );
+  int nbWords = genomes.getNbWordsPerChromosome();
+  vector<uint64_t> vWords( (size_t) dims[3] * nbWords );
+  vector<int32_t> vChrRanks( (size_t) nbDiploids * nbChrPerInd );
+  vector<int64_t> vCounts( 6 * NB_LOOPS + 1 );
+  if( fread( &vWords[0], sizeof(uint64_t), vWords.size(), fp ) != vWords.size()
+      || fread( &vChrRanks[0], sizeof(int32_t), vChrRanks.size(), fp )
+      != vChrRanks.size()
+      || fread( &vCounts[0], sizeof(int64_t), vCounts.size(), fp )
+      != vCounts.size() ){
+    cerr << "ERROR: can't read the state of the population" << endl;
+    exit( EXIT_FAILURE );
+  }
+  // first chromosome holding each distinct content
+  vector<int> vFirst( dims[3], -1 );
+  for( size_t c=0; c<vChrRanks.size(); ++c ){
+    int i = c / nbChrPerInd, chr = c % nbChrPerInd, rank = vChrRanks[c];
+    if( rank < 0 || rank >= dims[3] ){
+      cerr << "ERROR: the saved population is corrupted" << endl;
+      exit( EXIT_FAILURE );
+    }
+    if( vFirst[rank] == -1 ){
+      vFirst[rank] = c;
+      uint64_t * pChr = genomes.newChromosome( i, chr );
+      memcpy( pChr, &vWords[ (size_t) rank * nbWords ],
+              nbWords * sizeof(uint64_t) );
+      genomes.setNbTEs( i, chr, GenomeMatrix::countTEs( pChr, nbWords ) );
+    }
+    else
+      genomes.shareChromosome( i, chr, genomes, vFirst[rank] / nbChrPerInd,
+                               vFirst[rank] % nbChrPerInd );
+  }
+  for( int loop=0; loop<NB_LOOPS; ++loop ){
+    vTotalLoopCounts[loop].nbAttempts = vCounts[ 6*loop ];
+    vTotalLoopCounts[loop].nbAccepted = vCounts[ 6*loop + 1 ];
+    vTotalLoopCounts[loop].nbWastedDraws = vCounts[ 6*loop + 2 ];
+    vLoopCounts[loop].nbAttempts = vCounts[ 6*loop + 3 ];
+    vLoopCounts[loop].nbAccepted = vCounts[ 6*loop + 4 ];
+    vLoopCounts[loop].nbWastedDraws = vCounts[ 6*loop + 5 ];
   }
+  nbDraws = vCounts[ 6 * NB_LOOPS ];
 }
@@ -21,11 +21,36 @@
 
 #include <vector>
 #include <string>
+#include <cstdio>
+#include <iostream>
 #include <gsl/gsl_vector.h>
+#include <gsl/gsl_randist.h>
 #include "gsl/gsl_rng.h"
 using namespace std;
 
 #include "Individual.h"
+#include "GenomeMatrix.h"
+#include "TreeSequence.h"
+#include "EventTrace.h"
+#include "BinaryWriter.h"
+#include "MemoryStats.h"
+#include "LinkageDisequilibrium.h"
+
+// the rejection loops of the simulation
+enum { LOOP_COUPLE, LOOP_VIABLE, LOOP_LOSS_CHR, LOOP_TRANSP_CHR,
+       LOOP_TRANSP_SITE, NB_LOOPS };
+
+// Attempts and accepted attempts of a rejection loop, and the nb of random
+// draws spent on the rejected ones.
+struct LoopCounts
+{
+  long nbAttempts;
+  long nbAccepted;
+  long nbWastedDraws;
+};
+
+// parts of the memory of a population
+enum { MEM_GENOMES, MEM_CHROMOSOMES, MEM_TREES, NB_MEM_PARTS };
 
 class Population
 {
@@ -35,12 +60,89 @@ class Population
   int expNbTEsPerInd;
   int totalMapDist;
   bool zygoteSelection;
+  bool fecunditySelection;
   float selMult;
   float selExp;
   int verbose;
   gsl_rng * r;
+  vector<string> vStats;
+  BinaryWriter * binOut;
+  TreeSequence * trees;
+  EventTrace * trace;
+  LinkageDisequilibrium * ld;
+  bool exitOnSaturation;
+  bool saturated;
+  bool moran;
+  bool fastInit;
+  int nbThreads;  // of the fast initialization
+  vector<float> vFamProbLoss;  // of the TE families after the first one
+  vector<float> vFamProbTransp0;
+  vector<float> vFamK;
+
+  ChromosomeStore store;  // shared by both generations, so declared first
+  GenomeMatrix genomes;
+  GenomeMatrix newGenomes;
+  vector<int> vCoLoci;
+  long nbDraws;  // nb of random draws made by the reproduction
+  LoopCounts vLoopCounts[ NB_LOOPS ];  // current generation
+  LoopCounts vTotalLoopCounts[ NB_LOOPS ];  // previous generations
+  AllocCounts vAllocsAtGen[ NB_PHASES ];  // at the start of the generation
+  AllocCounts statsAllocs;  // of the statistics of the previous generation
+  bool isSnapshot;  // see takeSnapshot
+  AllocCounts vSnapshotAllocs[ NB_PHASES ];
+  gsl_ran_discrete_t * parentTable;  // during a generation, see makeParentTable
+  vector<int> vPlanParents;  // of a round of attempts, see planMatings
+  vector<uint64_t> vPlanFlips;  // per gamete, pair of chromosomes and word
+  vector<float> vPlanProbSel;  // per attempt
+  vector<long> vPlanNbDraws;
+  vector<int> vGameteOrder;
+  vector<int> vGameteStart;
+  bool hasMoranStats;  // statistics below up to date (see updateMoranStats)
+  long moranSumNbTEs;
+  long moranSumSqNbTEs;
+  long moranNbOccLoci;
+  vector<int> vMoranNbTEsPerLoc;
+
+  template<class Selection, class Logging> void reproduce( void );
+  template<class Selection, class Logging, int NW> void reproduce( void );
+  template<class Selection, class Logging, int NW> void makeOffspring( void );
+  template<class Selection, int NW> void makePlannedOffspring( void );
+  template<class Selection> void planMatings( int );
+  template<class Selection, class Logging, int NW>
+  bool makeChild( GenomeMatrix &, int, int );
+  template<class Logging, int NW> void makeGamete( int, GenomeMatrix &, int, int );
+  template<int NW>
+  void writePlannedGamete( int, GenomeMatrix &, int, int, int, const uint64_t * );
+  template<class Logging, int NW> void removeTEs( float );
+  template<class Logging, int NW> int removeTEs( int, float );
+  template<class Logging, int NW> int removeFamilyTEs( int, int, float );
+  template<class Regulation, class Logging> void insertTEs( float, float );
+  template<class Regulation, class Logging> int insertTEs( int, float, float );
+  template<class Logging> int insertFamilyTEs( int, int, float );
+  template<class Regulation, class Selection, class Logging, int NW>
+  void makeGeneration( float, float, float );
+  template<class Regulation, class Selection, class Logging, int NW>
+  void makeMoranGeneration( float, float, float );
+  void updateMoranStats( int, int );
+  void initMoranStats( void );
+  static bool isMomentStat( const string & );
+  float getMoranMoment( const string & );
+  void recordInitialTEs( void );
+  void recordGamete( int, int, int, int, int );
+  float getFitness( GenomeMatrix &, int );
+  void makeParentTable( void );
+  template<class Selection> bool isViable( GenomeMatrix &, int );
+
+ public:
+  typedef void (Population::*GenerationKernel)( float, float, float );
 
-  vector<Individual> vInd;
+ private:
+  template<class Regulation, class Selection, class Logging>
+  GenerationKernel getGenerationKernel( void );
+  template<class Regulation, class Selection>
+  GenerationKernel getGenerationKernel( void );
+  template<class Regulation>
+  GenerationKernel getGenerationKernel( void );
 
  public:
   Population( void );
@@ -52,10 +154,21 @@ class Population
   void setExpNbTEsPerIndividual( int );
   void setTotalMapDist( int );
   void setZygoteSelection( bool );
+  void setFecunditySelection( bool );
   void setSelMultiplicator( float );
   void setSelExponent( float );
   void setVerbose( int );
   void setRng( gsl_rng * );
+  void setStats( vector<string> );
+  void setBinaryWriter( BinaryWriter * );
+  void setTreeSequence( TreeSequence * );
+  void setEventTrace( EventTrace * );
+  void setLinkageDisequilibrium( LinkageDisequilibrium * );
+  void setExitOnSaturation( bool );
+  void setMoran( bool );
+  void setFastInitialization( bool );
+  void setNbThreads( int );
+  void addFamily( float, float, float );
 
   int getNbDiploids( void );
   int getNbChrPerIndividual( void );
@@ -63,13 +176,27 @@ class Population
   int getExpNbTEsPerIndividual( void );
   int getTotalMapDist( void );
   bool getZygoteSelection( void );
+  bool getFecunditySelection( void );
   float getSelMultiplicator( void );
   float getSelExponent( void );
   int getVerbose( void );
   gsl_rng* getRng( void );
+  vector<string> getStats( void );
+  bool getMoran( void );
+  bool getFastInitialization( void );
+  int getNbThreads( void );
+  int getNbFamilies( void );
+  bool isSaturated( void );
+  static vector<string> getDefaultStats( void );
+  static vector<string> getAvailableStats( void );
+  static vector<string> getFamilyStats( int );
+  static int getStatFamily( const string &, string & );
+  static bool isIntegerStat( string );
 
   void initialize( void );
+  void initializeIndividuals( int, int, unsigned long );
   vector<double> getNbTEsPerInd( void );
+  vector<double> getNbTEsPerInd( int );
   void getNbTEsPerInd( gsl_vector * );
   int getSumNbTEs( void );
   int getSumNbTEs( vector<double> );
@@ -81,20 +208,48 @@ class Population
   float getQuantileNbTEs( gsl_vector_view, float );
   int getMaxNbTEs( gsl_vector_view );
   void printDistribTEsPerInd( void );
+  void sampleCouple( int &, int & );
+  void sampleCouple( int &, int &, int );
+  void sampleParents( int &, int & );
   void sampleCouple( Individual &, Individual & );
+  Individual getIndividual( int );
+  GenomeMatrix & getGenomes( void );
   void addIndividual( void );
   void setIndividuals( vector<Individual> );
+  void setGenomes( const GenomeMatrix & );
+  GenerationKernel getGenerationKernel( float );
   void makeNewGeneration( int );
   void loss( float );
   void transposition( float, float );
+  void takeSnapshot( Population &, AllocCounts );
+  void getStatsValues( vector<double> & );
   void saveData( int, int, string );
+  void saveData( int, int, string, const vector<double> & );
+  static void writeRow( ostream &, const vector<string> &, int, int,
+                        const vector<double> & );
   void getOccPerLocus( vector< vector<int> > & );
   vector<double> getFreqTEsPerLocus( void );
+  void getFreqTEsPerLocus( double * );
+  void getFreqTEsPerLocus( double *, int );
   float getPropEmptyLoci( void );
+  float getPropEmptyLoci( int );
+  int getNbHaplotypes( void );
   float getMeanFreqTEsPerLocus( gsl_vector_view );
   float getVarFreqTEsPerLocus( gsl_vector_view );
+  float getSdFreqTEsPerLocus( gsl_vector_view );
   int getNbLociPerIndividual( void );
   void printChrSequencesPerInd( void );
+  void resetLoopCounts( bool );
+  LoopCounts getLoopCounts( int );
+  LoopCounts getTotalLoopCounts( int );
+  static string getLoopName( int );
+  void printLoopCounts( void );
+  void resetAllocCounts( void );
+  AllocCounts getAllocCounts( int );
+  size_t getNbBytes( int );
+  static string getMemoryPartName( int );
+  void writeState( FILE * );
+  void readState( FILE * );
 };
 
 #endif
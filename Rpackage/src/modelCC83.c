@@ -0,0 +1,127 @@
+/*
+ * \file modelCC83.c
+ */
+
+// Purpose: R binding of the C interface of libTEs (cc83.h).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <R.h>
+#include <Rinternals.h>
+#include <R_ext/Rdynload.h>
+
+#include "cc83.h"
+
+static void finalizeSimulation( SEXP ptr )
+{
+  cc83_free( (cc83_simulation *) R_ExternalPtrAddr( ptr ) );
+  R_ClearExternalPtr( ptr );
+}
+
+static cc83_simulation * getSimulation( SEXP ptr )
+{
+  cc83_simulation * sim = (cc83_simulation *) R_ExternalPtrAddr( ptr );
+  if( sim == NULL )
+    error( "invalid simulation" );
+  return( sim );
+}
+
+SEXP cc83R_new( SEXP nbDiploids, SEXP nbSitesPerChr, SEXP initNbTEsPerInd,
+                SEXP probTransp0, SEXP k, SEXP probLoss, SEXP totalMapDist,
+                SEXP zygoteSelection, SEXP selMult, SEXP selExp, SEXP seed,
+                SEXP stats )
+{
+  cc83_params params;
+  cc83_default_params( &params );
+  params.nbDiploids = asInteger( nbDiploids );
+  params.nbSitesPerChr = asInteger( nbSitesPerChr );
+  params.initNbTEsPerInd = asInteger( initNbTEsPerInd );
+  params.probTransp0 = asReal( probTransp0 );
+  params.k = asReal( k );
+  params.probLoss = asReal( probLoss );
+  params.totalMapDist = asInteger( totalMapDist );
+  params.zygoteSelection = asLogical( zygoteSelection );
+  params.selMult = asReal( selMult );
+  params.selExp = asReal( selExp );
+  params.seed = (unsigned long) asReal( seed );
+  if( stats != R_NilValue )
+    params.stats = CHAR( asChar( stats ) );
+  cc83_simulation * sim = cc83_create( &params );
+  if( sim == NULL )
+    error( "%s", cc83_error() );
+  SEXP ptr = PROTECT( R_MakeExternalPtr( sim, R_NilValue, R_NilValue ) );
+  R_RegisterCFinalizerEx( ptr, finalizeSimulation, TRUE );
+  UNPROTECT( 1 );
+  return( ptr );
+}
+
+SEXP cc83R_step( SEXP ptr, SEXP nbGen )
+{
+  int nbDone = cc83_step( getSimulation( ptr ), asInteger( nbGen ) );
+  if( nbDone < 0 )
+    error( "%s", cc83_error() );
+  return( ScalarInteger( nbDone ) );
+}
+
+SEXP cc83R_generation( SEXP ptr )
+{
+  return( ScalarInteger( cc83_generation( getSimulation( ptr ) ) ) );
+}
+
+// the simulator writes into the R vectors themselves
+SEXP cc83R_stats( SEXP ptr )
+{
+  cc83_simulation * sim = getSimulation( ptr );
+  int nbStats = cc83_nb_stats( sim );
+  SEXP values = PROTECT( allocVector( REALSXP, nbStats ) );
+  SEXP names = PROTECT( allocVector( STRSXP, nbStats ) );
+  cc83_stats( sim, REAL( values ) );
+  for( int i=0; i<nbStats; ++i )
+    SET_STRING_ELT( names, i, mkChar( cc83_stat_name( sim, i ) ) );
+  setAttrib( values, R_NamesSymbol, names );
+  UNPROTECT( 2 );
+  return( values );
+}
+
+SEXP cc83R_freqPerLocus( SEXP ptr )
+{
+  cc83_simulation * sim = getSimulation( ptr );
+  SEXP freqs = PROTECT( allocVector( REALSXP, cc83_nb_loci( sim ) ) );
+  cc83_freq_per_locus( sim, REAL( freqs ) );
+  UNPROTECT( 1 );
+  return( freqs );
+}
+
+SEXP cc83R_nbTEsPerInd( SEXP ptr )
+{
+  cc83_simulation * sim = getSimulation( ptr );
+  SEXP nbTEs = PROTECT( allocVector( INTSXP, cc83_nb_diploids( sim ) ) );
+  cc83_nb_tes_per_ind( sim, INTEGER( nbTEs ) );
+  UNPROTECT( 1 );
+  return( nbTEs );
+}
+
+static const R_CallMethodDef callMethods[] = {
+  { "cc83R_new", (DL_FUNC) &cc83R_new, 12 },
+  { "cc83R_step", (DL_FUNC) &cc83R_step, 2 },
+  { "cc83R_generation", (DL_FUNC) &cc83R_generation, 1 },
+  { "cc83R_stats", (DL_FUNC) &cc83R_stats, 1 },
+  { "cc83R_freqPerLocus", (DL_FUNC) &cc83R_freqPerLocus, 1 },
+  { "cc83R_nbTEsPerInd", (DL_FUNC) &cc83R_nbTEsPerInd, 1 },
+  { NULL, NULL, 0 }
+};
+
+void R_init_modelCC83( DllInfo * dll )
+{
+  R_registerRoutines( dll, NULL, callMethods, NULL, NULL );
+  R_useDynamicSymbols( dll, FALSE );
+}
@@ -17,11 +17,18 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <iostream>
+#include <fstream>
 #include <iomanip>
+#include <sstream>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>  // for max
+#include <sys/stat.h>  // for struct stat
 using namespace std;
 
 #include "Simulation.h"
 #include "Population.h"
+#include "Checkpoint.h"
 
 Simulation::Simulation( void )
 {
@@ -36,9 +43,37 @@ Simulation::Simulation( void )
   setProbTransp0( 0.0 );
   setK( 0.0 );
   setZygoteSelection( false );
+  setMoran( false );
+  setFecunditySelection( false );
+  setFastInitialization( false, 1 );
+  setPipelinedStats( false );
   setSelMultiplicator( 0.0 );
   setSelExponent( 0.0 );
   setOutFile( "data.tsv" );
+  setStats( Population::getDefaultStats() );
+  setBinaryWriter( NULL );
+  setEventTrace( NULL );
+  setLinkageDisequilibrium( NULL );
+  setLdPrefix( "" );
+  setLdInterval( 100 );
+  setTreesPrefix( "" );
+  setSimplifyInterval( 100 );
+  setParametersText( "" );
+  setCheckpointFile( "" );
+  setCheckpointInterval( 1000 );
+  setDeadline( 0 );
+  setResumeFile( "" );
+  interrupted = false;
+  setStartGenomes( NULL );
+  setEndGenomes( NULL );
+  setEquilibriumWindow( 0 );
+  nbGenDone = 0;
+  setAggregator( NULL );
+  setRawOutput( true );
+  vMaxNbBytes.assign( NB_MEM_PARTS, 0 );
+  statsPop = NULL;
+  isStatsRunning = false;
+  hasStatsAllocs = false;
   setVerbose( 0 );
 }
 
@@ -97,6 +132,38 @@ void Simulation::setZygoteSelection( bool zs )
   zygoteSelection = zs;
 }
 
+void Simulation::setMoran( bool m )
+{
+  moran = m;
+}
+
+void Simulation::setFecunditySelection( bool fs )
+{
+  fecunditySelection = fs;
+}
+
+// with the given nb of threads, see Population::initializeIndividuals()
+void Simulation::setFastInitialization( bool fi, int nt )
+{
+  fastInit = fi;
+  nbInitThreads = nt;
+}
+
+// the statistics of a generation are computed and written by another
+// thread while the next generation is made, see startStats()
+void Simulation::setPipelinedStats( bool ps )
+{
+  pipelinedStats = ps;
+}
+
+// see Population::addFamily()
+void Simulation::addFamily( float pl, float pt0, float fk )
+{
+  vFamProbLoss.push_back( pl );
+  vFamProbTransp0.push_back( pt0 );
+  vFamK.push_back( fk );
+}
+
 void Simulation::setSelMultiplicator( float sm )
 {
   selMult = sm;
@@ -112,6 +179,108 @@ void Simulation::setOutFile( string of )
   outFile = of;
 }
 
+void Simulation::setStats( vector<string> vs )
+{
+  vStats = vs;
+}
+
+void Simulation::setBinaryWriter( BinaryWriter * bw )
+{
+  binOut = bw;
+}
+
+void Simulation::setEventTrace( EventTrace * et )
+{
+  trace = et;
+}
+
+void Simulation::setLinkageDisequilibrium( LinkageDisequilibrium * l )
+{
+  ld = l;
+}
+
+// the pairs and the decay of linkage disequilibrium are appended to
+// <prefix>_pairs.tsv and <prefix>_decay.tsv every "interval" generations
+void Simulation::setLdPrefix( string lp )
+{
+  ldPrefix = lp;
+}
+
+void Simulation::setLdInterval( int li )
+{
+  ldInterval = li;
+}
+
+void Simulation::setTreesPrefix( string tp )
+{
+  treesPrefix = tp;
+}
+
+void Simulation::setSimplifyInterval( int si )
+{
+  simplifyInterval = si;
+}
+
+void Simulation::setParametersText( string pt )
+{
+  paramsText = pt;
+}
+
+void Simulation::setCheckpointFile( string cf )
+{
+  checkpointFile = cf;
+}
+
+void Simulation::setCheckpointInterval( int ci )
+{
+  checkpointInterval = ci;
+}
+
+// the simulation is checkpointed and interrupted after the first generation
+// ending past the deadline (0 for none)
+void Simulation::setDeadline( time_t d )
+{
+  deadline = d;
+}
+
+// the simulation starts from this checkpoint instead of a new population
+void Simulation::setResumeFile( string rf )
+{
+  resumeFile = rf;
+}
+
+// the simulation starts from a copy of these genomes instead of a new
+// population
+void Simulation::setStartGenomes( const GenomeMatrix * sg )
+{
+  startGenomes = sg;
+}
+
+// the final genomes of the simulation are copied into these ones
+void Simulation::setEndGenomes( GenomeMatrix * eg )
+{
+  endGenomes = eg;
+}
+
+// if positive, the simulation stops before nbGen once at equilibrium, see
+// isAtEquilibrium()
+void Simulation::setEquilibriumWindow( int ew )
+{
+  equilibriumWindow = ew;
+}
+
+// the statistics of each generation are also added to this aggregate
+void Simulation::setAggregator( Aggregator * a )
+{
+  aggregator = a;
+}
+
+// if false, the rows of this simulation aren't written in the output file
+void Simulation::setRawOutput( bool ro )
+{
+  rawOutput = ro;
+}
+
 void Simulation::setVerbose( int v )
 {
   verbose = v;
@@ -177,6 +346,26 @@ bool Simulation::getZygoteSelection( void )
   return( zygoteSelection );
 }
 
+bool Simulation::getMoran( void )
+{
+  return( moran );
+}
+
+bool Simulation::getFecunditySelection( void )
+{
+  return( fecunditySelection );
+}
+
+bool Simulation::getFastInitialization( void )
+{
+  return( fastInit );
+}
+
+bool Simulation::getPipelinedStats( void )
+{
+  return( pipelinedStats );
+}
+
 float Simulation::getSelMultiplicator( void )
 {
   return( selMult );
@@ -192,11 +381,98 @@ string Simulation::getOutFile( void )
   return( outFile );
 }
 
+vector<string> Simulation::getStats( void )
+{
+  return( vStats );
+}
+
+string Simulation::getTreesPrefix( void )
+{
+  return( treesPrefix );
+}
+
+string Simulation::getLdPrefix( void )
+{
+  return( ldPrefix );
+}
+
+int Simulation::getLdInterval( void )
+{
+  return( ldInterval );
+}
+
+int Simulation::getSimplifyInterval( void )
+{
+  return( simplifyInterval );
+}
+
 int Simulation::getVerbose( void )
 {
   return( verbose );
 }
 
+bool Simulation::isInterrupted( void )
+{
+  return( interrupted );
+}
+
+int Simulation::getNbGenerationsDone( void )
+{
+  return( nbGenDone );
+}
+
+// largest nb of bytes held by a part of the population (see
+// Population::getNbBytes) over the generations
+size_t Simulation::getMaxNbBytes( int part )
+{
+  return( vMaxNbBytes[ part ] );
+}
+
+void Simulation::saveLd( Population & pop, int g )
+{
+  LinkageDisequilibrium ownLd;
+  LinkageDisequilibrium & simLd = ( ld != NULL ) ? *ld : ownLd;
+  simLd.setKeepPairs( true );
+  simLd.compute( pop.getGenomes() );
+  ofstream pairsStream( ( ldPrefix + "_pairs.tsv" ).c_str(), ios::app );
+  simLd.writePairs( pairsStream, getSimulationIdentifier(), g );
+  pairsStream.close();
+  ofstream decayStream( ( ldPrefix + "_decay.tsv" ).c_str(), ios::app );
+  simLd.writeDecay( decayStream, getSimulationIdentifier(), g );
+  decayStream.close();
+  simLd.setKeepPairs( false );
+}
+
+void Simulation::updateNbBytes( Population & pop )
+{
+  for( int part=0; part<NB_MEM_PARTS; ++part ){
+    size_t nbBytes = pop.getNbBytes( part );
+    if( pipelinedStats )
+      nbBytes += statsPop->getNbBytes( part );
+    vMaxNbBytes[ part ] = max( vMaxNbBytes[ part ], nbBytes );
+  }
+}
+
+// The mean nb of TEs per individual is averaged over windows of
+// "equilibriumWindow" generations; the equilibrium is reached when the
+// last window mean differs from the previous one by less than 1%, or when
+// the trend of the window means reverses.
+bool Simulation::isAtEquilibrium( double meanNbTEs, int g )
+{
+  windowSum += meanNbTEs;
+  if( g % equilibriumWindow != 0 )
+    return( false );
+  vWindowMeans.push_back( windowSum / equilibriumWindow );
+  windowSum = 0;
+  size_t n = vWindowMeans.size();
+  if( n < 2 )
+    return( false );
+  double change = vWindowMeans[n-1] - vWindowMeans[n-2];
+  if( fabs( change ) < 0.01 * vWindowMeans[n-2] )
+    return( true );
+  return( n > 2 && change * ( vWindowMeans[n-2] - vWindowMeans[n-3] ) < 0 );
+}
+
 void Simulation::printSimGen( int g )
 {
   cout << "simulation " << simuId
@@ -204,6 +480,87 @@ void Simulation::printSimGen( int g )
        << "/" << nbGen << endl;;
 }
 
+// saves the state after generation "g", with the size of the output file,
+// so that the rows written afterwards can be dropped when resuming
+void Simulation::saveCheckpoint( Population & pop, int g )
+{
+  Checkpoint ckpt;
+  ckpt.setHeaderText( paramsText );
+  ckpt.setSimulationIdentifier( getSimulationIdentifier() );
+  ckpt.setGeneration( g );
+  if( binOut != NULL )
+    ckpt.setOutFileSize( binOut->getFileSize() );
+  else{
+    struct stat fileInfo;
+    if( stat( getOutFile().c_str(), &fileInfo ) != 0 ){
+      cerr << "ERROR: can't find file " << getOutFile() << endl;
+      exit( EXIT_FAILURE );
+    }
+    ckpt.setOutFileSize( fileInfo.st_size );
+  }
+  ckpt.save( checkpointFile, r, pop );
+  if( getVerbose() > 0 )
+    cout << "checkpoint: simu " << getSimulationIdentifier()
+         << " gen " << g << " saved into " << checkpointFile << endl;
+}
+
+void Simulation::saveData( Population & pop, int g )
+{
+  if( aggregator == NULL ){
+    pop.saveData( getSimulationIdentifier(), g, getOutFile() );
+    return;
+  }
+  pop.getStatsValues( vValues );
+  aggregator->add( g, vValues );
+  if( pop.getSumNbTEs() == 0 )
+    aggregator->addExtinction( g );
+  if( rawOutput )
+    pop.saveData( getSimulationIdentifier(), g, getOutFile(), vValues );
+}
+
+// The population after generation "g" is copied into the snapshot, which
+// then belongs to the statistics thread until waitStats(): the main thread
+// only touches it again once the thread is joined, and the thread touches
+// nothing else of the simulation than the outputs, which the main thread
+// leaves alone in the meantime.
+void Simulation::startStats( Population & pop, int g )
+{
+  waitStats();
+  // the statistics of the previous generation were computed by the thread,
+  // except those of the first one
+  if( ! hasStatsAllocs )
+    statsAllocs = pop.getAllocCounts( PHASE_STATS );
+  statsPop->takeSnapshot( pop, statsAllocs );
+  statsGen = g;
+  if( pthread_create( &statsThread, NULL, &Simulation::runStats, this ) != 0 ){
+    cerr << "ERROR: can't create the statistics thread" << endl;
+    exit( EXIT_FAILURE );
+  }
+  isStatsRunning = true;
+}
+
+// the outputs are up to date once it returns
+void Simulation::waitStats( void )
+{
+  if( ! isStatsRunning )
+    return;
+  pthread_join( statsThread, NULL );
+  isStatsRunning = false;
+}
+
+void * Simulation::runStats( void * arg )
+{
+  Simulation * simu = (Simulation *) arg;
+  // only this thread allocates in the statistics phase meanwhile
+  AllocCounts before = MemoryStats::getAllocCounts( PHASE_STATS );
+  simu->saveData( *simu->statsPop, simu->statsGen );
+  AllocCounts after = MemoryStats::getAllocCounts( PHASE_STATS );
+  simu->statsAllocs.nbAllocs = after.nbAllocs - before.nbAllocs;
+  simu->statsAllocs.nbBytes = after.nbBytes - before.nbBytes;
+  simu->hasStatsAllocs = true;
+  return( NULL );
+}
+
 void Simulation::run( void )
 {
   Population pop;
@@ -213,27 +570,96 @@ void Simulation::run( void )
   pop.setExpNbTEsPerIndividual( getExpNbTEsPerIndividual() );
   pop.setTotalMapDist( getTotalMapDist() );
   pop.setZygoteSelection( getZygoteSelection() );
+  pop.setMoran( getMoran() );
+  pop.setFastInitialization( getFastInitialization() );
+  pop.setNbThreads( nbInitThreads );
+  pop.setFecunditySelection( getFecunditySelection() );
+  for( size_t fam=0; fam<vFamProbLoss.size(); ++fam )
+    pop.addFamily( vFamProbLoss[fam], vFamProbTransp0[fam], vFamK[fam] );
   pop.setSelMultiplicator( getSelMultiplicator() );
   pop.setSelExponent( getSelExponent() );
   pop.setVerbose( getVerbose()-1 );
   pop.setRng( r );
-  pop.initialize();
-  pop.saveData( getSimulationIdentifier(),
-                0, getOutFile() );
+  pop.setStats( getStats() );
+  pop.setBinaryWriter( binOut );
+  TreeSequence trees;
+  if( treesPrefix != "" )
+    pop.setTreeSequence( &trees );
+  pop.setEventTrace( trace );
+  pop.setLinkageDisequilibrium( ld );
+  Population snapshot;
+  statsPop = &snapshot;
+  hasStatsAllocs = false;
+  int firstGen = 1;
+  if( resumeFile != "" ){
+    Checkpoint ckpt;
+    ckpt.load( resumeFile, r, pop );
+    firstGen = ckpt.getGeneration() + 1;
+  }
+  else{
+    if( trace != NULL )
+      trace->record( EVENT_GENERATION, getSimulationIdentifier(), 0, 0, 0 );
+    if( startGenomes != NULL )
+      pop.setGenomes( *startGenomes );
+    else
+      pop.initialize();
+    if( aggregator != NULL )
+      aggregator->addReplicate();
+    saveData( pop, 0 );
+    if( ldPrefix != "" )
+      saveLd( pop, 0 );
+  }
+  updateNbBytes( pop );
+  Population::GenerationKernel kernel = pop.getGenerationKernel( k );
+  vWindowMeans.clear();
+  windowSum = 0;
+  nbGenDone = firstGen - 1;
 
-  for( int g=1; g<=nbGen; ++g ){
+  for( int g=firstGen; g<=nbGen; ++g ){
     if( getVerbose() > 0 ){
       printSimGen( g );
       pop.printDistribTEsPerInd();
     }
     if( pop.getSumNbTEs() > 0 ){
-      pop.makeNewGeneration( getVerbose()-1 );
-      pop.loss( probLoss );
-      pop.transposition( probTransp0, k );
-      pop.saveData( getSimulationIdentifier(),
-                    g, getOutFile() );
+      if( trace != NULL )
+        trace->record( EVENT_GENERATION, getSimulationIdentifier(), 0, g,
+                       pop.getSumNbTEs() );
+      (pop.*kernel)( probLoss, probTransp0, k );
+      updateNbBytes( pop );
+      if( pipelinedStats )
+        startStats( pop, g );
+      else
+        saveData( pop, g );
+      if( ldPrefix != "" && g % ldInterval == 0 )
+        saveLd( pop, g );
+      nbGenDone = g;
+      if( treesPrefix != "" && g % simplifyInterval == 0 )
+        trees.simplify();
+      if( checkpointFile != "" ){
+        interrupted = ( deadline != 0 && time( NULL ) >= deadline );
+        if( interrupted || g % checkpointInterval == 0 ){
+          waitStats();
+          saveCheckpoint( pop, g );
+        }
+        if( interrupted )
+          return;
+      }
     }
     else
       break;
+    if( equilibriumWindow > 0
+        && isAtEquilibrium( pop.getSumNbTEs() / double( getNbDiploids() ), g ) )
+      break;
+  }
+  waitStats();
+  if( getVerbose() > 0 )
+    pop.printLoopCounts();
+  if( endGenomes != NULL )
+    *endGenomes = pop.getGenomes();
+
+  if( treesPrefix != "" ){
+    stringstream ssPrefix;
+    ssPrefix << treesPrefix << "_simu" << getSimulationIdentifier();
+    trees.write( ssPrefix.str() );
   }
 }
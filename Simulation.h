@@ -20,9 +20,21 @@
 #define SIMULATION_H
 
 #include <string>
+#include <vector>
+#include <ctime>
+#include <pthread.h>
 #include "gsl/gsl_rng.h"
 using namespace std;
 
+#include "BinaryWriter.h"
+#include "EventTrace.h"
+#include "Aggregator.h"
+#include "LinkageDisequilibrium.h"
+#include "MemoryStats.h"
+
+class Population;
+class GenomeMatrix;
+
 class Simulation
 {
   int simuId;
@@ -36,11 +48,58 @@ class Simulation
   float probTransp0;
   float k;
   bool zygoteSelection;
+  bool moran;
+  bool fecunditySelection;
+  bool fastInit;
+  int nbInitThreads;
+  bool pipelinedStats;
+  vector<float> vFamProbLoss;  // of the TE families after the first one
+  vector<float> vFamProbTransp0;
+  vector<float> vFamK;
   float selMult;
   float selExp;
   string outFile;
+  vector<string> vStats;
+  BinaryWriter * binOut;
+  EventTrace * trace;
+  LinkageDisequilibrium * ld;
+  string ldPrefix;
+  int ldInterval;
+  string treesPrefix;
+  int simplifyInterval;
+  string paramsText;
+  string checkpointFile;
+  int checkpointInterval;
+  time_t deadline;
+  string resumeFile;
+  bool interrupted;
+  const GenomeMatrix * startGenomes;
+  GenomeMatrix * endGenomes;
+  int equilibriumWindow;
+  vector<double> vWindowMeans;
+  double windowSum;
+  int nbGenDone;
+  Aggregator * aggregator;
+  vector<double> vValues;
+  bool rawOutput;
+  vector<size_t> vMaxNbBytes;
+  Population * statsPop;  // snapshot whose statistics are being computed
+  int statsGen;
+  pthread_t statsThread;
+  bool isStatsRunning;
+  bool hasStatsAllocs;
+  AllocCounts statsAllocs;  // of the statistics thread, for its last snapshot
   int verbose;
   gsl_rng * r;
+
+  void saveCheckpoint( Population &, int );
+  bool isAtEquilibrium( double, int );
+  void saveData( Population &, int );
+  void updateNbBytes( Population & );
+  void saveLd( Population &, int );
+  void startStats( Population &, int );
+  void waitStats( void );
+  static void * runStats( void * );
   
  public:
   Simulation( void );
@@ -56,10 +115,33 @@ class Simulation
   void setProbTransp0( float );
   void setK( float );
   void setZygoteSelection( bool );
+  void setMoran( bool );
+  void setFecunditySelection( bool );
+  void setFastInitialization( bool, int );
+  void setPipelinedStats( bool );
+  void addFamily( float, float, float );
   void setSelMultiplicator( float );
   void setSelExponent( float );
   void setSeed( int );
   void setOutFile( string );
+  void setStats( vector<string> );
+  void setBinaryWriter( BinaryWriter * );
+  void setEventTrace( EventTrace * );
+  void setLinkageDisequilibrium( LinkageDisequilibrium * );
+  void setLdPrefix( string );
+  void setLdInterval( int );
+  void setTreesPrefix( string );
+  void setSimplifyInterval( int );
+  void setParametersText( string );
+  void setCheckpointFile( string );
+  void setCheckpointInterval( int );
+  void setDeadline( time_t );
+  void setResumeFile( string );
+  void setStartGenomes( const GenomeMatrix * );
+  void setEndGenomes( GenomeMatrix * );
+  void setEquilibriumWindow( int );
+  void setAggregator( Aggregator * );
+  void setRawOutput( bool );
   void setVerbose( int );
   void setRng( gsl_rng * );
 
@@ -74,9 +156,21 @@ class Simulation
   float getProbTransp0( void );
   float getK( void );
   bool getZygoteSelection( void );
+  bool getMoran( void );
+  bool getFecunditySelection( void );
+  bool getFastInitialization( void );
+  bool getPipelinedStats( void );
   float getSelMultiplicator( void );
   float getSelExponent( void );
   string getOutFile( void );
+  vector<string> getStats( void );
+  string getTreesPrefix( void );
+  string getLdPrefix( void );
+  int getLdInterval( void );
+  int getSimplifyInterval( void );
+  bool isInterrupted( void );
+  int getNbGenerationsDone( void );
+  size_t getMaxNbBytes( int );
   int getVerbose( void );
 
   void printSimGen( int );
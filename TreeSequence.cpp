@@ -0,0 +1,338 @@
+/*
+ * \file TreeSequence.cpp
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <algorithm>
+#include <queue>
+using namespace std;
+
+#include "TreeSequence.h"
+
+// min-heap of segments on their left end
+struct SegmentGreater
+{
+  bool operator()( const TreeSequence::Segment & a,
+                   const TreeSequence::Segment & b ) const
+  {
+    return( a.left > b.left );
+  }
+};
+
+// edges of the most recent parents first, as required by the simplification
+struct EdgeLess
+{
+  const vector<int> * pNodeGen;
+  bool operator()( const TreeSequence::Edge & a,
+                   const TreeSequence::Edge & b ) const
+  {
+    if( (*pNodeGen)[ a.parent ] != (*pNodeGen)[ b.parent ] )
+      return( (*pNodeGen)[ a.parent ] > (*pNodeGen)[ b.parent ] );
+    if( a.parent != b.parent )
+      return( a.parent < b.parent );
+    if( a.child != b.child )
+      return( a.child < b.child );
+    return( a.left < b.left );
+  }
+};
+
+struct EdgeByChild
+{
+  bool operator()( const TreeSequence::Edge & a,
+                   const TreeSequence::Edge & b ) const
+  {
+    if( a.child != b.child )
+      return( a.child < b.child );
+    return( a.left < b.left );
+  }
+};
+
+struct MutationLess
+{
+  bool operator()( const TreeSequence::Mutation & a,
+                   const TreeSequence::Mutation & b ) const
+  {
+    if( a.position != b.position )
+      return( a.position < b.position );
+    return( a.generation < b.generation );
+  }
+};
+
+TreeSequence::TreeSequence( void )
+{
+  seqLength = 0;
+  generation = 0;
+  nbEdgesBeforeChild = 0;
+}
+
+void TreeSequence::setSequenceLength( int sl )
+{
+  seqLength = sl;
+}
+
+int TreeSequence::getSequenceLength( void )
+{
+  return( seqLength );
+}
+
+int TreeSequence::getGeneration( void )
+{
+  return( generation );
+}
+
+size_t TreeSequence::getNbNodes( void )
+{
+  return( vNodeGen.size() );
+}
+
+size_t TreeSequence::getNbEdges( void )
+{
+  return( vEdges.size() );
+}
+
+size_t TreeSequence::getNbMutations( void )
+{
+  return( vMutations.size() );
+}
+
+size_t TreeSequence::getNbBytes( void )
+{
+  return( ( vNodeGen.capacity() + vCurNodes.capacity()
+            + vNewNodes.capacity() ) * sizeof(int)
+          + vEdges.capacity() * sizeof(Edge)
+          + vMutations.capacity() * sizeof(Mutation) );
+}
+
+void TreeSequence::initialize( int nbInd )
+{
+  generation = 0;
+  vNodeGen.assign( 2 * nbInd, 0 );
+  vEdges.clear();
+  vMutations.clear();
+  vCurNodes.clear();
+  for( int i=0; i<2*nbInd; ++i )
+    vCurNodes.push_back( i );
+}
+
+void TreeSequence::startGeneration( int nbInd )
+{
+  ++ generation;
+  vNewNodes.clear();
+  for( int i=0; i<2*nbInd; ++i ){
+    vNewNodes.push_back( vNodeGen.size() );
+    vNodeGen.push_back( generation );
+  }
+}
+
+void TreeSequence::startChild( int idChild )
+{
+  nbEdgesBeforeChild = vEdges.size();
+}
+
+// segment [left,right) of the given homologue of the child is inherited
+// from the given homologue of the parent
+void TreeSequence::addSegment( int idChild, int childHom, int left, int right,
+                               int idPar, int parHom )
+{
+  Edge edge = { left, right, vCurNodes[ 2*idPar + parHom ],
+                vNewNodes[ 2*idChild + childHom ] };
+  if( vEdges.size() > nbEdgesBeforeChild
+      && vEdges.back().parent == edge.parent
+      && vEdges.back().child == edge.child
+      && vEdges.back().right == edge.left )
+    vEdges.back().right = edge.right;
+  else
+    vEdges.push_back( edge );
+}
+
+// forget the edges of a zygote which was not viable
+void TreeSequence::rejectChild( void )
+{
+  vEdges.resize( nbEdgesBeforeChild );
+}
+
+void TreeSequence::endGeneration( void )
+{
+  vCurNodes.swap( vNewNodes );
+  vNewNodes.clear();
+}
+
+void TreeSequence::addMutation( int idInd, int hom, int position, char state )
+{
+  Mutation mut = { position, vCurNodes[ 2*idInd + hom ], generation, state };
+  vMutations.push_back( mut );
+}
+
+// squash the contiguous edges from a parent to the same child
+void TreeSequence::addOutputEdges( vector<Edge> & vPending,
+                                   vector<Edge> & vOutEdges )
+{
+  sort( vPending.begin(), vPending.end(), EdgeByChild() );
+  for( size_t i=0; i<vPending.size(); ++i ){
+    if( i > 0 && vOutEdges.back().child == vPending[i].child
+        && vOutEdges.back().right == vPending[i].left )
+      vOutEdges.back().right = vPending[i].right;
+    else
+      vOutEdges.push_back( vPending[i] );
+  }
+}
+
+// Removes all the nodes and edges which are not needed to describe the
+// genealogy of the current genomes (Kelleher et al, 2018, PLoS Comput Biol,
+// algorithm S); the current genomes become the first nodes.
+void TreeSequence::simplify( void )
+{
+  vector< vector<Segment> > vAnc( vNodeGen.size() );
+  vector<int> vOutNodeGen;
+  vector<Edge> vOutEdges;
+  for( size_t i=0; i<vCurNodes.size(); ++i ){
+    Segment seg = { 0, seqLength, (int) i };
+    vAnc[ vCurNodes[i] ].push_back( seg );
+    vOutNodeGen.push_back( vNodeGen[ vCurNodes[i] ] );
+  }
+
+  EdgeLess byParentGen;
+  byParentGen.pNodeGen = &vNodeGen;
+  sort( vEdges.begin(), vEdges.end(), byParentGen );
+
+  size_t e = 0;
+  while( e < vEdges.size() ){
+    int u = vEdges[e].parent;
+    priority_queue<Segment, vector<Segment>, SegmentGreater> queue;
+    for( ; e < vEdges.size() && vEdges[e].parent == u; ++e ){
+      const Edge & edge = vEdges[e];
+      const vector<Segment> & vChildAnc = vAnc[ edge.child ];
+      for( size_t i=0; i<vChildAnc.size(); ++i )
+        if( vChildAnc[i].right > edge.left && edge.right > vChildAnc[i].left ){
+          Segment seg = { max( vChildAnc[i].left, edge.left ),
+                          min( vChildAnc[i].right, edge.right ),
+                          vChildAnc[i].node };
+          queue.push( seg );
+        }
+    }
+
+    int v = -1;
+    vector<Edge> vPending;
+    while( ! queue.empty() ){
+      int left = queue.top().left;
+      int right = seqLength;
+      vector<Segment> vOverlap;
+      while( ! queue.empty() && queue.top().left == left ){
+        vOverlap.push_back( queue.top() );
+        right = min( right, queue.top().right );
+        queue.pop();
+      }
+      if( ! queue.empty() )
+        right = min( right, queue.top().left );
+      Segment alpha;
+      if( vOverlap.size() == 1 ){
+        // no coalescence: the segment goes up unchanged
+        alpha = vOverlap[0];
+        if( ! queue.empty() && queue.top().left < vOverlap[0].right ){
+          alpha.right = queue.top().left;
+          vOverlap[0].left = queue.top().left;
+          queue.push( vOverlap[0] );
+        }
+      }
+      else{
+        if( v == -1 ){
+          v = vOutNodeGen.size();
+          vOutNodeGen.push_back( vNodeGen[u] );
+        }
+        alpha.left = left;
+        alpha.right = right;
+        alpha.node = v;
+        for( size_t i=0; i<vOverlap.size(); ++i ){
+          Edge edge = { left, right, v, vOverlap[i].node };
+          vPending.push_back( edge );
+          if( vOverlap[i].right > right ){
+            vOverlap[i].left = right;
+            queue.push( vOverlap[i] );
+          }
+        }
+      }
+      vAnc[u].push_back( alpha );
+    }
+    if( v != -1 )
+      addOutputEdges( vPending, vOutEdges );
+  }
+
+  // a mutation goes to the output node carrying its position, if any
+  vector<Mutation> vOutMutations;
+  for( size_t m=0; m<vMutations.size(); ++m ){
+    const vector<Segment> & vNodeAnc = vAnc[ vMutations[m].node ];
+    for( size_t i=0; i<vNodeAnc.size(); ++i )
+      if( vNodeAnc[i].left <= vMutations[m].position
+          && vMutations[m].position < vNodeAnc[i].right ){
+        vOutMutations.push_back( vMutations[m] );
+        vOutMutations.back().node = vNodeAnc[i].node;
+        break;
+      }
+  }
+
+  vNodeGen.swap( vOutNodeGen );
+  vEdges.swap( vOutEdges );
+  vMutations.swap( vOutMutations );
+  for( size_t i=0; i<vCurNodes.size(); ++i )
+    vCurNodes[i] = i;
+}
+
+// Writes the tables in the text format of tskit, with times in generations
+// before the current one, e.g. in Python:
+//   tskit.load_text( nodes=open(prefix+".nodes.txt"), edges=..., sites=...,
+//                    mutations=..., sequence_length=L, strict=False )
+void TreeSequence::write( string prefix )
+{
+  simplify();
+  string nodesFile = prefix + ".nodes.txt";
+  ofstream outStream( nodesFile.c_str() );
+  outStream << "is_sample\ttime" << endl;
+  for( size_t i=0; i<vNodeGen.size(); ++i )
+    outStream << ( i < vCurNodes.size() ? 1 : 0 ) << "\t"
+              << generation - vNodeGen[i] << endl;
+  outStream.close();
+
+  string edgesFile = prefix + ".edges.txt";
+  outStream.open( edgesFile.c_str() );
+  outStream << "left\tright\tparent\tchild" << endl;
+  for( size_t i=0; i<vEdges.size(); ++i )
+    outStream << vEdges[i].left << "\t" << vEdges[i].right << "\t"
+              << vEdges[i].parent << "\t" << vEdges[i].child << endl;
+  outStream.close();
+
+  stable_sort( vMutations.begin(), vMutations.end(), MutationLess() );
+  string sitesFile = prefix + ".sites.txt";
+  string mutationsFile = prefix + ".mutations.txt";
+  ofstream outSites( sitesFile.c_str() );
+  outStream.open( mutationsFile.c_str() );
+  outSites << "position\tancestral_state" << endl;
+  outStream << "site\tnode\ttime\tderived_state" << endl;
+  int site = -1;
+  for( size_t m=0; m<vMutations.size(); ++m ){
+    if( m == 0 || vMutations[m].position != vMutations[m-1].position ){
+      ++ site;
+      outSites << vMutations[m].position << "\t0" << endl;
+    }
+    outStream << site << "\t" << vMutations[m].node << "\t"
+              << generation - vMutations[m].generation << "\t"
+              << vMutations[m].state << endl;
+  }
+  outSites.close();
+  outStream.close();
+}
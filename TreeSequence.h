@@ -0,0 +1,73 @@
+/*
+ * \file TreeSequence.h
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TREESEQUENCE_H
+#define TREESEQUENCE_H
+
+#include <vector>
+#include <string>
+using namespace std;
+
+// Records the genealogy of the genomes as tables of nodes, edges and
+// mutations, as in tskit. A node is one haploid genome, i.e. the homologue
+// 0 (from the 1st parent) or 1 (from the 2nd parent) of all the chromosome
+// pairs of an individual; the chromosome pairs are laid end to end so that
+// locus "pair * nbSitesPerChr + site" is at position of the same value.
+// TE insertions and losses are mutations with derived state 1 and 0.
+class TreeSequence
+{
+ public:
+  struct Edge { int left, right, parent, child; };
+  struct Mutation { int position, node, generation; char state; };
+  struct Segment { int left, right, node; };
+
+ private:
+  int seqLength;
+  int generation;
+  vector<int> vNodeGen;  // generation at which each node was born
+  vector<Edge> vEdges;
+  vector<Mutation> vMutations;
+  vector<int> vCurNodes;  // nodes of the current generation, 2 per individual
+  vector<int> vNewNodes;  // nodes of the generation being made
+  size_t nbEdgesBeforeChild;
+
+  void addOutputEdges( vector<Edge> &, vector<Edge> & );
+
+ public:
+  TreeSequence( void );
+
+  void setSequenceLength( int );
+  int getSequenceLength( void );
+  int getGeneration( void );
+  size_t getNbNodes( void );
+  size_t getNbEdges( void );
+  size_t getNbMutations( void );
+  size_t getNbBytes( void );
+
+  void initialize( int );
+  void startGeneration( int );
+  void startChild( int );
+  void addSegment( int, int, int, int, int, int );
+  void rejectChild( void );
+  void endGeneration( void );
+  void addMutation( int, int, int, char );
+  void simplify( void );
+  void write( string );
+};
+
+#endif
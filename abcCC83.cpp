@@ -0,0 +1,328 @@
+/*
+ * \file abcCC83.cpp
+ */
+
+// Purpose: fit the model of modelCC83 to observed statistics by ABC.
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <ctime>
+#include <unistd.h>  // for sysconf
+#include <getopt.h>
+#include <vector>
+#include <algorithm>  // for find
+#include "gsl/gsl_rng.h"
+using namespace std;
+
+#include "Abc.h"
+#include "Population.h"
+
+enum { OPT_PRIOR = 256, OPT_OBSERVED, OPT_STATS, OPT_MAX_COPIES };
+
+void usage( char *program_name, int status )
+{
+  cerr << "usage: " << program_name << " [options]\n";
+  cerr << "fit the parameters of modelCC83 to observed statistics by ABC" << endl;
+  cerr << "options:" << endl;
+  cerr << "     -h: this help" << endl;
+  cerr << "     -n: number of diploids (default=10)" << endl;
+  cerr << "     -g: number of generations per simulation (default=10)" << endl;
+  cerr << "     -c: number of sites per chromosome (default=31)" << endl;
+  cerr << "     -i: initial number of TEs per individual (default=10)" << endl;
+  cerr << "     -d: total recombination map distance (default=90)" << endl;
+  cerr << "     -S: apply zygote selection" << endl;
+  cerr << "     --prior: <param>=uniform:<min>:<max>, <param>=loguniform:<min>:<max>" << endl;
+  cerr << "         or <param>=<value>, for the parameters probTransp0, k, probLoss," << endl;
+  cerr << "         selMult and selExp (default: fixed at the defaults of modelCC83)" << endl;
+  cerr << "     --observed: TSV file whose last row holds the observed statistics," << endl;
+  cerr << "         e.g. an output of modelCC83" << endl;
+  cerr << "     --stats: comma-separated list of the statistics to fit (default: all" << endl;
+  cerr << "         the columns of --observed among those of modelCC83 --stats)" << endl;
+  cerr << "     --max-copies: stop the simulations whose mean nb of TEs per" << endl;
+  cerr << "         individual exceeds x (default=0, no bound)" << endl;
+  cerr << "     -N: number of particles (default=1000)" << endl;
+  cerr << "     -P: number of simulations of the rejection round (default=10*N)" << endl;
+  cerr << "     -R: number of rounds, the first one by rejection, the next ones by" << endl;
+  cerr << "         SMC (default=1)" << endl;
+  cerr << "     -q: quantile of the distances giving the next tolerance (default=0.5)" << endl;
+  cerr << "     -j: number of threads (default=nb of processors)" << endl;
+  cerr << "     -r: seed of the pseudo-random generator (default=1859)" << endl;
+  cerr << "     -o: name of the output file (default=abc.csv)" << endl;
+  cerr << "     -v: verbose (default=1, 0 to be quiet)" << endl;
+  exit( status );
+}
+
+// the names and values of the last row of a TSV file
+void readObserved( string inFile, vector<string> & vNames,
+                   vector<double> & vValues )
+{
+  ifstream inStream( inFile.c_str() );
+  if( ! inStream.is_open() ){
+    cerr << "ERROR: can't open file " << inFile << endl;
+    exit( EXIT_FAILURE );
+  }
+  string line, lastLine;
+  vNames.clear();
+  while( getline( inStream, line ) ){
+    if( line.empty() || line[0] == '#' )
+      continue;
+    if( vNames.empty() ){
+      stringstream ss( line );
+      string name;
+      while( getline( ss, name, '\t' ) )
+        vNames.push_back( name );
+    }
+    else
+      lastLine = line;
+  }
+  vValues.clear();
+  stringstream ss( lastLine );
+  string value;
+  while( getline( ss, value, '\t' ) )
+    vValues.push_back( atof( value.c_str() ) );
+  if( vNames.empty() || vValues.size() != vNames.size() ){
+    cerr << "ERROR: " << inFile << " should have a header and a row of values"
+         << endl;
+    exit( EXIT_FAILURE );
+  }
+}
+
+int main( int argc, char* argv[] )
+{
+  int nbDiploids = 10;
+  int nbGen = 10;
+  int nbSitesPerChr = 31;
+  int initNbTEsPerInd = 10;
+  int totalMapDist = 90;
+  bool zygoteSelection = false;
+  string observedFile = "";
+  string statsArg = "";
+  double maxCopies = 0;
+  int nbParticles = 1000;
+  int nbPriorDraws = 0;
+  int nbRounds = 1;
+  double quantile = 0.5;
+  int nbThreads = sysconf( _SC_NPROCESSORS_ONLN );
+  int seed = 1859;
+  string outFile = "abc.csv";
+  int verbose = 1;
+  Abc abc;
+  vector<string> vPriorArgs;
+
+  int c;
+  extern char *optarg;
+  static struct option longOptions[] = {
+    { "prior", required_argument, 0, OPT_PRIOR },
+    { "observed", required_argument, 0, OPT_OBSERVED },
+    { "stats", required_argument, 0, OPT_STATS },
+    { "max-copies", required_argument, 0, OPT_MAX_COPIES },
+    { 0, 0, 0, 0 }
+  };
+  while( (c = getopt_long(argc,argv,"hn:g:c:i:d:SN:P:R:q:j:r:o:v:",
+                          longOptions,NULL)) != -1 ){
+    switch (c){
+    case 'h':
+      usage( argv[0], EXIT_SUCCESS );
+      break;
+    case 'n':
+      nbDiploids = atoi(optarg);
+      if( nbDiploids <= 1 ){
+        cerr << "ERROR: requires at least 2 individuals (-n)" << endl;
+        usage( argv[0], EXIT_FAILURE );
+      }
+      break;
+    case 'g':
+      nbGen = atoi(optarg);
+      break;
+    case 'c':
+      nbSitesPerChr = atoi(optarg);
+      if( nbSitesPerChr <= 3 ){
+        cerr << "ERROR: requires at least 3 sites per chromosome (-c)" << endl;
+        usage( argv[0], EXIT_FAILURE );
+      }
+      break;
+    case 'i':
+      initNbTEsPerInd = atoi(optarg);
+      if( initNbTEsPerInd <= 0){
+        cerr << "ERROR: requires at least 1 TE (-i)" << endl;
+        usage( argv[0], EXIT_FAILURE );
+      }
+      break;
+    case 'd':
+      totalMapDist = atoi(optarg);
+      break;
+    case 'S':
+      zygoteSelection = true;
+      break;
+    case OPT_PRIOR:
+      {
+        int param;
+        Prior prior;
+        if( ! Abc::parsePrior( optarg, param, prior ) ){
+          cerr << "ERROR: can't parse the prior '" << optarg << "' (--prior)"
+               << endl;
+          usage( argv[0], EXIT_FAILURE );
+        }
+        abc.setPrior( param, prior );
+        vPriorArgs.push_back( optarg );
+      }
+      break;
+    case OPT_OBSERVED:
+      observedFile = optarg;
+      break;
+    case OPT_STATS:
+      statsArg = optarg;
+      break;
+    case OPT_MAX_COPIES:
+      maxCopies = atof(optarg);
+      break;
+    case 'N':
+      nbParticles = atoi(optarg);
+      if( nbParticles <= 1 ){
+        cerr << "ERROR: requires at least 2 particles (-N)" << endl;
+        usage( argv[0], EXIT_FAILURE );
+      }
+      break;
+    case 'P':
+      nbPriorDraws = atoi(optarg);
+      break;
+    case 'R':
+      nbRounds = atoi(optarg);
+      if( nbRounds <= 0 ){
+        cerr << "ERROR: requires at least 1 round (-R)" << endl;
+        usage( argv[0], EXIT_FAILURE );
+      }
+      break;
+    case 'q':
+      quantile = atof(optarg);
+      if( quantile <= 0 || quantile > 1 ){
+        cerr << "ERROR: quantile should be in ]0,1] (-q)" << endl;
+        usage( argv[0], EXIT_FAILURE );
+      }
+      break;
+    case 'j':
+      nbThreads = atoi(optarg);
+      if( nbThreads <= 0 ){
+        cerr << "ERROR: requires at least 1 thread (-j)" << endl;
+        usage( argv[0], EXIT_FAILURE );
+      }
+      break;
+    case 'r':
+      seed = atoi(optarg);
+      break;
+    case 'o':
+      outFile = optarg;
+      break;
+    case 'v':
+      verbose = atoi(optarg);
+      break;
+    default:
+      usage( argv[0], EXIT_FAILURE );
+    }
+  }
+  if( observedFile == "" ){
+    cerr << "ERROR: missing observed statistics (--observed)" << endl;
+    usage( argv[0], EXIT_FAILURE );
+  }
+  if( nbPriorDraws == 0 )
+    nbPriorDraws = 10 * nbParticles;
+  if( nbPriorDraws < nbParticles ){
+    cerr << "ERROR: requires at least as many simulations as particles (-P)"
+         << endl;
+    usage( argv[0], EXIT_FAILURE );
+  }
+
+  // the statistics to fit, among the observed ones
+  vector<string> vNames, vStats, vAvail = Population::getAvailableStats();
+  vector<double> vValues, vObserved;
+  readObserved( observedFile, vNames, vValues );
+  if( statsArg == "" ){
+    for( size_t i=0; i<vNames.size(); ++i )
+      if( find( vAvail.begin(), vAvail.end(), vNames[i] ) != vAvail.end() )
+        statsArg += ( statsArg == "" ? "" : "," ) + vNames[i];
+  }
+  stringstream ss( statsArg );
+  string stat;
+  while( getline( ss, stat, ',' ) ){
+    size_t col = find( vNames.begin(), vNames.end(), stat ) - vNames.begin();
+    if( find( vAvail.begin(), vAvail.end(), stat ) == vAvail.end()
+        || col == vNames.size() ){
+      cerr << "ERROR: statistic '" << stat << "' isn't observed or unknown"
+           << " (--stats)" << endl;
+      usage( argv[0], EXIT_FAILURE );
+    }
+    vStats.push_back( stat );
+    vObserved.push_back( vValues[col] );
+  }
+  if( vStats.empty() ){
+    cerr << "ERROR: requires at least 1 statistic (--stats)" << endl;
+    usage( argv[0], EXIT_FAILURE );
+  }
+
+  time_t startRawTime;
+  time( &startRawTime );
+  printf ( "START: %s", ctime(&startRawTime) );
+
+  const gsl_rng_type * T;
+  gsl_rng_env_setup();
+  T = gsl_rng_default;
+  gsl_rng * r = gsl_rng_alloc( T );
+  gsl_rng_set( r, seed );
+
+  abc.setNbDiploids( nbDiploids );
+  abc.setNbGenerations( nbGen );
+  abc.setNbSitesPerChromosome( nbSitesPerChr );
+  abc.setExpNbTEsPerIndividual( initNbTEsPerInd );
+  abc.setTotalMapDist( totalMapDist );
+  abc.setZygoteSelection( zygoteSelection );
+  abc.setObserved( vStats, vObserved );
+  abc.setMaxCopies( maxCopies );
+  abc.setNbParticles( nbParticles );
+  abc.setNbPriorDraws( nbPriorDraws );
+  abc.setNbRounds( nbRounds );
+  abc.setQuantile( quantile );
+  abc.setNbThreads( nbThreads );
+  abc.setVerbose( verbose );
+  abc.setRng( r );
+
+  ofstream outStream( outFile.c_str() );
+  outStream << "#nbDiploids=" << nbDiploids << endl;
+  outStream << "#nbGen=" << nbGen << endl;
+  outStream << "#nbSitesPerChr=" << nbSitesPerChr << endl;
+  outStream << "#initNbTEsPerInd=" << initNbTEsPerInd << endl;
+  outStream << "#totalMapDist=" << totalMapDist << endl;
+  outStream << "#zygoteSelection=" << boolalpha << zygoteSelection
+            << noboolalpha << endl;
+  for( size_t i=0; i<vPriorArgs.size(); ++i )
+    outStream << "#prior=" << vPriorArgs[i] << endl;
+  outStream << "#observed=" << observedFile << endl;
+  for( size_t i=0; i<vStats.size(); ++i )
+    outStream << "#" << vStats[i] << "=" << vObserved[i] << endl;
+  outStream << "#maxCopies=" << maxCopies << endl;
+  outStream << "#nbParticles=" << nbParticles << endl;
+  outStream << "#nbPriorDraws=" << nbPriorDraws << endl;
+  outStream << "#quantile=" << quantile << endl;
+  outStream << "#seed=" << seed << endl;
+  abc.run( outStream );
+  outStream.close();
+  gsl_rng_free( r );
+
+  time_t endRawTime;
+  time( &endRawTime );
+  printf( "END: %s", ctime(&endRawTime) );
+  return( EXIT_SUCCESS );
+}
@@ -0,0 +1,89 @@
+/*
+ * \file aggmerge.cpp
+ */
+
+// Purpose: merge the aggregation states of several runs of modelCC83.
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <getopt.h>
+using namespace std;
+
+#include "Aggregator.h"
+
+void usage( char *program_name, int status )
+{
+  cerr << "usage: " << program_name << " [options] <state files>\n";
+  cerr << "merge the aggregates saved by modelCC83 --aggregate-state, e.g. by" << endl;
+  cerr << "runs with different seeds" << endl;
+  cerr << "options:" << endl;
+  cerr << "     -h: this help" << endl;
+  cerr << "     -o: name of the TSV output file (default=stdout)" << endl;
+  cerr << "     -s: also save the merged aggregate into this state file" << endl;
+  exit( status );
+}
+
+int main( int argc, char* argv[] )
+{
+  string outFile = "", stateFile = "";
+
+  int c;
+  extern char *optarg;
+  extern int optind;
+  while( (c = getopt(argc,argv,"ho:s:")) != -1 ){
+    switch (c){
+    case 'h':
+      usage( argv[0], EXIT_SUCCESS );
+      break;
+    case 'o':
+      outFile = optarg;
+      break;
+    case 's':
+      stateFile = optarg;
+      break;
+    default:
+      usage( argv[0], EXIT_FAILURE );
+    }
+  }
+  if( optind >= argc ){
+    cerr << "ERROR: missing state files" << endl;
+    usage( argv[0], EXIT_FAILURE );
+  }
+
+  // the parameters written are those of the first run
+  Aggregator merged;
+  merged.load( argv[optind] );
+  for( int i=optind+1; i<argc; ++i ){
+    Aggregator aggregate;
+    aggregate.load( argv[i] );
+    if( ! merged.merge( aggregate ) ){
+      cerr << "ERROR: " << argv[i] << " doesn't have the statistics and"
+           << " quantiles of " << argv[optind] << endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+
+  ofstream outStream;
+  if( outFile != "" )
+    outStream.open( outFile.c_str() );
+  ostream & out = ( outFile != "" ) ? outStream : cout;
+  out << "#merged=" << argc - optind << endl;
+  merged.writeTable( out );
+  out.flush();
+  if( stateFile != "" )
+    merged.save( stateFile );
+  return( EXIT_SUCCESS );
+}
@@ -0,0 +1,121 @@
+/*
+ * \file bin2tsv.cpp
+ */
+
+// Purpose: convert a binary output of modelCC83 into the TSV format.
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <cstdlib>
+#include <getopt.h>
+using namespace std;
+
+#include "BinaryReader.h"
+
+void usage( char *program_name, int status )
+{
+  cerr << "usage: " << program_name << " [options]\n";
+  cerr << "options:" << endl;
+  cerr << "     -h: this help" << endl;
+  cerr << "     -i: name of the binary input file" << endl;
+  cerr << "     -o: name of the TSV output file (default=stdout)" << endl;
+  cerr << "     -p: nb of significant digits for real numbers (default=3)" << endl;
+  exit( status );
+}
+
+int main( int argc, char* argv[] )
+{
+  string inFile = "", outFile = "";
+  int precision = 3;
+
+  int c;
+  extern char *optarg;
+  while( (c = getopt(argc,argv,"hi:o:p:")) != -1 ){
+    switch (c){
+    case 'h':
+      usage( argv[0], EXIT_SUCCESS );
+      break;
+    case 'i':
+      inFile = optarg;
+      break;
+    case 'o':
+      outFile = optarg;
+      break;
+    case 'p':
+      precision = atoi(optarg);
+      break;
+    default:
+      usage( argv[0], EXIT_FAILURE );
+    }
+  }
+  if( inFile == "" ){
+    cerr << "ERROR: missing input file (-i)" << endl;
+    usage( argv[0], EXIT_FAILURE );
+  }
+
+  BinaryReader reader;
+  if( ! reader.open( inFile ) )
+    exit( EXIT_FAILURE );
+
+  ofstream outStream;
+  if( outFile != "" )
+    outStream.open( outFile.c_str() );
+  ostream & out = ( outFile != "" ) ? outStream : cout;
+
+  vector<string> vKeys = reader.getParameterKeys();
+  for( size_t i=0; i<vKeys.size(); ++i )
+    out << "#" << vKeys[i] << "=" << reader.getParameter( vKeys[i] ) << endl;
+  int nbCols = reader.getNbColumns();
+  for( int col=0; col<nbCols; ++col )
+    out << ( col == 0 ? "" : "\t" ) << reader.getColumnName( col );
+  out << endl;
+
+  // decode block by block to keep the memory footprint small
+  out << setprecision( precision );
+  for( int b=0; b<reader.getNbBlocks(); ++b ){
+    int nbRows = reader.getNbRowsInBlock( b );
+    vector<const int32_t *> vIntCols( nbCols );
+    vector<const double *> vDoubleCols( nbCols );
+    vector< vector<int32_t> > vDeltaCols( nbCols );
+    for( int col=0; col<nbCols; ++col ){
+      if( ! reader.isIntegerColumn( col ) )
+        vDoubleCols[col] = reader.getBlockColumnDouble( b, col );
+      else if( ! reader.isDeltaColumn( col ) )
+        vIntCols[col] = reader.getBlockColumnInt( b, col );
+      else{
+        const int32_t * p = reader.getBlockColumnInt( b, col );
+        vDeltaCols[col].assign( p, p + nbRows );
+        for( int i=1; i<nbRows; ++i )
+          vDeltaCols[col][i] += vDeltaCols[col][i-1];
+        vIntCols[col] = &vDeltaCols[col][0];
+      }
+    }
+    for( int i=0; i<nbRows; ++i ){
+      for( int col=0; col<nbCols; ++col ){
+        if( col > 0 )
+          out << "\t";
+        if( reader.isIntegerColumn( col ) )
+          out << vIntCols[col][i];
+        else
+          out << vDoubleCols[col][i];
+      }
+      out << "\n";
+    }
+  }
+  out << reader.getTrailer();
+  out.flush();
+  reader.close();
+  return( EXIT_SUCCESS );
+}
@@ -0,0 +1,206 @@
+/*
+ * \file cc83.cpp
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>  // for find
+#include "gsl/gsl_rng.h"
+using namespace std;
+
+#include "cc83.h"
+#include "Population.h"
+
+struct cc83_simulation
+{
+  gsl_rng * r;
+  Population pop;
+  Population::GenerationKernel kernel;
+  float probTransp0;
+  float k;
+  float probLoss;
+  int generation;
+  vector<string> vStats;
+  vector<double> vValues;
+};
+
+static string lastError;
+
+void cc83_default_params( cc83_params * params )
+{
+  params->nbDiploids = 10;
+  params->nbSitesPerChr = 31;
+  params->initNbTEsPerInd = 10;
+  params->probTransp0 = 0.01;
+  params->k = 0.05;
+  params->probLoss = 0.005;
+  params->totalMapDist = 90;
+  params->zygoteSelection = 0;
+  params->selMult = 0.001;
+  params->selExp = 1.5;
+  params->seed = 1859;
+  params->stats = NULL;
+}
+
+const char * cc83_error( void )
+{
+  return( lastError.c_str() );
+}
+
+// same checks as the command-line program, and those of
+// Population::initialize(), so that the library never exits the host
+static bool checkParams( const cc83_params * params, vector<string> & vStats )
+{
+  if( params->nbDiploids <= 1 )
+    lastError = "requires at least 2 individuals";
+  else if( params->nbSitesPerChr <= 3 )
+    lastError = "requires at least 3 sites per chromosome";
+  else if( params->initNbTEsPerInd <= 0 )
+    lastError = "requires at least 1 TE";
+  else if( params->initNbTEsPerInd > 4 * params->nbSitesPerChr )
+    lastError = "more initial TEs than sites";
+  else if( params->probTransp0 < 0 || params->probTransp0 > 1
+           || params->probLoss < 0 || params->probLoss > 1 )
+    lastError = "probability should be between 0 and 1";
+  else
+    lastError = "";
+  if( lastError != "" )
+    return( false );
+
+  vStats = Population::getDefaultStats();
+  if( params->stats != NULL ){
+    vector<string> vAvail = Population::getAvailableStats();
+    vStats.clear();
+    stringstream ss( params->stats );
+    string stat;
+    while( getline( ss, stat, ',' ) ){
+      if( find( vAvail.begin(), vAvail.end(), stat ) == vAvail.end() ){
+        lastError = "unknown statistic '" + stat + "'";
+        return( false );
+      }
+      if( find( vStats.begin(), vStats.end(), stat ) == vStats.end() )
+        vStats.push_back( stat );
+    }
+  }
+  return( true );
+}
+
+cc83_simulation * cc83_create( const cc83_params * params )
+{
+  vector<string> vStats;
+  if( ! checkParams( params, vStats ) )
+    return( NULL );
+  cc83_simulation * sim = new cc83_simulation;
+  sim->r = gsl_rng_alloc( gsl_rng_default );
+  gsl_rng_set( sim->r, params->seed );
+  sim->probTransp0 = params->probTransp0;
+  sim->k = params->k;
+  sim->probLoss = params->probLoss;
+  sim->generation = 0;
+  sim->vStats = vStats;
+  Population & pop = sim->pop;
+  pop.setNbDiploids( params->nbDiploids );
+  pop.setNbChrPerIndividual( 4 );
+  pop.setNbSitesPerChromosome( params->nbSitesPerChr );
+  pop.setExpNbTEsPerIndividual( params->initNbTEsPerInd );
+  pop.setTotalMapDist( params->totalMapDist );
+  pop.setZygoteSelection( params->zygoteSelection != 0 );
+  pop.setSelMultiplicator( params->selMult );
+  pop.setSelExponent( params->selExp );
+  pop.setVerbose( -1 );
+  pop.setRng( sim->r );
+  pop.setStats( vStats );
+  pop.setExitOnSaturation( false );
+  pop.initialize();
+  sim->kernel = pop.getGenerationKernel( sim->k );
+  return( sim );
+}
+
+void cc83_free( cc83_simulation * sim )
+{
+  if( sim == NULL )
+    return;
+  gsl_rng_free( sim->r );
+  delete sim;
+}
+
+// a saturated generation isn't counted, and the simulation stays stopped
+int cc83_step( cc83_simulation * sim, int nbGen )
+{
+  int g = 0;
+  for( ; g<nbGen && sim->pop.getSumNbTEs() > 0; ++g ){
+    if( ! sim->pop.isSaturated() )
+      (sim->pop.*(sim->kernel))( sim->probLoss, sim->probTransp0, sim->k );
+    if( sim->pop.isSaturated() ){
+      lastError = "too many TEs and no more empty sites";
+      return( -1 );
+    }
+    ++ sim->generation;
+  }
+  return( g );
+}
+
+int cc83_generation( const cc83_simulation * sim )
+{
+  return( sim->generation );
+}
+
+int cc83_nb_tes( const cc83_simulation * sim )
+{
+  return( const_cast<Population &>( sim->pop ).getSumNbTEs() );
+}
+
+int cc83_nb_stats( const cc83_simulation * sim )
+{
+  return( sim->vStats.size() );
+}
+
+const char * cc83_stat_name( const cc83_simulation * sim, int stat )
+{
+  if( stat < 0 || stat >= (int) sim->vStats.size() )
+    return( NULL );
+  return( sim->vStats[stat].c_str() );
+}
+
+void cc83_stats( cc83_simulation * sim, double * values )
+{
+  sim->pop.getStatsValues( sim->vValues );
+  copy( sim->vValues.begin(), sim->vValues.end(), values );
+}
+
+int cc83_nb_loci( const cc83_simulation * sim )
+{
+  return( const_cast<Population &>( sim->pop ).getNbLociPerIndividual() );
+}
+
+void cc83_freq_per_locus( cc83_simulation * sim, double * freqs )
+{
+  sim->pop.getFreqTEsPerLocus( freqs );
+}
+
+int cc83_nb_diploids( const cc83_simulation * sim )
+{
+  return( const_cast<Population &>( sim->pop ).getNbDiploids() );
+}
+
+void cc83_nb_tes_per_ind( cc83_simulation * sim, int * nbTEs )
+{
+  GenomeMatrix & genomes = sim->pop.getGenomes();
+  for( int i=0; i<genomes.getNbIndividuals(); ++i )
+    nbTEs[i] = genomes.getNbTEs( i );
+}
@@ -0,0 +1,84 @@
+/*
+ * \file cc83.h
+ */
+
+// Purpose: simulate transposable elements dynamics in genomes with the
+// model of Charlesworth & Charlesworth (1983).
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CC83_H
+#define CC83_H
+
+/* C interface of libTEs, to embed the simulator in other programs (e.g.
+ * R, see Rpackage/). A simulation is created from its parameters, stepped
+ * some generations at a time, and its statistics are written into arrays
+ * provided by the caller, so that they can be the caller's own vectors.
+ * Several simulations can exist at once, each with its own RNG. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CC83_API_VERSION 1
+
+typedef struct cc83_simulation cc83_simulation;
+
+typedef struct
+{
+  int nbDiploids;
+  int nbSitesPerChr;
+  int initNbTEsPerInd;
+  double probTransp0;
+  double k;
+  double probLoss;
+  int totalMapDist;
+  int zygoteSelection;
+  double selMult;
+  double selExp;
+  unsigned long seed;
+  const char * stats;  /* comma-separated, NULL for the default ones */
+} cc83_params;
+
+/* same defaults as the command-line program */
+void cc83_default_params( cc83_params * params );
+
+/* NULL if a parameter is invalid, see cc83_error() */
+cc83_simulation * cc83_create( const cc83_params * params );
+void cc83_free( cc83_simulation * sim );
+const char * cc83_error( void );
+
+/* returns the nb of generations done, fewer than asked if the TEs were
+ * lost, or -1 once an individual has no more empty sites for its
+ * transpositions (see cc83_error()) */
+int cc83_step( cc83_simulation * sim, int nbGen );
+int cc83_generation( const cc83_simulation * sim );
+int cc83_nb_tes( const cc83_simulation * sim );
+
+/* statistics of the current generation, as the output columns */
+int cc83_nb_stats( const cc83_simulation * sim );
+const char * cc83_stat_name( const cc83_simulation * sim, int stat );
+void cc83_stats( cc83_simulation * sim, double * values );
+
+/* frequency of TEs at each locus, cc83_nb_loci() values */
+int cc83_nb_loci( const cc83_simulation * sim );
+void cc83_freq_per_locus( cc83_simulation * sim, double * freqs );
+
+/* nb of TEs of each individual, cc83_nb_diploids() values */
+int cc83_nb_diploids( const cc83_simulation * sim );
+void cc83_nb_tes_per_ind( cc83_simulation * sim, int * nbTEs );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
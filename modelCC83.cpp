@@ -22,12 +22,33 @@
 #include <cstdlib>  // for EXIT_SUCCESS
 #include <cstdio>  // for EOF
 #include <sys/stat.h>  // for struct stat
+#include <unistd.h>  // for truncate
 #include <ctime>
 #include <getopt.h>
+#include <sstream>
+#include <vector>
+#include <algorithm>  // for find, min, max
 #include "gsl/gsl_rng.h"
+#include "gsl/gsl_randist.h"
 using namespace std;
 
 #include "Simulation.h"
+#include "Population.h"
+#include "BinaryWriter.h"
+#include "EventTrace.h"
+#include "Checkpoint.h"
+#include "GenomeMatrix.h"
+#include "Aggregator.h"
+#include "MemoryStats.h"
+#include "LockstepPopulations.h"
+
+enum { OPT_STATS = 256, OPT_FORMAT, OPT_DELTA, OPT_TREES, OPT_SIMPLIFY,
+       OPT_TRACE, OPT_CHECKPOINT, OPT_CHECKPOINT_EVERY, OPT_MAX_TIME,
+       OPT_RESUME, OPT_BURNIN, OPT_BURNIN_EQ, OPT_BURNIN_K, OPT_BURNIN_S,
+       OPT_AGGREGATE, OPT_AGGREGATE_QUANTILES, OPT_AGGREGATE_RAW,
+       OPT_AGGREGATE_STATE, OPT_LD, OPT_LD_EVERY, OPT_THREADS, OPT_LOCKSTEP,
+       OPT_MORAN, OPT_FAMILY, OPT_FECUNDITY, OPT_FAST_INIT,
+       OPT_PIPELINE_STATS };
 
 void usage( char *program_name, int status )
 {
@@ -51,9 +72,142 @@ void usage( char *program_name, int status )
   cerr << "     -r: seed of the pseudo-random generator (default=1859)" << endl;
   cerr << "     -o: name of the output file (default=data.csv)" << endl;
   cerr << "     -v: verbose (default=0/1/2)" << endl;
+  cerr << "     --stats: comma-separated list of output columns" << endl;
+  cerr << "         default:";
+  vector<string> vDefault = Population::getDefaultStats();
+  for( size_t i=0; i<vDefault.size(); ++i )
+    cerr << " " << vDefault[i];
+  cerr << endl;
+  cerr << "         also available:";
+  vector<string> vAvail = Population::getAvailableStats();
+  for( size_t i=vDefault.size(); i<vAvail.size(); ++i )
+    cerr << " " << vAvail[i];
+  cerr << endl;
+  cerr << "         (nHap: nb of distinct chromosomes, summed over the pairs;" << endl;
+  cerr << "          <loop>Try, <loop>Acc, <loop>Waste: attempts, acceptance ratio and" << endl;
+  cerr << "          random draws wasted by a rejection loop during the generation;" << endl;
+  cerr << "          nSeg, meanD, meanR2Linked, meanR2Unlinked: nb of segregating loci," << endl;
+  cerr << "          mean linkage disequilibrium D and mean r2 between them, on the" << endl;
+  cerr << "          same chromosome or not)" << endl;
+  cerr << "         with --family, f<i>.<stat> is a default statistic of TE family i," << endl;
+  cerr << "         the others being of all the families; by default, those of each" << endl;
+  cerr << "         family follow" << endl;
+  cerr << "     --format: format of the output file, tsv or bin (default=tsv)" << endl;
+  cerr << "     --delta: delta-encode the simu and gen columns (only with --format=bin)" << endl;
+  cerr << "     --trees: record the genealogy and write it as tskit tables" << endl;
+  cerr << "         into <prefix>_simu<id>.{nodes,edges,sites,mutations}.txt" << endl;
+  cerr << "     --trees-simplify: simplify the genealogy every x generations (default=100)" << endl;
+  cerr << "     --trace: write the crossing-overs, losses, insertions and rejected" << endl;
+  cerr << "         zygotes into this binary file, readable with trace2txt" << endl;
+  cerr << "     --checkpoint: save the whole state of the run into this file" << endl;
+  cerr << "     --checkpoint-every: ... every x generations (default=1000)" << endl;
+  cerr << "     --max-time: save the state and stop after x seconds (requires" << endl;
+  cerr << "         --checkpoint, or --resume whose file is then updated)" << endl;
+  cerr << "     --resume: continue the run saved in this file, with its parameters" << endl;
+  cerr << "         and output file, exactly as if it had not been stopped" << endl;
+  cerr << "     --burnin: run once x generations (written as simulation 0), then" << endl;
+  cerr << "         start all the simulations from the resulting population, each" << endl;
+  cerr << "         with its own random stream" << endl;
+  cerr << "     --burnin-eq: stop the burn-in earlier at equilibrium, judged on the" << endl;
+  cerr << "         mean nb of TEs over windows of x generations" << endl;
+  cerr << "     --burnin-k: parameter k during the burn-in (default=-k)" << endl;
+  cerr << "     --burnin-S: selection during the burn-in, 0 or 1 (default=-S or --fecundity)" << endl;
+  cerr << "     --aggregate: write into this file, for each generation, the fraction" << endl;
+  cerr << "         of simulations which lost their TEs and the mean, variance and" << endl;
+  cerr << "         quantiles of each statistic over the simulations; the output" << endl;
+  cerr << "         file then only has the rows of the simulations of --aggregate-raw" << endl;
+  cerr << "     --aggregate-quantiles: comma-separated probabilities (default=0.05,0.5,0.95)" << endl;
+  cerr << "     --aggregate-raw: still write the rows of x simulations chosen at" << endl;
+  cerr << "         random (default=0)" << endl;
+  cerr << "     --aggregate-state: also save the aggregate into this binary file," << endl;
+  cerr << "         to be merged with those of other runs by aggmerge" << endl;
+  cerr << "     --ld: write D and r2 of each pair of segregating loci and the mean r2" << endl;
+  cerr << "         by distance into <prefix>_pairs.tsv and <prefix>_decay.tsv" << endl;
+  cerr << "     --ld-every: ... every x generations (default=100)" << endl;
+  cerr << "     --threads: nb of threads of the linkage disequilibrium and of the" << endl;
+  cerr << "         fast initialization (default=1)" << endl;
+  cerr << "     --lockstep: advance x simulations together, in one pass per generation;" << endl;
+  cerr << "         each has its own random stream, with a seed drawn from -r (as" << endl;
+  cerr << "         after --burnin), and only the default statistics are available" << endl;
+  cerr << "     --moran: overlapping generations, each of -n steps replacing one" << endl;
+  cerr << "         individual by the offspring of two others (requires -n >= 3)" << endl;
+  cerr << "     --fecundity: selection on the fecundity of the parents, drawn in" << endl;
+  cerr << "         proportion to their fitness, instead of the viability of the" << endl;
+  cerr << "         zygotes (-S, same -m and -e)" << endl;
+  cerr << "     --fast-init: draw the initial TEs of each chromosome from their nb" << endl;
+  cerr << "         rather than site by site, in a time proportional to the nb of" << endl;
+  cerr << "         TEs (same distribution, other draws than by default)" << endl;
+  cerr << "     --pipeline-stats: compute and write the statistics of a generation" << endl;
+  cerr << "         on another thread, while the next generation is made (same" << endl;
+  cerr << "         output but for statsBytes, the memory of the chromosomes of" << endl;
+  cerr << "         one more generation)" << endl;
+  cerr << "     --family: add a TE family with its own -t, -k and -l, as t,k,l (the" << endl;
+  cerr << "         first family having -t, -k and -l); the families can't share a" << endl;
+  cerr << "         site, their regulation and selection depend on the total nb of" << endl;
+  cerr << "         TEs, and each starts with -i TEs per individual on average" << endl;
   exit( status );
 }
 
+void parseStats( char *program_name, string arg, vector<string> & vStats )
+{
+  vector<string> vAvail = Population::getAvailableStats();
+  vector<string> vDefault = Population::getDefaultStats();
+  vStats.clear();
+  stringstream ss( arg );
+  string stat;
+  while( getline( ss, stat, ',' ) ){
+    // the family of a statistic is checked once all the options are read
+    string name;
+    if( find( vAvail.begin(), vAvail.end(), stat ) == vAvail.end()
+        && ( Population::getStatFamily( stat, name ) == -1
+             || find( vDefault.begin(), vDefault.end(), name ) == vDefault.end() ) ){
+      cerr << "ERROR: unknown statistic '" << stat << "' (--stats)" << endl;
+      usage( program_name, EXIT_FAILURE );
+    }
+    if( find( vStats.begin(), vStats.end(), stat ) == vStats.end() )
+      vStats.push_back( stat );
+  }
+  if( vStats.empty() ){
+    cerr << "ERROR: requires at least 1 statistic (--stats)" << endl;
+    usage( program_name, EXIT_FAILURE );
+  }
+}
+
+void parseQuantiles( char *program_name, string arg, vector<double> & vQuantiles )
+{
+  vQuantiles.clear();
+  stringstream ss( arg );
+  string prob;
+  while( getline( ss, prob, ',' ) ){
+    vQuantiles.push_back( atof( prob.c_str() ) );
+    if( prob == "" || vQuantiles.back() < 0 || vQuantiles.back() > 1 ){
+      cerr << "ERROR: probability should be between 0 and 1 (--aggregate-quantiles)"
+           << endl;
+      usage( program_name, EXIT_FAILURE );
+    }
+  }
+}
+
+// parameters t,k,l of a TE family (--family)
+void parseFamily( char *program_name, string arg, vector<float> & vFamProbTransp0,
+                  vector<float> & vFamK, vector<float> & vFamProbLoss )
+{
+  vector<float> vParams;
+  stringstream ss( arg );
+  string param;
+  while( getline( ss, param, ',' ) )
+    vParams.push_back( atof( param.c_str() ) );
+  if( vParams.size() != 3 || vParams[0] < 0 || vParams[0] > 1
+      || vParams[2] < 0 || vParams[2] > 1 ){
+    cerr << "ERROR: requires t,k,l with probabilities between 0 and 1 (--family)"
+         << endl;
+    usage( program_name, EXIT_FAILURE );
+  }
+  vFamProbTransp0.push_back( vParams[0] );
+  vFamK.push_back( vParams[1] );
+  vFamProbLoss.push_back( vParams[2] );
+}
+
 void parse_args
 ( int argc, char **argv,
   int & nbSimu,
@@ -66,16 +220,76 @@ void parse_args
   float & probLoss,
   int & totalMapDist,
   bool & zygoteSelection,
+  bool & fecunditySelection,
   float & selMult,
   float & selExp,
   int & seed,
   string & outFile,
-  int & verbose
+  int & verbose,
+  vector<string> & vStats,
+  string & format,
+  bool & deltaEncoding,
+  string & treesPrefix,
+  int & simplifyInterval,
+  string & traceFile,
+  string & checkpointFile,
+  int & checkpointInterval,
+  int & maxTime,
+  string & resumeFile,
+  int & burnInGens,
+  int & burnInWindow,
+  float & burnInK,
+  int & burnInSelection,
+  string & aggregateFile,
+  vector<double> & vQuantiles,
+  int & nbRawSimus,
+  string & aggregateStateFile,
+  string & ldPrefix,
+  int & ldInterval,
+  int & nbThreads,
+  int & nbLanes,
+  bool & moran,
+  bool & fastInit,
+  bool & pipelinedStats,
+  vector<float> & vFamProbTransp0,
+  vector<float> & vFamK,
+  vector<float> & vFamProbLoss
   )
 {
-  char c;
+  int c;
   extern char *optarg;
-  while( (c = getopt(argc,argv,"hs:n:g:c:i:t:k:l:d:Sm:e:r:o:v:")) != -1 ){
+  static struct option longOptions[] = {
+    { "stats", required_argument, 0, OPT_STATS },
+    { "format", required_argument, 0, OPT_FORMAT },
+    { "delta", no_argument, 0, OPT_DELTA },
+    { "trees", required_argument, 0, OPT_TREES },
+    { "trees-simplify", required_argument, 0, OPT_SIMPLIFY },
+    { "trace", required_argument, 0, OPT_TRACE },
+    { "checkpoint", required_argument, 0, OPT_CHECKPOINT },
+    { "checkpoint-every", required_argument, 0, OPT_CHECKPOINT_EVERY },
+    { "max-time", required_argument, 0, OPT_MAX_TIME },
+    { "resume", required_argument, 0, OPT_RESUME },
+    { "burnin", required_argument, 0, OPT_BURNIN },
+    { "burnin-eq", required_argument, 0, OPT_BURNIN_EQ },
+    { "burnin-k", required_argument, 0, OPT_BURNIN_K },
+    { "burnin-S", required_argument, 0, OPT_BURNIN_S },
+    { "aggregate", required_argument, 0, OPT_AGGREGATE },
+    { "aggregate-quantiles", required_argument, 0, OPT_AGGREGATE_QUANTILES },
+    { "aggregate-raw", required_argument, 0, OPT_AGGREGATE_RAW },
+    { "aggregate-state", required_argument, 0, OPT_AGGREGATE_STATE },
+    { "ld", required_argument, 0, OPT_LD },
+    { "ld-every", required_argument, 0, OPT_LD_EVERY },
+    { "threads", required_argument, 0, OPT_THREADS },
+    { "lockstep", required_argument, 0, OPT_LOCKSTEP },
+    { "moran", no_argument, 0, OPT_MORAN },
+    { "family", required_argument, 0, OPT_FAMILY },
+    { "fecundity", no_argument, 0, OPT_FECUNDITY },
+    { "fast-init", no_argument, 0, OPT_FAST_INIT },
+    { "pipeline-stats", no_argument, 0, OPT_PIPELINE_STATS },
+    { 0, 0, 0, 0 }
+  };
+  while( (c = getopt_long(argc,argv,"hs:n:g:c:i:t:k:l:d:Sm:e:r:o:v:",
+                          longOptions,NULL)) != -1 ){
     switch (c){
     case 'h':
       usage( argv[0], EXIT_SUCCESS );
@@ -149,6 +363,131 @@ void parse_args
     case 'v':
       verbose = atoi(optarg);
       break;
+    case OPT_STATS:
+      parseStats( argv[0], optarg, vStats );
+      break;
+    case OPT_FORMAT:
+      format = optarg;
+      if( format != "tsv" && format != "bin" ){
+        cerr << "ERROR: format should be tsv or bin (--format)" << endl;
+        usage( argv[0], EXIT_FAILURE );
+      }
+      break;
+    case OPT_DELTA:
+      deltaEncoding = true;
+      break;
+    case OPT_TREES:
+      treesPrefix = optarg;
+      break;
+    case OPT_SIMPLIFY:
+      simplifyInterval = atoi(optarg);
+      if( simplifyInterval <= 0 ){
+        cerr << "ERROR: requires at least 1 generation (--trees-simplify)" << endl;
+        usage( argv[0], EXIT_FAILURE );
+      }
+      break;
+    case OPT_TRACE:
+      traceFile = optarg;
+      break;
+    case OPT_CHECKPOINT:
+      checkpointFile = optarg;
+      break;
+    case OPT_CHECKPOINT_EVERY:
+      checkpointInterval = atoi(optarg);
+      if( checkpointInterval <= 0 ){
+        cerr << "ERROR: requires at least 1 generation (--checkpoint-every)" << endl;
+        usage( argv[0], EXIT_FAILURE );
+      }
+      break;
+    case OPT_MAX_TIME:
+      maxTime = atoi(optarg);
+      if( maxTime <= 0 ){
+        cerr << "ERROR: requires at least 1 second (--max-time)" << endl;
+        usage( argv[0], EXIT_FAILURE );
+      }
+      break;
+    case OPT_RESUME:
+      resumeFile = optarg;
+      break;
+    case OPT_BURNIN:
+      burnInGens = atoi(optarg);
+      if( burnInGens <= 0 ){
+        cerr << "ERROR: requires at least 1 generation (--burnin)" << endl;
+        usage( argv[0], EXIT_FAILURE );
+      }
+      break;
+    case OPT_BURNIN_EQ:
+      burnInWindow = atoi(optarg);
+      if( burnInWindow <= 0 ){
+        cerr << "ERROR: requires at least 1 generation (--burnin-eq)" << endl;
+        usage( argv[0], EXIT_FAILURE );
+      }
+      break;
+    case OPT_BURNIN_K:
+      burnInK = atof(optarg);
+      break;
+    case OPT_BURNIN_S:
+      burnInSelection = atoi(optarg);
+      if( burnInSelection != 0 && burnInSelection != 1 ){
+        cerr << "ERROR: should be 0 or 1 (--burnin-S)" << endl;
+        usage( argv[0], EXIT_FAILURE );
+      }
+      break;
+    case OPT_AGGREGATE:
+      aggregateFile = optarg;
+      break;
+    case OPT_AGGREGATE_QUANTILES:
+      parseQuantiles( argv[0], optarg, vQuantiles );
+      break;
+    case OPT_AGGREGATE_RAW:
+      nbRawSimus = atoi(optarg);
+      if( nbRawSimus < 0 ){
+        cerr << "ERROR: requires at least 0 simulation (--aggregate-raw)" << endl;
+        usage( argv[0], EXIT_FAILURE );
+      }
+      break;
+    case OPT_AGGREGATE_STATE:
+      aggregateStateFile = optarg;
+      break;
+    case OPT_LD:
+      ldPrefix = optarg;
+      break;
+    case OPT_LD_EVERY:
+      ldInterval = atoi(optarg);
+      if( ldInterval <= 0 ){
+        cerr << "ERROR: requires at least 1 generation (--ld-every)" << endl;
+        usage( argv[0], EXIT_FAILURE );
+      }
+      break;
+    case OPT_THREADS:
+      nbThreads = atoi(optarg);
+      if( nbThreads <= 0 ){
+        cerr << "ERROR: requires at least 1 thread (--threads)" << endl;
+        usage( argv[0], EXIT_FAILURE );
+      }
+      break;
+    case OPT_LOCKSTEP:
+      nbLanes = atoi(optarg);
+      if( nbLanes <= 0 ){
+        cerr << "ERROR: requires at least 1 simulation (--lockstep)" << endl;
+        usage( argv[0], EXIT_FAILURE );
+      }
+      break;
+    case OPT_MORAN:
+      moran = true;
+      break;
+    case OPT_FAMILY:
+      parseFamily( argv[0], optarg, vFamProbTransp0, vFamK, vFamProbLoss );
+      break;
+    case OPT_FECUNDITY:
+      fecunditySelection = true;
+      break;
+    case OPT_FAST_INIT:
+      fastInit = true;
+      break;
+    case OPT_PIPELINE_STATS:
+      pipelinedStats = true;
+      break;
     case '?':
       usage( argv[0], EXIT_FAILURE );
     default:
@@ -168,9 +507,11 @@ void getParameters( ostream & out,
                        float probLoss,
                        int totalMapDist,
                        bool zygoteSelection,
+                       bool fecunditySelection,
                        float selMult,
                        float selExp,
                        int seed,
+                       vector<string> vStats,
                        string outFile )
 {
   out << "#nbSimu=" << nbSimu << endl;
@@ -183,25 +524,50 @@ void getParameters( ostream & out,
   out << "#probLoss=" << probLoss << endl;
   out << "#totalMapDist=" << totalMapDist << endl;
   out << "#zygoteSelection=" << boolalpha << zygoteSelection << noboolalpha << endl;
+  out << "#fecunditySelection=" << boolalpha << fecunditySelection << noboolalpha
+      << endl;
   out << "#selMult=" << selMult << endl;
   out << "#selExp=" << selExp << endl;
   out << "#seed=" << seed << endl;
+  out << "#stats=";
+  for( size_t i=0; i<vStats.size(); ++i )
+    out << (i == 0 ? "" : ",") << vStats[i];
+  out << endl;
   if( outFile != "" )
     out << "#output=" << outFile << endl;
 }
 
-void writeHeaderLine( ofstream & outStream )
+// of the TE families after the first one, from 2 on
+void getFamilyParameters( ostream & out,
+                          const vector<float> & vFamProbTransp0,
+                          const vector<float> & vFamK,
+                          const vector<float> & vFamProbLoss )
+{
+  for( size_t fam=0; fam<vFamProbTransp0.size(); ++fam )
+    out << "#family" << fam + 2 << "=" << vFamProbTransp0[fam] << ","
+        << vFamK[fam] << "," << vFamProbLoss[fam] << endl;
+}
+
+void getBurnInParameters( ostream & out,
+                          int burnInGens,
+                          int burnInWindow,
+                          float burnInK,
+                          bool burnInSelection )
+{
+  out << "#burnin=" << burnInGens << endl;
+  out << "#burninEq=" << burnInWindow << endl;
+  out << "#burninK=" << burnInK << endl;
+  out << "#burninZygoteSelection=" << boolalpha << burnInSelection
+      << noboolalpha << endl;
+}
+
+void writeHeaderLine( ofstream & outStream, vector<string> vStats )
 {
   string sep = "\t";
-  outStream << "simu" << sep << "gen"
-            << sep << "nC" << sep << "meanC"
-            << sep << "varC" << sep << "sdC"
-            << sep << "minC" << sep << "q25C"
-            << sep << "medC" << sep << "q75C"
-            << sep << "maxC"
-            << sep << "empty" << sep << "meanL"
-            << sep << "varL" << sep << "sdL"
-            << endl;
+  outStream << "simu" << sep << "gen";
+  for( size_t i=0; i<vStats.size(); ++i )
+    outStream << sep << vStats[i];
+  outStream << endl;
 }
 
 void getElapsedTime( ostream & out,
@@ -220,6 +586,73 @@ void getElapsedTime( ostream & out,
       << endl;
 }
 
+// peak memory of the process, heap allocations of each phase of the
+// generations and largest nb of bytes per individual of each part of the
+// populations, to size other runs
+void getMemoryReport( ostream & out,
+                      const vector<size_t> & vMaxNbBytes,
+                      int nbDiploids )
+{
+  out << "#peakRss: " << MemoryStats::getPeakRss() << " kB" << endl;
+  for( int phase=0; phase<NB_PHASES; ++phase ){
+    AllocCounts counts = MemoryStats::getAllocCounts( phase );
+    out << "#allocations " << MemoryStats::getPhaseName( phase ) << ": "
+        << counts.nbAllocs << " (" << counts.nbBytes << " bytes)" << endl;
+  }
+  for( int part=0; part<NB_MEM_PARTS; ++part )
+    out << "#bytes per individual " << Population::getMemoryPartName( part )
+        << ": " << vMaxNbBytes[ part ] / (double) max( nbDiploids, 1 ) << endl;
+}
+
+// the parameters of a resumed run are those of its checkpoint
+void getResumedParameters( Checkpoint & ckpt,
+                           int & nbSimu,
+                           int & nbDiploids,
+                           int & nbGen,
+                           int & nbSitesPerChr,
+                           int & initNbTEsPerInd,
+                           float & probTransp0,
+                           float & k,
+                           float & probLoss,
+                           int & totalMapDist,
+                           bool & zygoteSelection,
+                           bool & fecunditySelection,
+                           float & selMult,
+                           float & selExp,
+                           int & seed,
+                           vector<string> & vStats,
+                           string & outFile,
+                           string & format,
+                           bool & deltaEncoding,
+                           bool & fastInit )
+{
+  nbSimu = atoi( ckpt.getParameter( "nbSimu" ).c_str() );
+  nbDiploids = atoi( ckpt.getParameter( "nbDiploids" ).c_str() );
+  nbGen = atoi( ckpt.getParameter( "nbGen" ).c_str() );
+  nbSitesPerChr = atoi( ckpt.getParameter( "nbSitesPerChr" ).c_str() );
+  initNbTEsPerInd = atoi( ckpt.getParameter( "initNbTEsPerInd" ).c_str() );
+  probTransp0 = atof( ckpt.getParameter( "probTransp0" ).c_str() );
+  k = atof( ckpt.getParameter( "k" ).c_str() );
+  probLoss = atof( ckpt.getParameter( "probLoss" ).c_str() );
+  totalMapDist = atoi( ckpt.getParameter( "totalMapDist" ).c_str() );
+  zygoteSelection = ( ckpt.getParameter( "zygoteSelection" ) == "true" );
+  if( ckpt.hasParameter( "fecunditySelection" ) )
+    fecunditySelection = ( ckpt.getParameter( "fecunditySelection" ) == "true" );
+  selMult = atof( ckpt.getParameter( "selMult" ).c_str() );
+  selExp = atof( ckpt.getParameter( "selExp" ).c_str() );
+  seed = atoi( ckpt.getParameter( "seed" ).c_str() );
+  vStats.clear();
+  stringstream ss( ckpt.getParameter( "stats" ) );
+  string stat;
+  while( getline( ss, stat, ',' ) )
+    vStats.push_back( stat );
+  outFile = ckpt.getParameter( "output" );
+  format = ckpt.getParameter( "format" );
+  deltaEncoding = ( ckpt.getParameter( "delta" ) == "true" );
+  if( ckpt.hasParameter( "fastInit" ) )
+    fastInit = ( ckpt.getParameter( "fastInit" ) == "true" );
+}
+
 int main( int argc, char* argv[] )
 {
   int nbSimu = 1;
@@ -233,11 +666,41 @@ int main( int argc, char* argv[] )
   int totalMapDist = 90;
   float k = 0.05;
   bool zygoteSelection = false;
+  bool fecunditySelection = false;
   float selMult = 0.001;
   float selExp = 1.5;
   int seed = 1859;
   string outFile = "data.csv";
   int verbose = 0;
+  vector<string> vStats = Population::getDefaultStats();
+  string format = "tsv";
+  bool deltaEncoding = false;
+  string treesPrefix = "";
+  int simplifyInterval = 100;
+  string traceFile = "";
+  string checkpointFile = "";
+  int checkpointInterval = 1000;
+  int maxTime = 0;
+  string resumeFile = "";
+  int burnInGens = 0;
+  int burnInWindow = 0;
+  float burnInK = -1;  // same as k
+  int burnInSelection = -1;  // same as the selection
+  string aggregateFile = "";
+  vector<double> vQuantiles;
+  vQuantiles.push_back( 0.05 );
+  vQuantiles.push_back( 0.5 );
+  vQuantiles.push_back( 0.95 );
+  int nbRawSimus = 0;
+  string aggregateStateFile = "";
+  string ldPrefix = "";
+  int ldInterval = 100;
+  int nbThreads = 1;
+  int nbLanes = 1;
+  bool moran = false;
+  bool fastInit = false;
+  bool pipelinedStats = false;
+  vector<float> vFamProbTransp0, vFamK, vFamProbLoss;
   gsl_rng * r;
 
   parse_args( argc, argv,
@@ -251,17 +714,160 @@ int main( int argc, char* argv[] )
               probLoss,
               totalMapDist,
               zygoteSelection,
+              fecunditySelection,
               selMult,
               selExp,
               seed,
               outFile,
-              verbose );
+              verbose,
+              vStats,
+              format,
+              deltaEncoding,
+              treesPrefix,
+              simplifyInterval,
+              traceFile,
+              checkpointFile,
+              checkpointInterval,
+              maxTime,
+              resumeFile,
+              burnInGens,
+              burnInWindow,
+              burnInK,
+              burnInSelection,
+              aggregateFile,
+              vQuantiles,
+              nbRawSimus,
+              aggregateStateFile,
+              ldPrefix,
+              ldInterval,
+              nbThreads,
+              nbLanes,
+              moran,
+              fastInit,
+              pipelinedStats,
+              vFamProbTransp0,
+              vFamK,
+              vFamProbLoss );
+  if( burnInK < 0 )
+    burnInK = k;
+  if( burnInSelection == -1 )
+    burnInSelection = zygoteSelection || fecunditySelection;
+
+  Checkpoint ckpt;
+  int firstSimuId = 1;
+  if( resumeFile != "" ){
+    ckpt.loadHeader( resumeFile );
+    getResumedParameters( ckpt,
+                          nbSimu,
+                          nbDiploids,
+                          nbGen,
+                          nbSitesPerChr,
+                          initNbTEsPerInd,
+                          probTransp0,
+                          k,
+                          probLoss,
+                          totalMapDist,
+                          zygoteSelection,
+                          fecunditySelection,
+                          selMult,
+                          selExp,
+                          seed,
+                          vStats,
+                          outFile,
+                          format,
+                          deltaEncoding,
+                          fastInit );
+    firstSimuId = ckpt.getSimulationIdentifier();
+    if( checkpointFile == "" )
+      checkpointFile = resumeFile;
+  }
+  if( maxTime > 0 && checkpointFile == "" ){
+    cerr << "ERROR: requires a checkpoint file (--max-time)" << endl;
+    usage( argv[0], EXIT_FAILURE );
+  }
+  if( burnInGens > 0 && ( checkpointFile != "" || resumeFile != "" ) ){
+    cerr << "ERROR: the burn-in (--burnin) isn't saved in checkpoints" << endl;
+    usage( argv[0], EXIT_FAILURE );
+  }
+  if( aggregateFile == "" && aggregateStateFile != "" ){
+    cerr << "ERROR: requires an aggregate file (--aggregate-state)" << endl;
+    usage( argv[0], EXIT_FAILURE );
+  }
+  if( aggregateFile != "" && ( checkpointFile != "" || resumeFile != "" ) ){
+    cerr << "ERROR: the aggregate (--aggregate) isn't saved in checkpoints" << endl;
+    usage( argv[0], EXIT_FAILURE );
+  }
+  if( treesPrefix != "" && checkpointFile != "" ){
+    cerr << "ERROR: the genealogy (--trees) isn't saved in checkpoints" << endl;
+    usage( argv[0], EXIT_FAILURE );
+  }
+  if( ldPrefix != "" && checkpointFile != "" ){
+    cerr << "ERROR: the linkage disequilibrium (--ld) isn't saved in checkpoints" << endl;
+    usage( argv[0], EXIT_FAILURE );
+  }
+  int nbFamilies = 1 + vFamProbTransp0.size();
+  if( nbFamilies > 1 ){
+    if( checkpointFile != "" || resumeFile != "" || treesPrefix != ""
+        || ldPrefix != "" || nbLanes > 1 || moran ){
+      cerr << "ERROR: several TE families (--family) have no checkpoints, genealogy," << endl
+           << "       linkage disequilibrium, simulations in lockstep nor Moran process" << endl;
+      usage( argv[0], EXIT_FAILURE );
+    }
+    if( vStats == Population::getDefaultStats() ){
+      vector<string> vFamStats = Population::getFamilyStats( nbFamilies );
+      vStats.insert( vStats.end(), vFamStats.begin(), vFamStats.end() );
+    }
+  }
+  for( size_t i=0; i<vStats.size(); ++i ){
+    string name;
+    if( Population::getStatFamily( vStats[i], name ) >= nbFamilies ){
+      cerr << "ERROR: statistic '" << vStats[i] << "' of a missing TE family (--stats)" << endl;
+      usage( argv[0], EXIT_FAILURE );
+    }
+  }
+  if( zygoteSelection && fecunditySelection ){
+    cerr << "ERROR: the selection is either on the zygotes (-S) or on the fecundity" << endl
+         << "       (--fecundity)" << endl;
+    usage( argv[0], EXIT_FAILURE );
+  }
+  if( fecunditySelection && ( moran || nbLanes > 1 ) ){
+    cerr << "ERROR: the fecundity selection (--fecundity) requires discrete generations" << endl
+         << "       and isn't available with --lockstep" << endl;
+    usage( argv[0], EXIT_FAILURE );
+  }
+  if( moran ){
+    if( nbDiploids < 3 ){
+      cerr << "ERROR: requires at least 3 individuals (--moran)" << endl;
+      usage( argv[0], EXIT_FAILURE );
+    }
+    if( checkpointFile != "" || resumeFile != "" || treesPrefix != ""
+        || nbLanes > 1 ){
+      cerr << "ERROR: the Moran process (--moran) has no checkpoints, genealogy" << endl
+           << "       nor simulations in lockstep" << endl;
+      usage( argv[0], EXIT_FAILURE );
+    }
+  }
+  if( nbLanes > 1 ){
+    if( checkpointFile != "" || treesPrefix != "" || traceFile != ""
+        || ldPrefix != "" || fastInit || pipelinedStats ){
+      cerr << "ERROR: the simulations in lockstep (--lockstep) have no checkpoints," << endl
+           << "       genealogy, trace, linkage disequilibrium, fast initialization" << endl
+           << "       nor pipelined statistics" << endl;
+      usage( argv[0], EXIT_FAILURE );
+    }
+    for( size_t i=0; i<vStats.size(); ++i )
+      if( ! LockstepPopulations::isAvailableStat( vStats[i] ) ){
+        cerr << "ERROR: statistic '" << vStats[i] << "' isn't available with --lockstep" << endl;
+        usage( argv[0], EXIT_FAILURE );
+      }
+  }
 
   time_t startRawTime;
   time( &startRawTime );
   printf ( "START: %s", ctime(&startRawTime) );
+  MemoryStats::startCounting();
 
-  if( verbose > 0 )
+  if( verbose > 0 ){
     getParameters( cout,
                    nbSimu,
                    nbDiploids,
@@ -273,21 +879,30 @@ int main( int argc, char* argv[] )
                    probLoss,
                    totalMapDist,
                    zygoteSelection,
+                   fecunditySelection,
                    selMult,
                    selExp,
                    seed,
+                   vStats,
                    outFile );
+    if( burnInGens > 0 )
+      getBurnInParameters( cout, burnInGens, burnInWindow, burnInK,
+                           burnInSelection );
+    if( moran )
+      cout << "#moran=true" << endl;
+    if( fastInit )
+      cout << "#fastInit=true" << endl;
+    getFamilyParameters( cout, vFamProbTransp0, vFamK, vFamProbLoss );
+  }
 
   // initialize outFile
   struct stat stFileInfo;
   int intStat;
   intStat = stat( outFile.c_str(), &stFileInfo );
-  if( intStat == 0 )
+  if( intStat == 0 && resumeFile == "" )
     remove( outFile.c_str() );
-  ofstream outStream;
-  outStream.open( outFile.c_str(),
-                  fstream::in | fstream::out | fstream::app );
-  getParameters( outStream,
+  stringstream ssParams;
+  getParameters( ssParams,
                  nbSimu,
                  nbDiploids,
                  nbGen,
@@ -298,11 +913,96 @@ int main( int argc, char* argv[] )
                  probLoss,
                  totalMapDist,
                  zygoteSelection,
+                 fecunditySelection,
                  selMult,
                  selExp,
                  seed,
+                 vStats,
                  "" );
-  writeHeaderLine( outStream );
+  if( burnInGens > 0 )
+    getBurnInParameters( ssParams, burnInGens, burnInWindow, burnInK,
+                         burnInSelection );
+  if( moran )
+    ssParams << "#moran=true" << endl;
+  if( fastInit )
+    ssParams << "#fastInit=true" << endl;
+  getFamilyParameters( ssParams, vFamProbTransp0, vFamK, vFamProbLoss );
+  ofstream outStream;
+  BinaryWriter binOut;
+  if( format == "bin" ){
+    // same "key=value" parameters as in the TSV, without the leading "#"
+    string headerText, line;
+    while( getline( ssParams, line ) )
+      headerText += line.substr( 1 ) + "\n";
+    vector<bool> vIsInt;
+    for( size_t i=0; i<vStats.size(); ++i )
+      vIsInt.push_back( Population::isIntegerStat( vStats[i] ) );
+    binOut.setDeltaEncoding( deltaEncoding );
+    binOut.setHeaderText( headerText );
+    binOut.setColumns( vStats, vIsInt );
+    if( resumeFile != "" )
+      binOut.reopen( outFile, ckpt.getOutFileSize() );
+    else
+      binOut.open( outFile );
+  }
+  else if( resumeFile != "" ){
+    if( truncate( outFile.c_str(), ckpt.getOutFileSize() ) != 0 ){
+      cerr << "ERROR: can't reopen file " << outFile << endl;
+      exit( EXIT_FAILURE );
+    }
+    outStream.open( outFile.c_str(),
+                    fstream::in | fstream::out | fstream::app );
+  }
+  else{
+    outStream.open( outFile.c_str(),
+                    fstream::in | fstream::out | fstream::app );
+    outStream << ssParams.str();
+    writeHeaderLine( outStream, vStats );
+  }
+  if( ldPrefix != "" ){
+    ofstream pairsStream( ( ldPrefix + "_pairs.tsv" ).c_str() );
+    pairsStream << "simu\tgen\tlocus1\tlocus2\tdist\tD\tr2" << endl;
+    pairsStream.close();
+    ofstream decayStream( ( ldPrefix + "_decay.tsv" ).c_str() );
+    decayStream << "simu\tgen\tdist\tnbPairs\tmeanR2" << endl;
+    decayStream.close();
+  }
+  LinkageDisequilibrium ld;
+  ld.setNbThreads( nbThreads );
+
+  // all the parameters of the run, at full precision, for the checkpoints
+  string ckptText;
+  if( checkpointFile != "" ){
+    stringstream ssCkpt, ssLines;
+    ssCkpt << setprecision( 9 );
+    getParameters( ssCkpt,
+                   nbSimu,
+                   nbDiploids,
+                   nbGen,
+                   nbSitesPerChr,
+                   initNbTEsPerInd,
+                   probTransp0,
+                   k,
+                   probLoss,
+                   totalMapDist,
+                   zygoteSelection,
+                   fecunditySelection,
+                   selMult,
+                   selExp,
+                   seed,
+                   vStats,
+                   outFile );
+    ssCkpt << "#format=" << format << endl;
+    ssCkpt << "#delta=" << boolalpha << deltaEncoding << noboolalpha << endl;
+    ssCkpt << "#fastInit=" << boolalpha << fastInit << noboolalpha << endl;
+    string line;
+    while( getline( ssCkpt, line ) )
+      ckptText += line.substr( 1 ) + "\n";
+  }
+
+  EventTrace trace;
+  if( traceFile != "" )
+    trace.open( traceFile, 16 );
 
   // initialize the pseudo-random number generator
   const gsl_rng_type * T;
@@ -311,8 +1011,81 @@ int main( int argc, char* argv[] )
   r = gsl_rng_alloc( T );
   gsl_rng_set( r, seed );
 
-  // run the simulations
-  for( int simuId=1; simuId<=nbSimu; ++simuId ){
+  // with an aggregate, the simulations whose rows are still written are
+  // drawn from their own stream, so that the simulations don't change
+  Aggregator aggregator;
+  vector<bool> vIsRaw( nbSimu + 1, true );
+  if( aggregateFile != "" ){
+    aggregator.setHeaderText( ssParams.str() );
+    aggregator.setStats( vStats );
+    aggregator.setQuantiles( vQuantiles );
+    vector<int> vIds, vRawIds( min( nbRawSimus, nbSimu ) );
+    for( int simuId=1; simuId<=nbSimu; ++simuId )
+      vIds.push_back( simuId );
+    gsl_rng * rRaw = gsl_rng_alloc( T );
+    gsl_rng_set( rRaw, seed );
+    if( ! vRawIds.empty() )
+      gsl_ran_choose( rRaw, &vRawIds[0], vRawIds.size(), &vIds[0], nbSimu,
+                      sizeof(int) );
+    gsl_rng_free( rRaw );
+    vIsRaw.assign( nbSimu + 1, false );
+    for( size_t i=0; i<vRawIds.size(); ++i )
+      vIsRaw[ vRawIds[i] ] = true;
+  }
+
+  // run the simulations, after the burn-in if any (simulation 0), whose
+  // final genomes are the initial ones of each simulation
+  GenomeMatrix burnInGenomes;
+  vector<unsigned long> vSeeds;
+  vector<size_t> vMaxNbBytes( NB_MEM_PARTS, 0 );
+  bool interrupted = false;
+  if( burnInGens > 0 )
+    firstSimuId = 0;
+  for( int simuId=firstSimuId; simuId<=nbSimu && ! interrupted; ++simuId ){
+    if( nbLanes > 1 && simuId > 0 ){
+      // the next simulations in lockstep, each with its own stream, then
+      // their rows in the order of the simulations
+      if( vSeeds.empty() )
+        for( int s=0; s<nbSimu; ++s )
+          vSeeds.push_back( gsl_rng_get( r ) );
+      int nbReps = min( nbLanes, nbSimu - simuId + 1 );
+      vector<gsl_rng *> vRngs;
+      for( int rep=0; rep<nbReps; ++rep ){
+        vRngs.push_back( gsl_rng_alloc( T ) );
+        gsl_rng_set( vRngs[rep], vSeeds[ simuId + rep - 1 ] );
+      }
+      LockstepPopulations lanes;
+      lanes.setNbDiploids( nbDiploids );
+      lanes.setNbChrPerIndividual( nbChrPerInd );
+      lanes.setNbSitesPerChromosome( nbSitesPerChr );
+      lanes.setExpNbTEsPerIndividual( initNbTEsPerInd );
+      lanes.setTotalMapDist( totalMapDist );
+      lanes.setZygoteSelection( zygoteSelection );
+      lanes.setSelMultiplicator( selMult );
+      lanes.setSelExponent( selExp );
+      lanes.setVerbose( verbose );
+      lanes.setRngs( vRngs );
+      lanes.setStats( vStats );
+      if( burnInGens > 0 )
+        lanes.setGenomes( burnInGenomes );
+      else
+        lanes.initialize();
+      if( verbose > 0 )
+        cout << "lockstep: simulations " << simuId << " to "
+             << simuId + nbReps - 1 << endl;
+      lanes.run( nbGen, probLoss, probTransp0, k );
+      for( int rep=0; rep<nbReps; ++rep ){
+        lanes.writeRows( rep, simuId + rep, outFile,
+                         format == "bin" ? &binOut : NULL,
+                         aggregateFile != "" ? &aggregator : NULL,
+                         vIsRaw[ simuId + rep ] );
+        gsl_rng_free( vRngs[rep] );
+      }
+      for( int part=0; part<NB_MEM_PARTS; ++part )
+        vMaxNbBytes[ part ] = max( vMaxNbBytes[ part ], lanes.getNbBytes( part ) );
+      simuId += nbReps - 1;
+      continue;
+    }
     Simulation iSimu;
     iSimu.setSimulationIdentifier( simuId );
     iSimu.setNbGenerations( nbGen );
@@ -325,22 +1098,106 @@ int main( int argc, char* argv[] )
     iSimu.setProbTransp0( probTransp0 );
     iSimu.setK( k );
     iSimu.setZygoteSelection( zygoteSelection );
+    iSimu.setFecunditySelection( fecunditySelection );
+    iSimu.setMoran( moran );
+    iSimu.setFastInitialization( fastInit, nbThreads );
+    iSimu.setPipelinedStats( pipelinedStats );
+    for( size_t fam=0; fam<vFamProbTransp0.size(); ++fam )
+      iSimu.addFamily( vFamProbLoss[fam], vFamProbTransp0[fam], vFamK[fam] );
     iSimu.setSelMultiplicator( selMult );
     iSimu.setSelExponent( selExp );
     iSimu.setRng( r );
     iSimu.setOutFile( outFile );
+    iSimu.setStats( vStats );
+    if( format == "bin" )
+      iSimu.setBinaryWriter( &binOut );
+    iSimu.setTreesPrefix( treesPrefix );
+    iSimu.setLinkageDisequilibrium( &ld );
+    iSimu.setLdPrefix( ldPrefix );
+    iSimu.setLdInterval( ldInterval );
+    iSimu.setSimplifyInterval( simplifyInterval );
+    if( traceFile != "" )
+      iSimu.setEventTrace( &trace );
+    iSimu.setParametersText( ckptText );
+    iSimu.setCheckpointFile( checkpointFile );
+    iSimu.setCheckpointInterval( checkpointInterval );
+    if( maxTime > 0 )
+      iSimu.setDeadline( startRawTime + maxTime );
+    if( resumeFile != "" && simuId == firstSimuId )
+      iSimu.setResumeFile( resumeFile );
+    gsl_rng * rSimu = NULL;
+    if( simuId == 0 ){
+      iSimu.setNbGenerations( burnInGens );
+      iSimu.setK( burnInK );
+      iSimu.setZygoteSelection( burnInSelection && ! fecunditySelection );
+      iSimu.setFecunditySelection( burnInSelection && fecunditySelection );
+      iSimu.setEquilibriumWindow( burnInWindow );
+      iSimu.setEndGenomes( &burnInGenomes );
+      iSimu.setTreesPrefix( "" );
+    }
+    else if( burnInGens > 0 ){
+      rSimu = gsl_rng_alloc( T );
+      gsl_rng_set( rSimu, vSeeds[ simuId - 1 ] );
+      iSimu.setRng( rSimu );
+      iSimu.setStartGenomes( &burnInGenomes );
+    }
+    if( aggregateFile != "" && simuId > 0 ){
+      iSimu.setAggregator( &aggregator );
+      iSimu.setRawOutput( vIsRaw[ simuId ] );
+    }
     iSimu.setVerbose( verbose );
     iSimu.run();
+    interrupted = iSimu.isInterrupted();
+    for( int part=0; part<NB_MEM_PARTS; ++part )
+      vMaxNbBytes[ part ] = max( vMaxNbBytes[ part ],
+                                 iSimu.getMaxNbBytes( part ) );
+    if( rSimu != NULL )
+      gsl_rng_free( rSimu );
+    if( simuId == 0 ){
+      if( verbose > 0 )
+        cout << "burn-in: " << iSimu.getNbGenerationsDone() << " generations"
+             << endl;
+      // one seed per simulation, drawn at once so that each simulation
+      // doesn't depend on the others
+      for( int s=0; s<nbSimu; ++s )
+        vSeeds.push_back( gsl_rng_get( r ) );
+    }
   }
+  if( interrupted )
+    cout << "time limit reached, continue with --resume=" << checkpointFile
+         << endl;
 
   gsl_rng_free( r );
+  if( traceFile != "" ){
+    trace.close();
+    if( verbose > 0 )
+      cout << "trace: " << trace.getNbEvents() << " events, "
+           << trace.getNbStalls() << " waits for the writer" << endl;
+  }
 
   time_t endRawTime;
   time( &endRawTime );
   printf( "END: %s", ctime(&endRawTime) );
 
-  getElapsedTime( outStream, startRawTime, endRawTime );
-  outStream.close();
+  if( format == "bin" ){
+    stringstream ssTime;
+    getElapsedTime( ssTime, startRawTime, endRawTime );
+    getMemoryReport( ssTime, vMaxNbBytes, nbDiploids );
+    binOut.close( ssTime.str() );
+  }
+  else{
+    getElapsedTime( outStream, startRawTime, endRawTime );
+    getMemoryReport( outStream, vMaxNbBytes, nbDiploids );
+    outStream.close();
+  }
+  if( aggregateFile != "" ){
+    ofstream aggStream( aggregateFile.c_str() );
+    aggregator.writeTable( aggStream );
+    getElapsedTime( aggStream, startRawTime, endRawTime );
+    aggStream.close();
+    if( aggregateStateFile != "" )
+      aggregator.save( aggregateStateFile );
+  }
   if( verbose > 0 )
     getElapsedTime( cout, startRawTime, endRawTime );
 }
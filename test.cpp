@@ -1,10 +1,31 @@
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>  // for remove
+#include <cstring>  // for memcmp
+#include <cmath>  // for fabs
+#include <algorithm>  // for count
+#include <map>
+#include <ctime>  // for clock_gettime
+#include <unistd.h>  // for gethostname
+#include <getopt.h>
 #include "gsl/gsl_rng.h"
 using namespace std;
 
 #include "Population.h"
 #include "Individual.h"
 #include "Chromosome.h"
+#include "GenomeMatrix.h"
+#include "TreeSequence.h"
+#include "EventTrace.h"
+#include "Checkpoint.h"
+#include "cc83.h"
+#include "Aggregator.h"
+#include "Abc.h"
+#include "MemoryStats.h"
+#include "LinkageDisequilibrium.h"
+#include "LockstepPopulations.h"
+#include "Simulation.h"
 
 void usage( char *program_name, int status )
 {
@@ -12,6 +33,11 @@ void usage( char *program_name, int status )
   cerr << "options:" << endl;
   cerr << "     -h: this help" << endl;
   cerr << "     -v: verbose (default=0/1/2)" << endl;
+  cerr << "     -p: performance checks (default=1, 0 to skip them)" << endl;
+  cerr << "     -b: performance baseline of this machine" << endl;
+  cerr << "         (default=test_perf_<hostname>.txt, written if absent)" << endl;
+  cerr << "     -B: write a new performance baseline, e.g. after a wanted change" << endl;
+  cerr << "     -t: tolerated slow-down relative to the baseline (default=0.25)" << endl;
   exit( status );
 }
 
@@ -235,16 +261,1645 @@ int test_Individual_getNbSites( gsl_rng * r, int verbose )
   }
 }
 
+int test_Population_saveData( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  Population pop;
+  pop.setNbDiploids( 2 );
+  pop.setNbChrPerIndividual( 4 );
+  pop.setNbSitesPerChromosome( 4 );
+  pop.setExpNbTEsPerIndividual( 4 );
+  pop.setRng( r );
+  pop.initialize();
+
+  vector<string> vStats;
+  vStats.push_back( "nC" );
+  vStats.push_back( "sdL" );
+  pop.setStats( vStats );
+  string outFile = "test_saveData.tsv";
+  remove( outFile.c_str() );
+  pop.saveData( 1, 0, outFile );
+
+  ifstream inStream( outFile.c_str() );
+  string line;
+  getline( inStream, line );
+  inStream.close();
+  remove( outFile.c_str() );
+  int exp = 4;
+  int obs = count( line.begin(), line.end(), '\t' ) + 1;
+  if( verbose > 1 )
+    cout << "line=" << line << endl;
+
+  if( exp == obs && line.substr( 0, 4 ) == "1\t0\t" ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+int test_GenomeMatrix_recombine( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  // 2 words per chromosome, the 2nd crossing-over being in the 2nd word
+  int nbSitesPerChr = 100;
+  GenomeMatrix gm;
+  gm.resize( 2, 2, nbSitesPerChr );
+  for( int site=0; site<nbSitesPerChr; ++site )
+    gm.insertTE( 0, 1, site );
+  vector<int> vCoLoci;
+  vCoLoci.push_back( 70 );
+  vCoLoci.push_back( 3 );
+  GenomeMatrix::recombine( gm.newChromosome( 1, 0 ), gm.getChromosome( 0, 0 ),
+                           gm.getChromosome( 0, 1 ), 2, vCoLoci, false );
+  GenomeMatrix::recombine( gm.newChromosome( 1, 1 ), gm.getChromosome( 0, 0 ),
+                           gm.getChromosome( 0, 1 ), 2, vCoLoci, true );
+  gm.updateNbTEs( 1 );
+
+  bool isOk = ( gm.getNbTEs( 1, 0 ) == 67 && gm.getNbTEs( 1, 1 ) == 33
+                && GenomeMatrix::selectTE( gm.getChromosome( 1, 0 ), 2, 0 ) == 3
+                && GenomeMatrix::selectTE( gm.getChromosome( 1, 0 ), 2, 66 ) == 69
+                && GenomeMatrix::selectTE( gm.getChromosome( 1, 1 ), 2, 3 ) == 70 );
+  if( verbose > 1 )
+    cout << "nbTEs=" << gm.getNbTEs( 1, 0 ) << "," << gm.getNbTEs( 1, 1 ) << endl;
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+int test_GenomeMatrix_singleWord( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  // the single-word kernels give the same results as the generic ones
+  int nbDiffs = 0;
+  for( int rep=0; rep<100; ++rep ){
+    uint64_t a = ( (uint64_t) gsl_rng_get( r ) << 32 ) ^ gsl_rng_get( r );
+    uint64_t b = ( (uint64_t) gsl_rng_get( r ) << 32 ) ^ gsl_rng_get( r );
+    vector<int> vCoLoci;
+    for( int i=gsl_rng_uniform_int( r, 4 ); i>0; --i )
+      vCoLoci.push_back( gsl_rng_uniform_int( r, 64 ) );
+    bool second = gsl_rng_uniform_int( r, 2 ) == 1;
+    uint64_t dest1, dest0;
+    ChromosomeWords<1>::recombine( &dest1, &a, &b, 1, vCoLoci, second );
+    ChromosomeWords<0>::recombine( &dest0, &a, &b, 1, vCoLoci, second );
+    int rank = gsl_rng_uniform_int( r, 64 );
+    if( dest1 != dest0
+        || ChromosomeWords<1>::countTEs( &a, 1 ) != ChromosomeWords<0>::countTEs( &a, 1 )
+        || ChromosomeWords<1>::selectTE( &a, 1, rank ) != ChromosomeWords<0>::selectTE( &a, 1, rank ) )
+      ++ nbDiffs;
+  }
+
+  bool isOk = ( nbDiffs == 0 );
+  if( verbose > 1 )
+    cout << "nbDiffs=" << nbDiffs << endl;
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+int test_GenomeMatrix_copyOnWrite( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  // the offspring shares the chromosome of its parent until it is modified;
+  // each matrix starts with one empty block shared by all its chromosomes
+  ChromosomeStore store;
+  GenomeMatrix parents, offspring;
+  parents.setStore( &store );
+  offspring.setStore( &store );
+  parents.resize( 1, 2, 100 );
+  offspring.resize( 1, 2, 100 );
+  parents.insertTE( 0, 0, 10 );
+  offspring.shareChromosome( 0, 0, parents, 0, 0 );
+  offspring.updateNbTEs( 0 );
+  bool isShared = ( offspring.getChromosome( 0, 0 ) == parents.getChromosome( 0, 0 )
+                    && store.getNbBlocksInUse() == 3 );
+  offspring.insertTE( 0, 0, 20 );
+
+  bool isOk = ( isShared && store.getNbBlocksInUse() == 4
+                && parents.getNbTEs( 0 ) == 1 && offspring.getNbTEs( 0 ) == 2
+                && ! parents.isTranspElemAtSite( 0, 0, 20 )
+                && offspring.isTranspElemAtSite( 0, 0, 10 ) );
+  if( verbose > 1 )
+    cout << "blocks=" << store.getNbBlocksInUse() << endl;
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+int test_Population_loopCounts( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  // with 2 diploids, the 2nd parent is drawn again half of the time
+  Population pop;
+  pop.setNbDiploids( 2 );
+  pop.setNbChrPerIndividual( 2 );
+  pop.setNbSitesPerChromosome( 10 );
+  pop.setExpNbTEsPerIndividual( 4 );
+  pop.setTotalMapDist( 1 );
+  pop.setZygoteSelection( true );
+  pop.setSelMultiplicator( 0.1 );
+  pop.setSelExponent( 1.0 );
+  pop.setRng( r );
+  pop.initialize();
+  pop.makeNewGeneration( 0 );
+  LoopCounts couple = pop.getLoopCounts( LOOP_COUPLE );
+  LoopCounts viable = pop.getLoopCounts( LOOP_VIABLE );
+  pop.makeNewGeneration( 0 );
+  LoopCounts total = pop.getTotalLoopCounts( LOOP_COUPLE );
+
+  bool isOk = ( viable.nbAccepted == 2 && couple.nbAccepted == viable.nbAttempts
+                && couple.nbWastedDraws == couple.nbAttempts - couple.nbAccepted
+                && total.nbAccepted == couple.nbAccepted
+                + pop.getLoopCounts( LOOP_COUPLE ).nbAccepted );
+  if( verbose > 1 )
+    cout << "couple=" << couple.nbAttempts << "/" << couple.nbAccepted
+         << " viable=" << viable.nbAttempts << "/" << viable.nbAccepted
+         << " wasted=" << viable.nbWastedDraws << endl;
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+int test_TreeSequence_simplify( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  // 2 individuals, the 1st one being the only parent of the genomes 0 to 1
+  // and the 2nd one of the genomes 2 to 3 (both from its homologue 0)
+  TreeSequence ts;
+  ts.setSequenceLength( 10 );
+  ts.initialize( 2 );
+  ts.addMutation( 0, 1, 7, '1' );
+  ts.addMutation( 1, 1, 2, '1' );
+  ts.startGeneration( 2 );
+  ts.startChild( 0 );
+  ts.addSegment( 0, 0, 0, 10, 0, 0 );
+  ts.addSegment( 0, 1, 0, 5, 0, 0 );
+  ts.addSegment( 0, 1, 5, 10, 0, 1 );
+  ts.startChild( 1 );
+  ts.addSegment( 1, 0, 0, 10, 1, 0 );
+  ts.addSegment( 1, 1, 0, 10, 1, 0 );
+  ts.endGeneration();
+  ts.simplify();
+
+  // the coalescences on [0,5) and [0,10) remain, the 2nd mutation is lost
+  bool isOk = ( ts.getNbNodes() == 6 && ts.getNbEdges() == 4
+                && ts.getNbMutations() == 1 );
+  if( verbose > 1 )
+    cout << "nodes=" << ts.getNbNodes() << " edges=" << ts.getNbEdges()
+         << " mutations=" << ts.getNbMutations() << endl;
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+int test_EventTrace_ring( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  // a ring of 4 slots wraps around many times and makes the producer wait
+  string traceFile = "test_trace.bin";
+  EventTrace trace;
+  trace.open( traceFile, 2 );
+  for( int i=0; i<1000; ++i )
+    trace.record( EVENT_INSERTION, i, i % 4, i % 31, i + 1 );
+  trace.close();
+
+  FILE * fp = fopen( traceFile.c_str(), "rb" );
+  char magic[16];
+  bool isOk = ( fp != NULL && fread( magic, 1, 16, fp ) == 16
+                && memcmp( magic, TRACE_MAGIC, 8 ) == 0 );
+  TraceEvent event;
+  int nbEvents = 0;
+  while( isOk && fread( &event, sizeof(TraceEvent), 1, fp ) == 1 ){
+    isOk = ( event.type == EVENT_INSERTION && event.ind == nbEvents
+             && event.chr == nbEvents % 4 && event.pos == nbEvents % 31
+             && event.value == nbEvents + 1 );
+    ++ nbEvents;
+  }
+  isOk = isOk && nbEvents == 1000 && trace.getNbEvents() == 1000;
+  if( fp != NULL )
+    fclose( fp );
+  remove( traceFile.c_str() );
+  if( verbose > 1 )
+    cout << "events=" << nbEvents << " stalls=" << trace.getNbStalls() << endl;
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+int test_Checkpoint_resume( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  // the generations after the checkpoint are the same once it is loaded
+  Population pop1, pop2;
+  Population * vPops[2] = { &pop1, &pop2 };
+  for( int p=0; p<2; ++p ){
+    vPops[p]->setNbDiploids( 20 );
+    vPops[p]->setNbChrPerIndividual( 4 );
+    vPops[p]->setNbSitesPerChromosome( 70 );
+    vPops[p]->setExpNbTEsPerIndividual( 10 );
+    vPops[p]->setTotalMapDist( 2 );
+    vPops[p]->setRng( r );
+  }
+  pop1.initialize();
+  for( int g=0; g<5; ++g ){
+    pop1.makeNewGeneration( 0 );
+    pop1.loss( 0.05 );
+    pop1.transposition( 0.1, 0 );
+  }
+  string ckptFile = "test_checkpoint.bin";
+  Checkpoint ckpt;
+  ckpt.setHeaderText( "nbDiploids=20\n" );
+  ckpt.setSimulationIdentifier( 3 );
+  ckpt.setGeneration( 5 );
+  ckpt.save( ckptFile, r, pop1 );
+  for( int p=0; p<2; ++p ){
+    if( p == 1 ){
+      ckpt.setGeneration( 0 );
+      ckpt.load( ckptFile, r, pop2 );
+    }
+    for( int g=0; g<3; ++g ){
+      vPops[p]->makeNewGeneration( 0 );
+      vPops[p]->loss( 0.05 );
+      vPops[p]->transposition( 0.1, 0 );
+    }
+  }
+  remove( ckptFile.c_str() );
+
+  bool isOk = ( ckpt.getGeneration() == 5 && ckpt.getSimulationIdentifier() == 3
+                && ckpt.getParameter( "nbDiploids" ) == "20" );
+  GenomeMatrix & gm1 = pop1.getGenomes();
+  GenomeMatrix & gm2 = pop2.getGenomes();
+  for( int i=0; i<20; ++i )
+    for( int chr=0; chr<4; ++chr ){
+      isOk = isOk && gm1.getNbTEs( i, chr ) == gm2.getNbTEs( i, chr );
+      for( int site=0; site<70; ++site )
+        isOk = isOk && ( gm1.isTranspElemAtSite( i, chr, site )
+                         == gm2.isTranspElemAtSite( i, chr, site ) );
+    }
+  if( verbose > 1 )
+    cout << "TEs=" << pop1.getSumNbTEs() << " " << pop2.getSumNbTEs() << endl;
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+int test_Population_setGenomes( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  // 2 replicates forked from the same population evolve independently
+  Population pop0, pop1, pop2;
+  Population * vPops[3] = { &pop0, &pop1, &pop2 };
+  for( int p=0; p<3; ++p ){
+    vPops[p]->setNbDiploids( 10 );
+    vPops[p]->setNbChrPerIndividual( 4 );
+    vPops[p]->setNbSitesPerChromosome( 31 );
+    vPops[p]->setExpNbTEsPerIndividual( 10 );
+    vPops[p]->setTotalMapDist( 2 );
+    vPops[p]->setRng( r );
+  }
+  pop0.initialize();
+  pop1.setGenomes( pop0.getGenomes() );
+  pop2.setGenomes( pop0.getGenomes() );
+  int nbTEs0 = pop0.getSumNbTEs();
+  bool isOk = ( pop1.getSumNbTEs() == nbTEs0 && pop2.getSumNbTEs() == nbTEs0 );
+  for( int g=0; g<5; ++g ){
+    pop1.makeNewGeneration( 0 );
+    pop1.transposition( 0.5, 0 );
+  }
+  isOk = isOk && pop0.getSumNbTEs() == nbTEs0 && pop2.getSumNbTEs() == nbTEs0
+    && pop1.getSumNbTEs() != nbTEs0;
+  for( int i=0; i<10; ++i )
+    for( int chr=0; chr<4; ++chr )
+      for( int site=0; site<31; ++site )
+        isOk = isOk && ( pop0.getGenomes().isTranspElemAtSite( i, chr, site )
+                         == pop2.getGenomes().isTranspElemAtSite( i, chr, site ) );
+  if( verbose > 1 )
+    cout << "TEs=" << nbTEs0 << " " << pop1.getSumNbTEs() << " "
+         << pop2.getSumNbTEs() << endl;
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+int test_cc83_api( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  // the C API gives the same simulation as a Population driven by hand
+  cc83_params params;
+  cc83_default_params( &params );
+  params.nbDiploids = 20;
+  params.totalMapDist = 2;
+  params.stats = "meanC,meanL";
+  cc83_simulation * sim = cc83_create( &params );
+  bool isOk = ( sim != NULL && cc83_nb_stats( sim ) == 2 );
+
+  params.stats = "meanC,foo";
+  isOk = isOk && cc83_create( &params ) == NULL;
+
+  // errors are reported to the host instead of exiting
+  cc83_params satParams;
+  cc83_default_params( &satParams );
+  satParams.nbSitesPerChr = 4;
+  satParams.initNbTEsPerInd = 17;
+  isOk = isOk && cc83_create( &satParams ) == NULL;
+  satParams.initNbTEsPerInd = 10;
+  satParams.probTransp0 = 1;
+  satParams.k = 0;
+  satParams.probLoss = 0;
+  cc83_simulation * satSim = cc83_create( &satParams );
+  isOk = isOk && satSim != NULL && cc83_step( satSim, 10 ) == -1
+    && cc83_step( satSim, 1 ) == -1 && string( cc83_error() ) != "";
+  cc83_free( satSim );
+
+  gsl_rng * r2 = gsl_rng_alloc( gsl_rng_default );
+  gsl_rng_set( r2, params.seed );
+  Population pop;
+  pop.setNbDiploids( 20 );
+  pop.setNbChrPerIndividual( 4 );
+  pop.setNbSitesPerChromosome( params.nbSitesPerChr );
+  pop.setExpNbTEsPerIndividual( params.initNbTEsPerInd );
+  pop.setTotalMapDist( 2 );
+  pop.setVerbose( -1 );
+  pop.setRng( r2 );
+  pop.initialize();
+  Population::GenerationKernel kernel = pop.getGenerationKernel( params.k );
+
+  int nbGen = isOk ? cc83_step( sim, 10 ) : 0;
+  for( int g=0; g<nbGen; ++g )
+    (pop.*kernel)( params.probLoss, params.probTransp0, params.k );
+  isOk = isOk && nbGen == cc83_generation( sim )
+    && cc83_nb_tes( sim ) == pop.getSumNbTEs();
+
+  if( isOk ){
+    isOk = isOk && cc83_nb_diploids( sim ) == 20;
+    vector<int> vNbTEs( cc83_nb_diploids( sim ) );
+    cc83_nb_tes_per_ind( sim, &vNbTEs[0] );
+    for( int i=0; i<20; ++i )
+      isOk = isOk && vNbTEs[i] == pop.getGenomes().getNbTEs( i );
+    vector<double> vFreqs( cc83_nb_loci( sim ) ), vValues( 2 );
+    cc83_freq_per_locus( sim, &vFreqs[0] );
+    cc83_stats( sim, &vValues[0] );
+    double sum = 0;
+    for( size_t l=0; l<vFreqs.size(); ++l )
+      sum += vFreqs[l];
+    isOk = isOk && fabs( sum / vFreqs.size() - vValues[1] ) < 1e-9;
+    if( verbose > 1 )
+      cout << "gen=" << nbGen << " TEs=" << cc83_nb_tes( sim )
+           << " meanL=" << vValues[1] << endl;
+  }
+  cc83_free( sim );
+  gsl_rng_free( r2 );
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+int test_Aggregator_merge( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  // the aggregate of all the replicates is the merge of those of 2 halves,
+  // also after a save and a load
+  vector<string> vStats( 1, "meanC" );
+  Aggregator all, half1, half2;
+  all.setStats( vStats );
+  half1.setStats( vStats );
+  half2.setStats( vStats );
+  vector<double> vValues( 1 );
+  for( int rep=0; rep<1000; ++rep ){
+    Aggregator & half = ( rep % 2 == 0 ) ? half1 : half2;
+    all.addReplicate();
+    half.addReplicate();
+    int lastGen = ( rep % 10 == 0 ) ? 3 : 5;
+    for( int g=0; g<=lastGen; ++g ){
+      vValues[0] = g == lastGen && lastGen == 3 ? 0 : rep + gsl_rng_uniform( r );
+      all.add( g, vValues );
+      half.add( g, vValues );
+    }
+    if( lastGen == 3 ){
+      all.addExtinction( 3 );
+      half.addExtinction( 3 );
+    }
+  }
+  string stateFile = "test_Aggregator.state";
+  half2.save( stateFile );
+  Aggregator loaded;
+  loaded.load( stateFile );
+  remove( stateFile.c_str() );
+  bool isOk = half1.merge( loaded );
+
+  isOk = isOk && half1.getNbReplicates() == 1000
+    && half1.getNbGenerations() == 6
+    && fabs( half1.getExtinctFraction( 2 ) ) < 1e-12
+    && fabs( half1.getExtinctFraction( 5 ) - 0.1 ) < 1e-12;
+  for( int g=0; g<=5; ++g ){
+    const RunningStats & s1 = all.getRunningStats( g, 0 );
+    const RunningStats & s2 = half1.getRunningStats( g, 0 );
+    isOk = isOk && s1.getNb() == s2.getNb()
+      && fabs( s1.getMean() - s2.getMean() ) < 1e-9 * s1.getMean()
+      && fabs( s1.getVariance() - s2.getVariance() ) < 1e-9 * s1.getVariance();
+    // the values are about uniform on [0,1000], except the zeros of gen 3
+    for( double q=0.1; q<1 && g!=3; q+=0.2 )
+      isOk = isOk && fabs( s2.getQuantile( q ) - 1000 * q ) < 30;
+    if( verbose > 1 )
+      cout << "gen " << g << ": n=" << s2.getNb() << " mean=" << s2.getMean()
+           << " med=" << s2.getQuantile( 0.5 ) << endl;
+  }
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+int test_Abc_threads( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  int param;
+  Prior prior;
+  bool isOk = Abc::parsePrior( "k=uniform:0:0.1", param, prior )
+    && param == ABC_K && prior.type == PRIOR_UNIFORM && prior.max == 0.1
+    && ! Abc::parsePrior( "k=uniform:0.1:0", param, prior )
+    && ! Abc::parsePrior( "foo=uniform:0:1", param, prior )
+    && ! Abc::parsePrior( "k=loguniform:0:1", param, prior );
+
+  // the particles don't depend on the nb of threads
+  vector<AbcDraw> vParticles[2];
+  vector<double> vWeights[2];
+  for( int t=0; t<2; ++t ){
+    Abc abc;
+    abc.setNbGenerations( 10 );
+    Abc::parsePrior( "k=uniform:0:0.1", param, prior );
+    abc.setPrior( param, prior );
+    abc.setObserved( vector<string>( 1, "meanC" ), vector<double>( 1, 12 ) );
+    abc.setNbParticles( 10 );
+    abc.setNbPriorDraws( 40 );
+    abc.setNbRounds( 2 );
+    abc.setNbThreads( t + 1 );
+    gsl_rng * r2 = gsl_rng_alloc( gsl_rng_default );
+    gsl_rng_set( r2, 1859 );
+    abc.setRng( r2 );
+    ofstream out( "/dev/null" );
+    abc.run( out );
+    vParticles[t] = abc.getParticles();
+    vWeights[t] = abc.getWeights();
+    gsl_rng_free( r2 );
+  }
+  isOk = isOk && vParticles[0].size() == 10 && vParticles[1].size() == 10;
+  double sumWeights = 0;
+  for( size_t i=0; isOk && i<vParticles[0].size(); ++i ){
+    isOk = vParticles[0][i].vParams[ABC_K] == vParticles[1][i].vParams[ABC_K]
+      && vParticles[0][i].distance == vParticles[1][i].distance
+      && vWeights[0][i] == vWeights[1][i];
+    sumWeights += vWeights[0][i];
+    if( verbose > 1 )
+      cout << "k=" << vParticles[0][i].vParams[ABC_K]
+           << " distance=" << vParticles[0][i].distance
+           << " weight=" << vWeights[0][i] << endl;
+  }
+  isOk = isOk && fabs( sumWeights - 1 ) < 1e-9;
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+int test_MemoryStats_phases( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  // an allocation is counted in the phase of its scope
+  MemoryStats::startCounting();
+  int phase = MemoryStats::getPhase();
+  AllocCounts before = MemoryStats::getAllocCounts( PHASE_LOSS );
+  {
+    MemoryPhase memoryPhase( PHASE_LOSS );
+    char * p = new char[ 100 ];
+    delete[] p;
+  }
+  AllocCounts after = MemoryStats::getAllocCounts( PHASE_LOSS );
+  bool isOk = MemoryStats::getPhase() == phase
+    && after.nbAllocs - before.nbAllocs == 1
+    && after.nbBytes - before.nbBytes == 100;
+
+  // the losses don't allocate, and the counts of the population are those
+  // of its last generation
+  Population pop;
+  pop.setNbDiploids( 50 );
+  pop.setNbChrPerIndividual( 4 );
+  pop.setNbSitesPerChromosome( 31 );
+  pop.setExpNbTEsPerIndividual( 10 );
+  pop.setTotalMapDist( 90 );
+  pop.setVerbose( -1 );
+  pop.setRng( r );
+  pop.initialize();
+  Population::GenerationKernel kernel = pop.getGenerationKernel( 0.05 );
+  long nbReproAllocs = 0;
+  for( int g=1; g<=10; ++g ){
+    (pop.*kernel)( 0.005, 0.01, 0.05 );
+    nbReproAllocs += pop.getAllocCounts( PHASE_REPRODUCTION ).nbAllocs;
+    isOk = isOk && pop.getAllocCounts( PHASE_LOSS ).nbAllocs == 0;
+  }
+  AllocCounts total = MemoryStats::getAllocCounts( PHASE_REPRODUCTION );
+  isOk = isOk && nbReproAllocs > 0 && nbReproAllocs <= total.nbAllocs
+    && pop.getNbBytes( MEM_CHROMOSOMES ) >= 50 * 4 * sizeof(uint64_t)
+    && pop.getNbBytes( MEM_TREES ) == 0
+    && MemoryStats::getCurrentRss() > 0
+    && MemoryStats::getPeakRss() >= MemoryStats::getCurrentRss();
+  MemoryStats::stopCounting();
+  if( verbose > 1 )
+    cout << "repro allocs=" << nbReproAllocs
+         << " genomes=" << pop.getNbBytes( MEM_GENOMES )
+         << " chromosomes=" << pop.getNbBytes( MEM_CHROMOSOMES )
+         << " rss=" << MemoryStats::getCurrentRss() << "kB" << endl;
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+int test_LinkageDisequilibrium_pairs( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  // D and r2 of each pair match a direct count over the haplotypes, with
+  // more than a tile of loci and a word of haplotypes, and the sums don't
+  // depend on the nb of threads
+  Population pop;
+  pop.setNbDiploids( 40 );
+  pop.setNbChrPerIndividual( 4 );
+  pop.setNbSitesPerChromosome( 70 );
+  pop.setExpNbTEsPerIndividual( 40 );
+  pop.setTotalMapDist( 1 );
+  pop.setVerbose( -1 );
+  pop.setRng( r );
+  pop.initialize();
+  Population::GenerationKernel kernel = pop.getGenerationKernel( 0.05 );
+  for( int g=1; g<=5; ++g )
+    (pop.*kernel)( 0.005, 0.01, 0.05 );
+  GenomeMatrix & genomes = pop.getGenomes();
+
+  int nbHap = 80, nbLoci = 140;
+  vector< vector<int> > vHaps( nbHap, vector<int>( nbLoci, 0 ) );
+  for( int ind=0; ind<40; ++ind )
+    for( int chr=0; chr<4; ++chr )
+      for( int site=0; site<70; ++site )
+        vHaps[ 2 * ind + chr % 2 ][ ( chr / 2 ) * 70 + site ] =
+          genomes.isTranspElemAtSite( ind, chr, site );
+  vector<int> vSeg;
+  vector<double> vFreqs;
+  for( int locus=0; locus<nbLoci; ++locus ){
+    int count = 0;
+    for( int h=0; h<nbHap; ++h )
+      count += vHaps[h][locus];
+    if( count > 0 && count < nbHap ){
+      vSeg.push_back( locus );
+      vFreqs.push_back( count / (double) nbHap );
+    }
+  }
+
+  LinkageDisequilibrium ld1, ld3;
+  ld1.setKeepPairs( true );
+  ld1.compute( genomes );
+  ld3.setNbThreads( 3 );
+  ld3.compute( genomes );
+  stringstream ssPairs;
+  ld1.writePairs( ssPairs, 1, 5 );
+
+  bool isOk = ld1.getNbSegregatingLoci() == (int) vSeg.size()
+    && vSeg.size() > 64
+    && ld1.getMeanD() == ld3.getMeanD()
+    && ld1.getMeanR2Linked() == ld3.getMeanR2Linked()
+    && ld1.getMeanR2Unlinked() == ld3.getMeanR2Unlinked();
+  double sumD = 0, sumR2Linked = 0;
+  long nbLinked = 0;
+  for( size_t a=0; isOk && a<vSeg.size(); ++a )
+    for( size_t b=a+1; isOk && b<vSeg.size(); ++b ){
+      int nbAB = 0;
+      for( int h=0; h<nbHap; ++h )
+        nbAB += vHaps[h][ vSeg[a] ] * vHaps[h][ vSeg[b] ];
+      double d = nbAB / (double) nbHap - vFreqs[a] * vFreqs[b];
+      double r2 = d * d / ( vFreqs[a] * ( 1 - vFreqs[a] )
+                            * vFreqs[b] * ( 1 - vFreqs[b] ) );
+      sumD += d;
+      if( vSeg[a] / 70 == vSeg[b] / 70 ){
+        sumR2Linked += r2;
+        ++ nbLinked;
+      }
+      int simu, gen, locus1, locus2;
+      string dist;
+      float dPair, r2Pair;
+      ssPairs >> simu >> gen >> locus1 >> locus2 >> dist >> dPair >> r2Pair;
+      isOk = locus1 == vSeg[a] && locus2 == vSeg[b]
+        && fabs( dPair - d ) < 1e-6 && fabs( r2Pair - r2 ) < 1e-4 * ( 1 + r2 );
+    }
+  long nbPairs = vSeg.size() * ( vSeg.size() - 1 ) / 2;
+  isOk = isOk && fabs( ld1.getMeanD() - sumD / nbPairs ) < 1e-12
+    && fabs( ld1.getMeanR2Linked() - sumR2Linked / nbLinked ) < 1e-12;
+  if( verbose > 1 )
+    cout << "segregating=" << vSeg.size() << " meanD=" << ld1.getMeanD()
+         << " meanR2Linked=" << ld1.getMeanR2Linked()
+         << " meanR2Unlinked=" << ld1.getMeanR2Unlinked() << endl;
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+int test_LockstepPopulations_replicates( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  // each replicate has the same statistics at each generation as a
+  // population with the same stream, with selection and regulation on
+  // chromosomes of one word, then without them on chromosomes of two words
+  // with enough losses for some replicates to lose their TEs
+  bool isOk = true;
+  int nbReps = 6, nbGen = 30, nbExtinct = 0;
+  for( int config=0; config<2 && isOk; ++config ){
+    int nbSites = config == 0 ? 31 : 70;
+    float probLoss = config == 0 ? 0.05 : 0.3;
+    float probTransp0 = config == 0 ? 0.1 : 0.2;
+    float k = config == 0 ? 0.05 : 0;
+    vector<unsigned long> vSeeds;
+    vector<gsl_rng *> vRngs;
+    for( int rep=0; rep<nbReps; ++rep ){
+      vSeeds.push_back( gsl_rng_get( r ) );
+      vRngs.push_back( gsl_rng_alloc( gsl_rng_default ) );
+      gsl_rng_set( vRngs[rep], vSeeds[rep] );
+    }
+    LockstepPopulations lanes;
+    lanes.setNbDiploids( 12 );
+    lanes.setNbChrPerIndividual( 4 );
+    lanes.setNbSitesPerChromosome( nbSites );
+    lanes.setExpNbTEsPerIndividual( config == 0 ? 10 : 2 );
+    lanes.setTotalMapDist( config == 0 ? 9 : 90 );
+    lanes.setZygoteSelection( config == 0 );
+    lanes.setSelMultiplicator( 0.01 );
+    lanes.setSelExponent( 1.5 );
+    lanes.setRngs( vRngs );
+    lanes.initialize();
+    lanes.run( nbGen, probLoss, probTransp0, k );
+
+    for( int rep=0; rep<nbReps && isOk; ++rep ){
+      gsl_rng * rRep = gsl_rng_alloc( gsl_rng_default );
+      gsl_rng_set( rRep, vSeeds[rep] );
+      Population pop;
+      pop.setNbDiploids( 12 );
+      pop.setNbChrPerIndividual( 4 );
+      pop.setNbSitesPerChromosome( nbSites );
+      pop.setExpNbTEsPerIndividual( config == 0 ? 10 : 2 );
+      pop.setTotalMapDist( config == 0 ? 9 : 90 );
+      pop.setZygoteSelection( config == 0 );
+      pop.setSelMultiplicator( 0.01 );
+      pop.setSelExponent( 1.5 );
+      pop.setVerbose( -1 );
+      pop.setRng( rRep );
+      pop.initialize();
+      Population::GenerationKernel kernel = pop.getGenerationKernel( k );
+      vector<double> vValues;
+      pop.getStatsValues( vValues );
+      isOk = vValues == lanes.getRowValues( rep, 0 );
+      int g = 1;
+      for( ; g<=nbGen && isOk && pop.getSumNbTEs() > 0; ++g ){
+        (pop.*kernel)( probLoss, probTransp0, k );
+        pop.getStatsValues( vValues );
+        isOk = g <= lanes.getNbGenerationsDone( rep )
+          && vValues == lanes.getRowValues( rep, g );
+      }
+      isOk = isOk && lanes.getNbGenerationsDone( rep ) == g - 1;
+      for( int ind=0; ind<12 && isOk; ++ind )
+        for( int chr=0; chr<4; ++chr )
+          for( int site=0; site<nbSites; ++site )
+            isOk = isOk && pop.getGenomes().isTranspElemAtSite( ind, chr, site )
+              == lanes.isTranspElemAtSite( ind, chr, site, rep );
+      if( pop.getSumNbTEs() == 0 )
+        ++ nbExtinct;
+      if( verbose > 1 )
+        cout << "config " << config << " replicate " << rep << ": "
+             << lanes.getNbGenerationsDone( rep ) << " generations, "
+             << pop.getSumNbTEs() << " TEs" << endl;
+      gsl_rng_free( rRep );
+    }
+    for( int rep=0; rep<nbReps; ++rep )
+      gsl_rng_free( vRngs[rep] );
+  }
+  isOk = isOk && nbExtinct > 0;
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+int test_Population_moran( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  // at each generation of the Moran process, the statistics kept up to
+  // date step by step are the same as those computed from scratch on a copy
+  // of the genomes, with selection and regulation on chromosomes of one
+  // word, then without them on chromosomes of two words
+  bool isOk = true;
+  int nbGen = 20;
+  for( int config=0; config<2 && isOk; ++config ){
+    int nbSites = config == 0 ? 31 : 70;
+    float probLoss = config == 0 ? 0.05 : 0.1;
+    float probTransp0 = config == 0 ? 0.1 : 0.15;
+    float k = config == 0 ? 0.05 : 0;
+    Population pop;
+    pop.setNbDiploids( 12 );
+    pop.setNbChrPerIndividual( 4 );
+    pop.setNbSitesPerChromosome( nbSites );
+    pop.setExpNbTEsPerIndividual( config == 0 ? 10 : 4 );
+    pop.setTotalMapDist( config == 0 ? 9 : 90 );
+    pop.setZygoteSelection( config == 0 );
+    pop.setSelMultiplicator( 0.01 );
+    pop.setSelExponent( 1.5 );
+    pop.setVerbose( -1 );
+    pop.setMoran( true );
+    pop.setRng( r );
+    pop.initialize();
+    Population::GenerationKernel kernel = pop.getGenerationKernel( k );
+    vector<double> vValues, vExpValues;
+    for( int g=1; g<=nbGen && isOk && pop.getSumNbTEs() > 0; ++g ){
+      (pop.*kernel)( probLoss, probTransp0, k );
+      // a generation is one step per individual, each with a viable child
+      isOk = pop.getLoopCounts( LOOP_VIABLE ).nbAccepted == 12
+        && pop.getLoopCounts( LOOP_COUPLE ).nbAccepted
+        == pop.getLoopCounts( LOOP_VIABLE ).nbAttempts;
+      pop.getStatsValues( vValues );
+      Population copy;
+      copy.setNbDiploids( 12 );
+      copy.setNbChrPerIndividual( 4 );
+      copy.setNbSitesPerChromosome( nbSites );
+      copy.setRng( r );
+      copy.setGenomes( pop.getGenomes() );
+      copy.getStatsValues( vExpValues );
+      vector<string> vStats = pop.getStats();
+      for( size_t i=0; i<vStats.size() && isOk; ++i ){
+        if( vStats[i] == "meanC" || vStats[i] == "varC" || vStats[i] == "sdC" )
+          isOk = fabs( vValues[i] - vExpValues[i] )
+            <= 1e-6 * max( 1.0, fabs( vExpValues[i] ) );
+        else
+          isOk = vValues[i] == vExpValues[i];
+        if( ! isOk && verbose > 1 )
+          cout << "config " << config << " gen " << g << " " << vStats[i]
+               << ": " << vValues[i] << " != " << vExpValues[i] << endl;
+      }
+    }
+    if( verbose > 1 )
+      cout << "config " << config << ": " << pop.getSumNbTEs() << " TEs" << endl;
+  }
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+int test_Population_families( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  // with 3 TE families on chromosomes of one word then of two words, a site
+  // has a TE of at most one family, the nb of TEs of all the families is the
+  // sum of those of each, and the statistics of a family are those of a
+  // population with only its TEs
+  bool isOk = true;
+  for( int config=0; config<2 && isOk; ++config ){
+    int nbSites = config == 0 ? 31 : 70;
+    Population pop;
+    pop.setNbDiploids( 12 );
+    pop.setNbChrPerIndividual( 4 );
+    pop.setNbSitesPerChromosome( nbSites );
+    pop.setExpNbTEsPerIndividual( 5 );
+    pop.setTotalMapDist( config == 0 ? 9 : 90 );
+    pop.setZygoteSelection( true );
+    pop.setSelMultiplicator( 0.001 );
+    pop.setSelExponent( 1.5 );
+    pop.setVerbose( -1 );
+    pop.setRng( r );
+    pop.addFamily( 0.02, 0.1, 0 );
+    pop.addFamily( 0.2, 0.05, 0.1 );
+    pop.setStats( Population::getFamilyStats( 3 ) );
+    pop.initialize();
+    Population::GenerationKernel kernel = pop.getGenerationKernel( 0.05 );
+    for( int g=0; g<10; ++g )
+      (pop.*kernel)( 0.01, 0.1, 0.05 );
+    const GenomeMatrix & gm = pop.getGenomes();
+    isOk = gm.getNbFamilies() == 3;
+    for( int ind=0; ind<12 && isOk; ++ind ){
+      int nbTEs = 0;
+      for( int fam=0; fam<3; ++fam )
+        nbTEs += gm.getNbFamilyTEs( ind, fam );
+      isOk = nbTEs == gm.getNbTEs( ind );
+      for( int chr=0; chr<4; ++chr )
+        for( int site=0; site<nbSites; ++site ){
+          int nbFam = 0;
+          for( int fam=0; fam<3; ++fam )
+            nbFam += gm.isTranspElemAtSite( ind, chr, site, fam );
+          isOk = isOk && nbFam == gm.isTranspElemAtSite( ind, chr, site );
+        }
+    }
+    vector<double> vValues, vFamValues;
+    pop.getStatsValues( vValues );
+    vector<string> vDefault = Population::getDefaultStats();
+    for( int fam=0; fam<3 && isOk; ++fam ){
+      GenomeMatrix famGm;
+      famGm.resize( 12, 4, nbSites );
+      for( int ind=0; ind<12; ++ind )
+        for( int chr=0; chr<4; ++chr )
+          for( int site=0; site<nbSites; ++site )
+            if( gm.isTranspElemAtSite( ind, chr, site, fam ) )
+              famGm.insertTE( ind, chr, site );
+      Population famPop;
+      famPop.setNbDiploids( 12 );
+      famPop.setNbChrPerIndividual( 4 );
+      famPop.setNbSitesPerChromosome( nbSites );
+      famPop.setRng( r );
+      famPop.setGenomes( famGm );
+      famPop.getStatsValues( vFamValues );
+      for( size_t i=0; i<vDefault.size() && isOk; ++i )
+        isOk = vValues[ fam * vDefault.size() + i ] == vFamValues[i];
+      if( verbose > 1 )
+        cout << "config " << config << " family " << fam + 1 << ": "
+             << vFamValues[0] << " TEs" << endl;
+    }
+  }
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+int test_Population_fecundity( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  // with the fecundity selection, the parents are drawn in proportion to
+  // their fitness, so that with only two individuals without TEs and the
+  // others of fitness zero, all the children are those of the first two,
+  // without any rejected zygote
+  GenomeMatrix gm;
+  gm.resize( 12, 4, 31 );
+  for( int ind=2; ind<12; ++ind )
+    for( int chr=0; chr<4; ++chr )
+      for( int site=0; site<7; ++site )
+        gm.insertTE( ind, chr, site );
+  Population pop;
+  pop.setNbDiploids( 12 );
+  pop.setNbChrPerIndividual( 4 );
+  pop.setNbSitesPerChromosome( 31 );
+  pop.setTotalMapDist( 90 );
+  pop.setSelMultiplicator( 0.01 );
+  pop.setSelExponent( 1.5 );
+  pop.setFecunditySelection( true );
+  pop.setVerbose( -1 );
+  pop.setRng( r );
+  pop.setGenomes( gm );
+  pop.makeNewGeneration( 0 );
+  bool isOk = pop.getSumNbTEs() == 0
+    && pop.getLoopCounts( LOOP_VIABLE ).nbAttempts == 12
+    && pop.getLoopCounts( LOOP_COUPLE ).nbAccepted == 12;
+  if( verbose > 1 )
+    cout << pop.getSumNbTEs() << " TEs, "
+         << pop.getLoopCounts( LOOP_COUPLE ).nbAttempts << " couples drawn"
+         << endl;
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+int test_Population_fastInit( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  // the fast initialization gives the same genomes with 1 or 4 threads,
+  // with the expected mean nb of TEs per individual of each family, on
+  // chromosomes of one word with one family, then of three words with
+  // three families
+  bool isOk = true;
+  unsigned long seed = gsl_rng_get( r );
+  for( int config=0; config<2 && isOk; ++config ){
+    int nbSites = config == 0 ? 31 : 150;
+    int nbFamilies = config == 0 ? 1 : 3;
+    GenomeMatrix vGenomes[2];
+    for( int run=0; run<2; ++run ){
+      gsl_rng * rRun = gsl_rng_alloc( gsl_rng_default );
+      gsl_rng_set( rRun, seed );
+      Population pop;
+      pop.setNbDiploids( 600 );
+      pop.setNbChrPerIndividual( 4 );
+      pop.setNbSitesPerChromosome( nbSites );
+      pop.setExpNbTEsPerIndividual( 10 );
+      pop.setVerbose( -1 );
+      pop.setRng( rRun );
+      for( int fam=1; fam<nbFamilies; ++fam )
+        pop.addFamily( 0.005, 0.01, 0.05 );
+      pop.setFastInitialization( true );
+      pop.setNbThreads( run == 0 ? 1 : 4 );
+      pop.initialize();
+      vGenomes[ run ] = pop.getGenomes();
+      gsl_rng_free( rRun );
+    }
+    const GenomeMatrix & gm = vGenomes[0];
+    int nbWords = gm.getNbWordsPerChromosome();
+    vector<double> vSums( nbFamilies, 0 );
+    for( int ind=0; ind<600 && isOk; ++ind ){
+      int nbTEs = 0;
+      for( int fam=0; fam<nbFamilies; ++fam ){
+        int n = nbFamilies == 1 ? gm.getNbTEs( ind )
+          : gm.getNbFamilyTEs( ind, fam );
+        vSums[ fam ] += n;
+        nbTEs += n;
+      }
+      isOk = nbTEs == gm.getNbTEs( ind )
+        && gm.getNbTEs( ind ) == vGenomes[1].getNbTEs( ind );
+      for( int chr=0; chr<4 && isOk; ++chr )
+        for( int w=0; w<nbFamilies*nbWords && isOk; ++w )
+          isOk = gm.getChromosome( ind, chr )[w]
+            == vGenomes[1].getChromosome( ind, chr )[w];
+    }
+    for( int fam=0; fam<nbFamilies && isOk; ++fam ){
+      isOk = fabs( vSums[ fam ] / 600 - 10 ) < 0.6;
+      if( verbose > 1 )
+        cout << "config " << config << " family " << fam + 1 << ": "
+             << vSums[ fam ] / 600 << " TEs per individual" << endl;
+    }
+  }
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+int test_Population_plannedOffspring( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  // the matings planned then made in the order of the parents give the
+  // same genomes and loop counts as those made child by child (kept with a
+  // genealogy), with rejected zygotes on chromosomes of one word, then with
+  // three TE families on chromosomes of three words, then with the
+  // fecundity selection
+  bool isOk = true;
+  unsigned long seed = gsl_rng_get( r );
+  for( int config=0; config<3 && isOk; ++config ){
+    int nbSites = config == 1 ? 150 : 31;
+    GenomeMatrix vGenomes[2];
+    LoopCounts vCounts[2];
+    for( int run=0; run<2; ++run ){
+      gsl_rng * rRun = gsl_rng_alloc( gsl_rng_default );
+      gsl_rng_set( rRun, seed );
+      TreeSequence ts;
+      Population pop;
+      pop.setNbDiploids( 40 );
+      pop.setNbChrPerIndividual( 4 );
+      pop.setNbSitesPerChromosome( nbSites );
+      pop.setExpNbTEsPerIndividual( 10 );
+      pop.setTotalMapDist( config == 0 ? 9 : 90 );
+      pop.setZygoteSelection( config == 0 );
+      pop.setFecunditySelection( config == 2 );
+      pop.setSelMultiplicator( 0.01 );
+      pop.setSelExponent( 1.5 );
+      pop.setVerbose( -1 );
+      pop.setRng( rRun );
+      if( config == 1 ){
+        pop.addFamily( 0.02, 0.1, 0 );
+        pop.addFamily( 0.01, 0.05, 0.1 );
+      }
+      if( run == 1 )
+        pop.setTreeSequence( &ts );
+      pop.initialize();
+      Population::GenerationKernel kernel = pop.getGenerationKernel( 0.05 );
+      for( int g=0; g<10; ++g )
+        (pop.*kernel)( 0.005, 0.05, 0.05 );
+      vGenomes[ run ] = pop.getGenomes();
+      vCounts[ run ] = pop.getTotalLoopCounts( LOOP_VIABLE );
+      gsl_rng_free( rRun );
+    }
+    const GenomeMatrix & gm = vGenomes[0];
+    int nbWords = gm.getNbFamilies() * gm.getNbWordsPerChromosome();
+    isOk = vCounts[0].nbAttempts == vCounts[1].nbAttempts
+      && vCounts[0].nbAccepted == vCounts[1].nbAccepted
+      && vCounts[0].nbWastedDraws == vCounts[1].nbWastedDraws;
+    for( int ind=0; ind<40 && isOk; ++ind )
+      for( int chr=0; chr<4 && isOk; ++chr ){
+        isOk = gm.getNbTEs( ind, chr ) == vGenomes[1].getNbTEs( ind, chr );
+        for( int w=0; w<nbWords && isOk; ++w )
+          isOk = gm.getChromosome( ind, chr )[w]
+            == vGenomes[1].getChromosome( ind, chr )[w];
+      }
+    if( verbose > 1 )
+      cout << "config " << config << ": " << vCounts[0].nbAttempts
+           << " attempts, " << vCounts[0].nbAccepted << " viable" << endl;
+  }
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+int test_Simulation_pipelinedStats( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  // the rows written by the statistics thread are those written serially,
+  // but for the bytes of the statistics, computed on a more compact store
+  vector<string> vStats = Population::getDefaultStats();
+  vStats.push_back( "nHap" );
+  vStats.push_back( Population::getLoopName( LOOP_VIABLE ) + "Try" );
+  vStats.push_back( "statsAllocs" );
+  vStats.push_back( "statsBytes" );
+  MemoryStats::startCounting();
+  string vOutFiles[2] = { "test_serial.tsv", "test_pipelined.tsv" };
+  unsigned long seed = gsl_rng_get( r );
+  vector<string> vvLines[2];
+  for( int p=0; p<2; ++p ){
+    gsl_rng * rSimu = gsl_rng_alloc( gsl_rng_default );
+    gsl_rng_set( rSimu, seed );
+    remove( vOutFiles[p].c_str() );
+    Simulation simu;
+    simu.setNbGenerations( 30 );
+    simu.setNbDiploids( 50 );
+    simu.setNbChrPerIndividuals( 4 );
+    simu.setNbSitesPerChromosome( 70 );
+    simu.setExpNbTEsPerIndividual( 10 );
+    simu.setTotalMapDist( 2 );
+    simu.setProbLoss( 0.05 );
+    simu.setProbTransp0( 0.1 );
+    simu.setK( 0.01 );
+    simu.setZygoteSelection( true );
+    simu.setSelMultiplicator( 0.001 );
+    simu.setSelExponent( 1.5 );
+    simu.setOutFile( vOutFiles[p] );
+    simu.setStats( vStats );
+    simu.setPipelinedStats( p == 1 );
+    simu.setRng( rSimu );
+    simu.run();
+    gsl_rng_free( rSimu );
+    ifstream inStream( vOutFiles[p].c_str() );
+    string line;
+    while( getline( inStream, line ) )
+      vvLines[p].push_back( line.substr( 0, line.rfind( '\t' ) ) );
+    inStream.close();
+    remove( vOutFiles[p].c_str() );
+  }
+  MemoryStats::stopCounting();
+
+  // the statistics of the last generations did allocate
+  string lastAllocs = vvLines[1].back().substr(
+    vvLines[1].back().rfind( '\t' ) + 1 );
+  bool isOk = ( vvLines[0].size() == 31 && vvLines[0] == vvLines[1]
+                && atoi( lastAllocs.c_str() ) > 0 );
+  if( verbose > 1 )
+    cout << "rows=" << vvLines[0].size() << " " << vvLines[1].size()
+         << " statsAllocs=" << lastAllocs << endl;
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+int test_Simulation_fastInitResume( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  // two simulations with the fast initialization, the first one stopped at
+  // its first generation and resumed, give the rows of an uninterrupted run
+  string vOutFiles[2] = { "test_uninterrupted.tsv", "test_resumed.tsv" };
+  string ckptFile = "test_fastInit.ckpt";
+  unsigned long seed = gsl_rng_get( r );
+  vector<string> vvLines[2];
+  for( int p=0; p<2; ++p ){
+    gsl_rng * rSimu = gsl_rng_alloc( gsl_rng_default );
+    gsl_rng_set( rSimu, seed );
+    remove( vOutFiles[p].c_str() );
+    for( int run=0; run<3; ++run ){
+      if( p == 0 && run == 1 )
+        continue;
+      Simulation simu;
+      simu.setSimulationIdentifier( run < 2 ? 1 : 2 );
+      simu.setNbGenerations( 10 );
+      simu.setNbDiploids( 30 );
+      simu.setNbChrPerIndividuals( 4 );
+      simu.setNbSitesPerChromosome( 200 );
+      simu.setExpNbTEsPerIndividual( 10 );
+      simu.setTotalMapDist( 2 );
+      simu.setProbLoss( 0.05 );
+      simu.setProbTransp0( 0.1 );
+      simu.setK( 0.01 );
+      simu.setFastInitialization( true, 2 );
+      simu.setOutFile( vOutFiles[p] );
+      simu.setRng( rSimu );
+      if( p == 1 && run < 2 ){
+        simu.setCheckpointFile( ckptFile );
+        if( run == 0 )
+          simu.setDeadline( 1 );
+        else
+          simu.setResumeFile( ckptFile );
+      }
+      simu.run();
+    }
+    gsl_rng_free( rSimu );
+    ifstream inStream( vOutFiles[p].c_str() );
+    string line;
+    while( getline( inStream, line ) )
+      vvLines[p].push_back( line );
+    inStream.close();
+    remove( vOutFiles[p].c_str() );
+  }
+  remove( ckptFile.c_str() );
+
+  bool isOk = ( vvLines[0].size() == 22 && vvLines[0] == vvLines[1] );
+  if( verbose > 1 )
+    cout << "rows=" << vvLines[0].size() << " " << vvLines[1].size() << endl;
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+// reference of test_Population_equilibrium: sorted mean copy numbers of
+// 100 replicates (seed 1, before any optimization of the generation loop)
+const int nbRefEquilibrium = 100;
+const double vRefEquilibrium[ nbRefEquilibrium ] = {
+    0, 0, 0.25, 0.9, 2.8, 3.8, 3.9, 4.15, 4.5, 4.5,
+    4.65, 4.65, 4.9, 5.25, 5.3, 5.45, 5.6, 5.6, 5.8, 5.85,
+    6.1, 6.4, 6.4, 6.5, 6.55, 6.7, 6.8, 6.8, 6.85, 6.9,
+    6.9, 6.95, 7.1, 7.3, 7.35, 7.4, 7.5, 7.6, 7.7, 7.75,
+    7.75, 7.8, 7.85, 7.85, 7.85, 8.1, 8.15, 8.15, 8.2, 8.25,
+    8.35, 8.35, 8.35, 8.4, 8.8, 8.9, 9.2, 9.2, 9.35, 9.35,
+    9.35, 9.65, 9.7, 9.75, 9.85, 10, 10.1, 10.1, 10.85, 10.85,
+    11, 11, 11, 11.25, 11.45, 11.5, 11.5, 11.55, 11.75, 12,
+    12.05, 12.05, 12.15, 12.3, 12.3, 12.85, 12.9, 13.1, 13.2, 13.65,
+    14, 14, 14.3, 14.35, 14.5, 14.75, 15.35, 15.6, 16.8, 16.9
+};
+
+int test_Population_equilibrium( gsl_rng * r, int verbose )
+{
+  if( verbose > 0 ){
+    cout << __FUNCTION__<< ": ";
+    if( verbose > 1 )
+      cout << endl;
+  }
+
+  // the mean copy number quickly reaches its equilibrium (u0/(1+k.n) = v,
+  // i.e. n = 10) but drifts around it; its distribution over replicates
+  // must match the reference (two-sample Kolmogorov-Smirnov test and
+  // Welch test of the means, both at 0.1%), so that a speed-up can't
+  // change the model
+  int nbReplicates = 30;
+  vector<double> vMeans;
+  for( int rep=0; rep<nbReplicates; ++rep ){
+    Population pop;
+    pop.setNbDiploids( 20 );
+    pop.setNbChrPerIndividual( 4 );
+    pop.setNbSitesPerChromosome( 31 );
+    pop.setExpNbTEsPerIndividual( 10 );
+    pop.setTotalMapDist( 90 );
+    pop.setZygoteSelection( false );
+    pop.setSelMultiplicator( 0.001 );
+    pop.setSelExponent( 1.5 );
+    pop.setVerbose( -1 );
+    pop.setRng( r );
+    pop.initialize();
+    Population::GenerationKernel kernel = pop.getGenerationKernel( 0.1 );
+    for( int g=1; g<=100; ++g )
+      (pop.*kernel)( 0.05, 0.1, 0.1 );
+    vMeans.push_back( pop.getSumNbTEs() / 20.0 );
+  }
+  sort( vMeans.begin(), vMeans.end() );
+
+  double ks = 0;
+  int i = 0, j = 0;
+  while( i < nbReplicates && j < nbRefEquilibrium ){
+    double x = min( vMeans[i], vRefEquilibrium[j] );
+    while( i < nbReplicates && vMeans[i] == x )
+      ++i;
+    while( j < nbRefEquilibrium && vRefEquilibrium[j] == x )
+      ++j;
+    ks = max( ks, fabs( i / (double) nbReplicates
+                        - j / (double) nbRefEquilibrium ) );
+  }
+  double ksMax = 1.949 * sqrt( ( nbReplicates + nbRefEquilibrium )
+                               / (double) ( nbReplicates * nbRefEquilibrium ) );
+
+  double vMean[2] = { 0, 0 }, vVar[2] = { 0, 0 };
+  for( i=0; i<nbReplicates; ++i )
+    vMean[0] += vMeans[i] / nbReplicates;
+  for( j=0; j<nbRefEquilibrium; ++j )
+    vMean[1] += vRefEquilibrium[j] / nbRefEquilibrium;
+  for( i=0; i<nbReplicates; ++i )
+    vVar[0] += pow( vMeans[i] - vMean[0], 2 ) / ( nbReplicates - 1 );
+  for( j=0; j<nbRefEquilibrium; ++j )
+    vVar[1] += pow( vRefEquilibrium[j] - vMean[1], 2 ) / ( nbRefEquilibrium - 1 );
+  double z = ( vMean[0] - vMean[1] ) / sqrt( vVar[0] / nbReplicates
+                                              + vVar[1] / nbRefEquilibrium );
+
+  bool isOk = ks < ksMax && fabs( z ) < 3.29;
+  if( verbose > 1 )
+    cout << "mean=" << vMean[0] << " (ref=" << vMean[1] << ") z=" << z
+         << " ks=" << ks << " (max=" << ksMax << ")" << endl;
+
+  if( isOk ){
+    if( verbose > 0 )
+      cout << "TRUE" << endl;
+    return( 0 );
+  }
+  else{
+    if( verbose > 0 )
+      cout << "FALSE" << endl;
+    return( 1 );
+  }
+}
+
+// reference workloads of the performance checks
+enum { PERF_GENERATION, PERF_FREQ_PER_LOCUS, PERF_STATS, NB_PERF };
+
+string getPerfName( int workload )
+{
+  if( workload == PERF_GENERATION )
+    return( "makeNewGeneration" );
+  else if( workload == PERF_FREQ_PER_LOCUS )
+    return( "getFreqTEsPerLocus" );
+  return( "getStatsValues" );
+}
+
+// CPU time of the process, less sensitive than the wall time to the other
+// processes of the machine
+double getCpuTime( void )
+{
+  struct timespec now;
+  clock_gettime( CLOCK_PROCESS_CPUTIME_ID, &now );
+  return( now.tv_sec + now.tv_nsec * 1e-9 );
+}
+
+// best time over several repetitions of a workload, each one on the same
+// population (200 diploids after 30 generations with the default parameters)
+double timeWorkload( int workload )
+{
+  double best = 0;
+  for( int rep=0; rep<5; ++rep ){
+    gsl_rng * r = gsl_rng_alloc( gsl_rng_default );
+    gsl_rng_set( r, 1859 );
+    Population pop;
+    pop.setNbDiploids( 200 );
+    pop.setNbChrPerIndividual( 4 );
+    pop.setNbSitesPerChromosome( 31 );
+    pop.setExpNbTEsPerIndividual( 10 );
+    pop.setTotalMapDist( 90 );
+    pop.setZygoteSelection( false );
+    pop.setSelMultiplicator( 0.001 );
+    pop.setSelExponent( 1.5 );
+    pop.setVerbose( -1 );
+    pop.setRng( r );
+    pop.setStats( Population::getDefaultStats() );
+    pop.initialize();
+    Population::GenerationKernel kernel = pop.getGenerationKernel( 0.05 );
+    vector<double> vValues( pop.getNbLociPerIndividual() );
+
+    double start = getCpuTime();
+    for( int g=0; g<30; ++g )
+      (pop.*kernel)( 0.005, 0.01, 0.05 );
+    if( workload != PERF_GENERATION ){
+      start = getCpuTime();
+      if( workload == PERF_FREQ_PER_LOCUS )
+        for( int i=0; i<3000; ++i )
+          pop.getFreqTEsPerLocus( &vValues[0] );
+      else
+        for( int i=0; i<1500; ++i )
+          pop.getStatsValues( vValues );
+    }
+    double elapsed = getCpuTime() - start;
+    if( rep == 0 || elapsed < best )
+      best = elapsed;
+    gsl_rng_free( r );
+  }
+  return( best );
+}
+
+// times the reference workloads and compares them to the baseline of the
+// machine (one line per workload: name and seconds), recording the
+// workloads absent from it; returns the nb of regressions
+int test_performance( string baselineFile, bool isNewBaseline,
+                      double tolerance, int verbose )
+{
+  map<string,double> baseline;
+  ifstream inStream( baselineFile.c_str() );
+  string name;
+  double seconds;
+  while( ! isNewBaseline && inStream >> name >> seconds )
+    baseline[ name ] = seconds;
+  inStream.close();
+
+  int nbRegressions = 0;
+  bool isUpdated = false;
+  for( int w=0; w<NB_PERF; ++w ){
+    name = getPerfName( w );
+    seconds = timeWorkload( w );
+    if( verbose > 0 )
+      cout << "perf_" << name << ": " << seconds << "s";
+    if( baseline.find( name ) == baseline.end() ){
+      baseline[ name ] = seconds;
+      isUpdated = true;
+      if( verbose > 0 )
+        cout << " (new baseline)" << endl;
+    }
+    else{
+      bool isOk = seconds <= baseline[ name ] * ( 1 + tolerance );
+      if( ! isOk )
+        ++nbRegressions;
+      if( verbose > 0 )
+        cout << " (baseline=" << baseline[ name ] << "s) "
+             << ( isOk ? "TRUE" : "FALSE" ) << endl;
+    }
+  }
+
+  if( isUpdated ){
+    ofstream outStream( baselineFile.c_str() );
+    for( map<string,double>::iterator it=baseline.begin();
+         it!=baseline.end(); ++it )
+      outStream << it->first << " " << it->second << endl;
+    outStream.close();
+    cout << "performance baseline written in " << baselineFile << endl;
+  }
+
+  return( nbRegressions );
+}
+
 int main( int argc, char* argv[] )
 {
   int nbFalses = 0;
   int seed = 1859;
   int verbose = 0;
-  int nbTests = 5;
+  int nbTests = 28;
+  bool isPerf = true;
+  string baselineFile = "";
+  bool isNewBaseline = false;
+  double tolerance = 0.25;
 
   char c;
   extern char *optarg;
-  while( (c = getopt(argc,argv,"hv:")) != -1 ){
+  while( (c = getopt(argc,argv,"hv:p:b:Bt:")) != -1 ){
     switch (c){
     case 'h':
       usage( argv[0], EXIT_SUCCESS );
@@ -252,6 +1907,18 @@ int main( int argc, char* argv[] )
     case 'v':
       verbose = atoi(optarg);
       break;
+    case 'p':
+      isPerf = atoi(optarg) != 0;
+      break;
+    case 'b':
+      baselineFile = optarg;
+      break;
+    case 'B':
+      isNewBaseline = true;
+      break;
+    case 't':
+      tolerance = atof(optarg);
+      break;
     case '?':
       usage( argv[0], EXIT_FAILURE );
     default:
@@ -271,9 +1938,50 @@ int main( int argc, char* argv[] )
   nbFalses += test_Individual_getOccPerLocus( r, verbose );
   nbFalses += test_Individual_getNbTEsForLocus( r, verbose );
   nbFalses += test_Individual_getNbSites( r, verbose );
+  nbFalses += test_Population_saveData( r, verbose );
+  nbFalses += test_GenomeMatrix_recombine( r, verbose );
+  nbFalses += test_GenomeMatrix_singleWord( r, verbose );
+  nbFalses += test_GenomeMatrix_copyOnWrite( r, verbose );
+  nbFalses += test_Population_loopCounts( r, verbose );
+  nbFalses += test_TreeSequence_simplify( r, verbose );
+  nbFalses += test_EventTrace_ring( r, verbose );
+  nbFalses += test_Checkpoint_resume( r, verbose );
+  nbFalses += test_Population_setGenomes( r, verbose );
+  nbFalses += test_cc83_api( r, verbose );
+  nbFalses += test_Aggregator_merge( r, verbose );
+  nbFalses += test_Abc_threads( r, verbose );
+  nbFalses += test_Population_equilibrium( r, verbose );
+  nbFalses += test_MemoryStats_phases( r, verbose );
+  nbFalses += test_LinkageDisequilibrium_pairs( r, verbose );
+  nbFalses += test_LockstepPopulations_replicates( r, verbose );
+  nbFalses += test_Population_moran( r, verbose );
+  nbFalses += test_Population_families( r, verbose );
+  nbFalses += test_Population_fecundity( r, verbose );
+  nbFalses += test_Population_fastInit( r, verbose );
+  nbFalses += test_Population_plannedOffspring( r, verbose );
+  nbFalses += test_Simulation_pipelinedStats( r, verbose );
+  nbFalses += test_Simulation_fastInitResume( r, verbose );
 
   cout << "errors: " << nbFalses
        << " / " << nbTests << endl;
 
+  int nbRegressions = 0;
+  if( isPerf ){
+    if( baselineFile.empty() ){
+      char hostname[256];
+      gethostname( hostname, sizeof(hostname) );
+      hostname[ sizeof(hostname) - 1 ] = '\0';
+      baselineFile = "test_perf_" + string( hostname ) + ".txt";
+    }
+    nbRegressions = test_performance( baselineFile, isNewBaseline,
+                                      tolerance, verbose );
+    cout << "regressions: " << nbRegressions
+         << " / " << NB_PERF << endl;
+  }
+
   gsl_rng_free( r );
+
+  if( nbFalses > 0 || nbRegressions > 0 )
+    return( EXIT_FAILURE );
+  return( EXIT_SUCCESS );
 }
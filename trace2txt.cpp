@@ -0,0 +1,129 @@
+/*
+ * \file trace2txt.cpp
+ */
+
+// Purpose: convert an event trace of modelCC83 into text.
+// Copyright (C) <2011>  <Timothée Flutre>
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <getopt.h>
+using namespace std;
+
+#include "EventTrace.h"
+
+void usage( char *program_name, int status )
+{
+  cerr << "usage: " << program_name << " [options]\n";
+  cerr << "options:" << endl;
+  cerr << "     -h: this help" << endl;
+  cerr << "     -i: name of the trace file" << endl;
+  cerr << "     -o: name of the text output file (default=stdout)" << endl;
+  cerr << "     -t: only print the events of this type" << endl;
+  cerr << "         (generation, crossover, loss, insertion or rejection)" << endl;
+  exit( status );
+}
+
+// one line per event, e.g. "simu=1 gen=3 loss ind=2 chr=0 site=7 nbTEs=9"
+void printEvent( ostream & out, const TraceEvent & event, int simu, int gen )
+{
+  out << "simu=" << simu << " gen=" << gen << " "
+      << EventTrace::getEventName( event.type );
+  switch( event.type ){
+  case EVENT_GENERATION:
+    out << " nbTEs=" << event.value;
+    break;
+  case EVENT_CROSSOVER:
+    out << " ind=" << event.ind << " chr=" << event.chr
+        << " locus=" << event.pos << " parent=" << event.value;
+    break;
+  case EVENT_LOSS:
+  case EVENT_INSERTION:
+    out << " ind=" << event.ind << " chr=" << event.chr
+        << " site=" << event.pos << " nbTEs=" << event.value;
+    break;
+  case EVENT_REJECTION:
+    out << " ind=" << event.ind << " nbTEs=" << event.value;
+    break;
+  }
+  out << "\n";
+}
+
+int main( int argc, char* argv[] )
+{
+  string inFile = "", outFile = "", type = "";
+
+  int c;
+  extern char *optarg;
+  while( (c = getopt(argc,argv,"hi:o:t:")) != -1 ){
+    switch (c){
+    case 'h':
+      usage( argv[0], EXIT_SUCCESS );
+      break;
+    case 'i':
+      inFile = optarg;
+      break;
+    case 'o':
+      outFile = optarg;
+      break;
+    case 't':
+      type = optarg;
+      break;
+    default:
+      usage( argv[0], EXIT_FAILURE );
+    }
+  }
+  if( inFile == "" ){
+    cerr << "ERROR: missing input file (-i)" << endl;
+    usage( argv[0], EXIT_FAILURE );
+  }
+
+  FILE * fp = fopen( inFile.c_str(), "rb" );
+  if( fp == NULL ){
+    cerr << "ERROR: can't open file " << inFile << endl;
+    exit( EXIT_FAILURE );
+  }
+  char magic[8];
+  uint32_t version = 0, recordSize = 0;
+  if( fread( magic, 1, 8, fp ) != 8 || memcmp( magic, TRACE_MAGIC, 8 ) != 0
+      || fread( &version, sizeof(uint32_t), 1, fp ) != 1
+      || fread( &recordSize, sizeof(uint32_t), 1, fp ) != 1
+      || version != TRACE_VERSION || recordSize != sizeof(TraceEvent) ){
+    cerr << "ERROR: " << inFile << " is not a trace of this version" << endl;
+    exit( EXIT_FAILURE );
+  }
+
+  ofstream outStream;
+  if( outFile != "" )
+    outStream.open( outFile.c_str() );
+  ostream & out = ( outFile != "" ) ? outStream : cout;
+
+  TraceEvent vEvents[4096];
+  int simu = 0, gen = 0;
+  size_t nb;
+  while( ( nb = fread( vEvents, sizeof(TraceEvent), 4096, fp ) ) > 0 )
+    for( size_t i=0; i<nb; ++i ){
+      if( vEvents[i].type == EVENT_GENERATION ){
+        simu = vEvents[i].ind;
+        gen = vEvents[i].pos;
+      }
+      if( type == "" || type == EventTrace::getEventName( vEvents[i].type ) )
+        printEvent( out, vEvents[i], simu, gen );
+    }
+  out.flush();
+  fclose( fp );
+  return( EXIT_SUCCESS );
+}